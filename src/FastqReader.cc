@@ -0,0 +1,341 @@
+///////////////////////////////////////////////////////////////////////////////
+//                   SOFTWARE COPYRIGHT NOTICE AGREEMENT                     //
+//       This software and its documentation are copyright (2015) by the     //
+//   Broad Institute.  All rights are reserved.  This software is supplied   //
+//   without any warranty or guaranteed support whatsoever. The Broad        //
+//   Institute is not responsible for its use, misuse, or functionality.     //
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * \file FastqReader.cc
+ *
+ * \brief
+ */
+
+#include "FastqReader.h"
+#include "system/System.h"
+#include "system/WorklistN.h"
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+// MakeDepend: library ZLIB
+#include <zlib.h>
+
+namespace
+{
+
+size_t const CHUNK_SIZE = 4*1024*1024ul; // decompressed bytes per chunk
+size_t const MAX_QUEUED_CHUNKS = 8;
+size_t const BGZF_HDR_SIZE = 18;
+size_t const BGZF_BATCH_BLOCKS = 512;
+
+unsigned le16( char const* ptr )
+{ unsigned char const* p = reinterpret_cast<unsigned char const*>(ptr);
+  return p[0] | p[1] << 8; }
+
+uint32_t le32( char const* ptr )
+{ return le16(ptr) | uint32_t(le16(ptr+2)) << 16; }
+
+// a gzip member header that has only the BGZF extra field.
+bool isBGZFHeader( char const* hdr )
+{ return le16(hdr) == 0x8b1f && hdr[2] == 8 && (hdr[3]&0x1e) == 0x04 &&
+        le16(hdr+10) == 6 && hdr[12] == 'B' && hdr[13] == 'C' &&
+        le16(hdr+14) == 2; }
+
+struct NToAMapper
+{
+    unsigned char operator()( char c ) const
+    { return Base::char2Val(c == 'N' ? 'A' : c); }
+};
+
+}
+
+void FastqReader::Record::encode( bvec& bases, qvec& quals ) const
+{
+    bases.assign(mBases,mBases+mReadLen,NToAMapper());
+    quals.resize(mReadLen);
+    for ( unsigned idx = 0; idx != mReadLen; ++idx )
+        quals[idx] = mQuals[idx] - 33;
+}
+
+FastqReader::FastqReader( std::string const& path )
+: mFR(path), mPos(0), mNRecsTotal(0), mEOF(false), mDone(false),
+  mQuit(false), mChunkReady(mLock), mChunkTaken(mLock)
+{
+    mThread = std::thread([this](){produce();});
+}
+
+FastqReader::~FastqReader()
+{
+    if ( true )
+    { Locker locker(mLock);
+      mQuit = true; }
+    mChunkTaken.broadcast();
+    mThread.join();
+}
+
+size_t FastqReader::nextBatch( size_t maxRecs )
+{
+    mRecs.clear();
+    mOffsets.clear();
+    if ( mPos )
+    {
+        mBuf.erase(mBuf.begin(),mBuf.begin()+mPos);
+        mPos = 0;
+    }
+    while ( mOffsets.size() < maxRecs )
+    {
+        RecOffsets rec;
+        if ( parseRecord(&mPos,&rec) )
+            mOffsets.push_back(rec);
+        else if ( !getChunk() )
+        {
+            while ( mPos != mBuf.size() && isspace(mBuf[mPos]) )
+                ++mPos;
+            if ( mPos != mBuf.size() )
+                badRecord("is truncated");
+            break;
+        }
+    }
+
+    char const* buf = mBuf.data();
+    mRecs.reserve(mOffsets.size());
+    for ( RecOffsets const& off : mOffsets )
+        mRecs.push_back(Record{buf+off.name,buf+off.bases,buf+off.quals,
+                                off.nameLen,off.readLen});
+    mNRecsTotal += mRecs.size();
+    return mRecs.size();
+}
+
+// Parses a record starting at *pPos.  Returns false without changing *pPos if
+// the buffer doesn't contain the whole record.
+bool FastqReader::parseRecord( size_t* pPos, RecOffsets* pRec )
+{
+    char const* buf = mBuf.data();
+    size_t end = mBuf.size();
+    size_t pos = *pPos;
+    size_t starts[4], lens[4];
+    for ( unsigned line = 0; line != 4; ++line )
+    {
+        void const* pNL = memchr(buf+pos,'\n',end-pos);
+        if ( !pNL ) return false;
+        size_t nl = static_cast<char const*>(pNL) - buf;
+        starts[line] = pos;
+        lens[line] = nl - pos;
+        if ( lens[line] && buf[nl-1] == '\r' ) lens[line] -= 1;
+        pos = nl + 1;
+    }
+    if ( !lens[0] || buf[starts[0]] != '@' )
+        badRecord("has a header line that doesn't begin with '@'");
+    if ( !lens[2] || buf[starts[2]] != '+' )
+        badRecord("has a separator line that doesn't begin with '+'");
+    if ( lens[1] != lens[3] )
+        badRecord("has inconsistent base/quality lengths");
+    pRec->name = starts[0]+1;
+    pRec->nameLen = lens[0]-1;
+    pRec->bases = starts[1];
+    pRec->quals = starts[3];
+    pRec->readLen = lens[1];
+    *pPos = pos;
+    return true;
+}
+
+void FastqReader::badRecord( char const* what )
+{
+    FatalErr("Record " << mNRecsTotal+mOffsets.size()+1 << " of FASTQ file "
+                << mFR.getFilename() << ' ' << what << '.');
+}
+
+// Appends the next chunk of decompressed data to mBuf.  Returns false when
+// there's nothing more.
+bool FastqReader::getChunk()
+{
+    if ( mEOF ) return false;
+    std::vector<char> chunk;
+    if ( true )
+    {
+        Locker locker(mLock);
+        while ( mChunks.empty() && !mDone )
+            locker.wait(mChunkReady);
+        if ( !mChunks.empty() )
+        {
+            chunk.swap(mChunks.front());
+            mChunks.pop_front();
+        }
+    }
+    mChunkTaken.signal();
+    if ( chunk.empty() )
+    {
+        mEOF = true;
+        // supply a missing final newline
+        if ( mBuf.empty() || mBuf.back() == '\n' ) return false;
+        mBuf.push_back('\n');
+        return true;
+    }
+    mBuf.insert(mBuf.end(),chunk.begin(),chunk.end());
+    return true;
+}
+
+// Runs on the background thread.
+void FastqReader::produce()
+{
+    char hdr[BGZF_HDR_SIZE];
+    size_t nRead = mFR.readSome(hdr,sizeof(hdr));
+    mFR.seek(0);
+    if ( nRead < 2 || le16(hdr) != 0x8b1f )
+        readPlain();
+    else if ( nRead == sizeof(hdr) && isBGZFHeader(hdr) )
+        inflateBGZF();
+    else
+        inflateGZip();
+    if ( true )
+    { Locker locker(mLock);
+      mDone = true; }
+    mChunkReady.broadcast();
+}
+
+void FastqReader::readPlain()
+{
+    while ( true )
+    {
+        std::vector<char> chunk(CHUNK_SIZE);
+        chunk.resize(mFR.readSome(chunk.data(),chunk.size()));
+        if ( chunk.empty() || !deliver(chunk) )
+            break;
+    }
+}
+
+// BGZF blocks are independent, and each one tells us its compressed and
+// inflated sizes, so we read a batch of blocks and inflate them in parallel.
+void FastqReader::inflateBGZF()
+{
+    std::vector<char> cBuf(BGZF_BATCH_BLOCKS*64*1024ul);
+    std::vector<size_t> cOffs, uOffs;
+    size_t blockNo = 0;
+    bool eof = false;
+    while ( !eof )
+    {
+        cOffs.clear();
+        uOffs.clear();
+        size_t cLen = 0, uLen = 0;
+        while ( cOffs.size() < BGZF_BATCH_BLOCKS )
+        {
+            char* hdr = &cBuf[cLen];
+            size_t nRead = mFR.readSome(hdr,BGZF_HDR_SIZE);
+            if ( !nRead )
+            { eof = true; break; }
+            size_t blockLen = le16(hdr+16) + 1ul;
+            if ( nRead != BGZF_HDR_SIZE || !isBGZFHeader(hdr) ||
+                    blockLen < BGZF_HDR_SIZE+8 )
+                FatalErr(mFR.getFilename() << " is uninterpretable as BGZF "
+                            "at block " << blockNo+1 << '.');
+            if ( mFR.readSome(hdr+BGZF_HDR_SIZE,blockLen-BGZF_HDR_SIZE) !=
+                    blockLen-BGZF_HDR_SIZE )
+                FatalErr(mFR.getFilename() << " is truncated in block "
+                            << blockNo+1 << '.');
+            cOffs.push_back(cLen);
+            uOffs.push_back(uLen);
+            cLen += blockLen;
+            uLen += le32(hdr+blockLen-4);
+            blockNo += 1;
+        }
+        size_t nBlocks = cOffs.size();
+        if ( !nBlocks ) break;
+        cOffs.push_back(cLen);
+        uOffs.push_back(uLen);
+
+        std::vector<char> chunk(uLen);
+        size_t firstBlockNo = blockNo - nBlocks;
+        parallelFor(0ul,nBlocks,
+            [this,&cBuf,&cOffs,&uOffs,&chunk,firstBlockNo]( size_t idx )
+            { char const* blk = &cBuf[cOffs[idx]];
+              size_t blockLen = cOffs[idx+1]-cOffs[idx];
+              size_t iSize = uOffs[idx+1]-uOffs[idx];
+              if ( !iSize ) return;
+              z_stream zs;
+              memset(&zs,0,sizeof(zs));
+              zs.next_in = (Bytef*)(blk+BGZF_HDR_SIZE);
+              zs.avail_in = blockLen-BGZF_HDR_SIZE-8;
+              zs.next_out = (Bytef*)(&chunk[uOffs[idx]]);
+              zs.avail_out = iSize;
+              if ( ::inflateInit2(&zs,-15) != Z_OK ||
+                      ::inflate(&zs,Z_FINISH) != Z_STREAM_END ||
+                      ::inflateEnd(&zs) != Z_OK ||
+                      zs.total_out != iSize ||
+                      ::crc32(0,(Bytef*)&chunk[uOffs[idx]],iSize) !=
+                              le32(blk+blockLen-8) )
+                  FatalErr(mFR.getFilename() << " can't be unzipped at block "
+                              << firstBlockNo+idx+1 << '.'); });
+        if ( !chunk.empty() && !deliver(chunk) )
+            break;
+    }
+}
+
+// An ordinary gzip file can only be inflated serially.  It may consist of
+// several concatenated members.
+void FastqReader::inflateGZip()
+{
+    std::vector<char> inBuf(CHUNK_SIZE);
+    std::vector<char> chunk(CHUNK_SIZE);
+    z_stream zs;
+    memset(&zs,0,sizeof(zs));
+    if ( ::inflateInit2(&zs,15+16) != Z_OK )
+        FatalErr("Can't initialize zlib to read " << mFR.getFilename() << '.');
+    zs.next_out = (Bytef*)chunk.data();
+    zs.avail_out = chunk.size();
+    bool inMember = false;
+    bool quit = false;
+    while ( !quit )
+    {
+        if ( !zs.avail_in )
+        {
+            size_t nRead = mFR.readSome(inBuf.data(),inBuf.size());
+            if ( !nRead )
+            {
+                if ( inMember )
+                    FatalErr(mFR.getFilename() << " is truncated.");
+                break;
+            }
+            zs.next_in = (Bytef*)inBuf.data();
+            zs.avail_in = nRead;
+        }
+        int ret = ::inflate(&zs,Z_NO_FLUSH);
+        if ( ret == Z_STREAM_END )
+        {
+            inMember = false;
+            ::inflateReset(&zs);
+        }
+        else if ( ret == Z_OK )
+            inMember = true;
+        else
+            FatalErr(mFR.getFilename() << " can't be unzipped: zlib error "
+                        << ret << '.');
+        if ( !zs.avail_out )
+        {
+            quit = !deliver(chunk);
+            chunk.resize(CHUNK_SIZE);
+            zs.next_out = (Bytef*)chunk.data();
+            zs.avail_out = chunk.size();
+        }
+    }
+    ::inflateEnd(&zs);
+    chunk.resize(chunk.size()-zs.avail_out);
+    if ( !quit && !chunk.empty() )
+        deliver(chunk);
+}
+
+// Hands a chunk to the parsing thread, waiting if it's too far behind.
+// Returns false if the reader is being destroyed.  Leaves chunk empty.
+bool FastqReader::deliver( std::vector<char>& chunk )
+{
+    if ( true )
+    {
+        Locker locker(mLock);
+        while ( mChunks.size() >= MAX_QUEUED_CHUNKS && !mQuit )
+            locker.wait(mChunkTaken);
+        if ( mQuit ) return false;
+        mChunks.emplace_back();
+        mChunks.back().swap(chunk);
+    }
+    mChunkReady.signal();
+    return true;
+}
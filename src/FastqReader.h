@@ -0,0 +1,107 @@
+///////////////////////////////////////////////////////////////////////////////
+//                   SOFTWARE COPYRIGHT NOTICE AGREEMENT                     //
+//       This software and its documentation are copyright (2015) by the     //
+//   Broad Institute.  All rights are reserved.  This software is supplied   //
+//   without any warranty or guaranteed support whatsoever. The Broad        //
+//   Institute is not responsible for its use, misuse, or functionality.     //
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * \file FastqReader.h
+ *
+ * \brief In-process reader for plain or gzipped FASTQ.
+ */
+#ifndef FASTQREADER_H_
+#define FASTQREADER_H_
+
+#include "Basevector.h"
+#include "Qualvector.h"
+#include "system/LockedData.h"
+#include "system/file/FileReader.h"
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Reads four-line FASTQ records from a plain or gzipped file, in batches.
+///
+/// Decompression happens on a background thread, overlapping with parsing.
+/// Files made of several concatenated gzip members are handled, and files
+/// in BGZF format (e.g., from bgzip) are inflated a batch of blocks at a time
+/// by a team of threads.  Records are located by a fast serial scan for line
+/// breaks, and may then be encoded into bases and quals in parallel.
+///
+/// Use it like this:
+/// FastqReader rdr(fileName);
+/// while ( size_t nRecs = rdr.nextBatch(BATCH_SIZE) )
+///     parallelFor(0ul,nRecs,[&]( size_t idx )
+///                 { rdr[idx].encode(reads[idx],quals[idx]); });
+class FastqReader
+{
+public:
+    /// A FASTQ record, pointing into the reader's buffer.  Valid until the
+    /// next call to nextBatch.
+    struct Record
+    {
+        char const* mName; // header line, minus the leading '@'
+        char const* mBases;
+        char const* mQuals;
+        unsigned mNameLen;
+        unsigned mReadLen;
+
+        std::string name() const { return std::string(mName,mNameLen); }
+
+        /// Encode bases, turning Ns into As, and Phred+33 quals.
+        void encode( bvec& bases, qvec& quals ) const;
+    };
+
+    explicit FastqReader( std::string const& path );
+    ~FastqReader();
+
+    FastqReader( FastqReader const& )=delete;
+    FastqReader& operator=( FastqReader const& )=delete;
+
+    std::string const& getFilename() const { return mFR.getFilename(); }
+
+    /// Parses the next batch of up to maxRecs records.  Returns the number of
+    /// records in the batch, which is 0 at the end of the file.  Malformed
+    /// input is a fatal error.
+    size_t nextBatch( size_t maxRecs );
+
+    size_t size() const { return mRecs.size(); }
+    Record const& operator[]( size_t idx ) const { return mRecs[idx]; }
+
+    /// The number of records in all batches so far.
+    size_t getNRecs() const { return mNRecsTotal; }
+
+private:
+    struct RecOffsets
+    { size_t name, bases, quals; unsigned nameLen, readLen; };
+
+    bool parseRecord( size_t* pPos, RecOffsets* pRec );
+    bool getChunk();
+    void produce();
+    void readPlain();
+    void inflateBGZF();
+    void inflateGZip();
+    bool deliver( std::vector<char>& chunk );
+    [[noreturn]] void badRecord( char const* what );
+
+    FileReader mFR;
+    std::vector<char> mBuf;
+    size_t mPos;
+    std::vector<Record> mRecs;
+    std::vector<RecOffsets> mOffsets;
+    size_t mNRecsTotal;
+    bool mEOF;
+
+    std::deque<std::vector<char>> mChunks;
+    bool mDone;
+    bool mQuit;
+    LockedData mLock;
+    Condition mChunkReady;
+    Condition mChunkTaken;
+    std::thread mThread;
+};
+
+#endif /* FASTQREADER_H_ */
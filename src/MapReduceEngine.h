@@ -16,20 +16,31 @@
 #define MAPREDUCEENGINE_H_
 
 // MakeDepend: library OMP
+// MakeDepend: library ZLIB
 
+#include "reporting/StageProfiler.h"
+#include "system/MemBudget.h"
 #include "system/SysConf.h"
 #include "system/System.h"
 #include "system/Thread.h"
+#include "system/file/FileReader.h"
+#include "system/file/FileWriter.h"
+#include "system/file/TempFile.h"
 #include <algorithm>
+#include <atomic>
 #include <condition_variable>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <omp.h>
 #include <thread>
+#include <type_traits>
 #include <vector>
 #include <utility>
+#include <zlib.h>
 
 
 // Itr is an iterator over the input data type:  e.g., an iterator over bvec's.
@@ -89,6 +100,15 @@
 //    vecbvec reads(READS);
 //    mre.process(reads.getKmerCount(K),reads.cbegin(),reads.cend(),true);
 //
+// When the keys won't fit in memory, the input is normally mapped once per
+// pass, and each pass keeps only the keys that hash to it.  If that would take
+// more than getMaxPasses() passes, we switch to an external-memory mode
+// instead:  the input is mapped just once, the keys are hash-partitioned into
+// compressed run files on disk (in TMPDIR), and then each partition is read
+// back and reduced in memory.  A partition that outgrows its share of memory is
+// compacted by overflow() as it's read.  This requires that Key be trivially
+// copyable.
+//
 template <class Impl, class Key, class Hash, class Comp=std::less<Key>>
 class MapReduceEngine
 {
@@ -371,11 +391,210 @@ class MapReduceEngine
         Itr mEnd;
     };
 
+    // The hash-partitioned run files for external-memory mode.  Each
+    // partition's keys are appended to its file as a series of blocks, each of
+    // which is a BlockHeader followed by a zlib-compressed array of keys.
+    class RunFiles
+    {
+    public:
+        struct BlockHeader
+        { uint32_t mNKeys; uint32_t mLen; };
+
+        explicit RunFiles( size_t nParts )
+        : mNames(nParts), mNKeys(nParts,0ul), mLocks(new std::mutex[nParts])
+        { String head = temp_file::tmpDir() + "/MapReduceEngine.";
+          for ( size_t part = 0; part != nParts; ++part )
+            mNames[part] = temp_file::generateName(
+                                (head+std::to_string(part)+".").c_str()); }
+
+        RunFiles( RunFiles const& ) = delete;
+        RunFiles& operator=( RunFiles const& ) = delete;
+
+        ~RunFiles()
+        { for ( String const& name : mNames )
+            if ( !name.empty() ) Remove(name); }
+
+        size_t getNParts() const { return mNames.size(); }
+        size_t getNKeys( size_t part ) const { return mNKeys[part]; }
+
+        // size of the scratch buffer needed to append nKeys keys
+        static size_t scratchSize( size_t nKeys )
+        { return sizeof(BlockHeader) + compressBound(nKeys*sizeof(Key)); }
+
+        void append( size_t part, Key const* keys, size_t nKeys,
+                        std::vector<char>& scratch )
+        { BlockHeader hdr;
+          hdr.mNKeys = nKeys;
+          uLongf len = scratch.size() - sizeof(hdr);
+          Bytef* dst = reinterpret_cast<Bytef*>(&scratch[sizeof(hdr)]);
+          if ( compress2(dst,&len,reinterpret_cast<Bytef const*>(keys),
+                            nKeys*sizeof(Key),1) != Z_OK )
+            FatalErr("Can't compress keys for " << mNames[part] << '.');
+          hdr.mLen = len;
+          memcpy(&scratch[0],&hdr,sizeof(hdr));
+          std::lock_guard<std::mutex> lock(mLocks[part]);
+          FileWriter(mNames[part],true).write(&scratch[0],sizeof(hdr)+len);
+          mNKeys[part] += nKeys; }
+
+        // reads the partition's keys into keys[0..capacity), and removes its
+        // run file.  whenever the next block won't fit, compact(keys,end) is
+        // called to make room, and returns the new end.  returns the end of
+        // the keys read, or a null pointer if compaction couldn't make room.
+        template <class Compact>
+        Key* read( size_t part, Key* keys, size_t capacity,
+                    std::vector<char>& buf, Compact compact )
+        { FileReader fr(mNames[part]);
+          Key* end = keys;
+          size_t remaining = mNKeys[part];
+          while ( remaining )
+          { BlockHeader hdr;
+            fr.read(&hdr,sizeof(hdr));
+            buf.resize(hdr.mLen);
+            fr.read(&buf[0],hdr.mLen);
+            if ( hdr.mNKeys > remaining )
+              FatalErr("Run file " << mNames[part] << " is corrupt.");
+            if ( hdr.mNKeys > capacity-(end-keys) )
+            { end = compact(keys,end);
+              if ( hdr.mNKeys > capacity-(end-keys) )
+              { end = nullptr;
+                break; } }
+            uLongf len = hdr.mNKeys*sizeof(Key);
+            if ( uncompress(reinterpret_cast<Bytef*>(end),&len,
+                            reinterpret_cast<Bytef const*>(&buf[0]),
+                            hdr.mLen) != Z_OK ||
+                    len != hdr.mNKeys*sizeof(Key) )
+              FatalErr("Run file " << mNames[part] << " is corrupt.");
+            end += hdr.mNKeys;
+            remaining -= hdr.mNKeys; }
+          fr.close();
+          Remove(mNames[part]);
+          mNames[part].clear();
+          return end; }
+
+    private:
+        std::vector<String> mNames;
+        std::vector<size_t> mNKeys;
+        std::unique_ptr<std::mutex[]> mLocks;
+    };
+
+    // A map thread's buffers for each partition.
+    class Spiller
+    {
+    public:
+        Spiller( MapReduceEngine& mre, RunFiles& runs, size_t nKeysPerBuf )
+        : mMRE(mre), mRuns(runs), mNKeysPerBuf(nKeysPerBuf),
+          mBufs(runs.getNParts()), mScratch(RunFiles::scratchSize(nKeysPerBuf))
+        { for ( std::vector<Key>& buf : mBufs )
+            buf.reserve(nKeysPerBuf); }
+
+        void add( Key const& key )
+        { size_t part = mMRE.mHasher(key)%mBufs.size();
+          std::vector<Key>& buf = mBufs[part];
+          buf.push_back(key);
+          if ( buf.size() == mNKeysPerBuf )
+          { mRuns.append(part,&buf[0],buf.size(),mScratch);
+            buf.clear(); } }
+
+        void flush()
+        { for ( size_t part = 0; part != mBufs.size(); ++part )
+          { std::vector<Key>& buf = mBufs[part];
+            if ( !buf.empty() )
+              mRuns.append(part,&buf[0],buf.size(),mScratch);
+            std::vector<Key>().swap(buf); } }
+
+    private:
+        MapReduceEngine& mMRE;
+        RunFiles& mRuns;
+        size_t mNKeysPerBuf;
+        std::vector<std::vector<Key>> mBufs;
+        std::vector<char> mScratch;
+    };
+
+    class SpillItr
+    {
+    public:
+        explicit SpillItr( Spiller* pSpiller ) : mpSpiller(pSpiller) {}
+
+        SpillItr& operator*() { return *this; }
+        SpillItr& operator++() { return *this; }
+        SpillItr& operator++(int) { return *this; }
+
+        Key const& operator=( Key const& key )
+        { mpSpiller->add(key); return key; }
+
+    private:
+        Spiller* mpSpiller;
+    };
+
+    template <class Itr>
+    class ExternalClient
+    {
+    public:
+        ExternalClient( size_t thread, MapReduceEngine& mre, Status& status,
+                        RunFiles& runs, std::atomic_size_t& nextPart,
+                        size_t maxKsPerPart, Itr beg, Itr end )
+        : mMRE(mre), mStatus(status), mRuns(runs), mNextPart(nextPart),
+          mMaxKsPerPart(maxKsPerPart)
+        { size_t nTotInputs = end - beg;
+          size_t nThreads = mStatus.getNThreads();
+          size_t nInputsPerThread = (nTotInputs+nThreads-1)/nThreads;
+          mBeg = beg+std::min(nTotInputs,thread*nInputsPerThread);
+          mEnd = beg+std::min(nTotInputs,(thread+1)*nInputsPerThread); }
+
+        void operator()()
+        {
+            {
+                Spiller spiller(mMRE,mRuns,mStatus.getNKeysPerBatch());
+                SpillItr oItr(&spiller);
+                for ( Itr itr = mBeg; itr != mEnd; ++itr )
+                    mMRE.mImpl.map(itr,oItr);
+                spiller.flush();
+            }
+
+            // all the keys have to be on disk before anyone reduces
+            mStatus.swizDone();
+
+            // a partition that's bigger than its share of memory (because some
+            // key is heavily repeated, say) is compacted as it's read, just as
+            // an in-memory batch is when it fills up
+            std::allocator<Key> alloc;
+            std::vector<char> buf;
+            size_t nParts = mRuns.getNParts();
+            size_t part;
+            while ( (part = mNextPart++) < nParts )
+            {
+                size_t capacity = std::max(mMaxKsPerPart,
+                                            mStatus.getNKeysPerBatch());
+                capacity = std::min(capacity,mRuns.getNKeys(part));
+                Key* keys = alloc.allocate(capacity);
+                Key* keysEnd = mRuns.read(part,keys,capacity,buf,
+                                [this]( Key* beg, Key* end )
+                                { mStatus.incrementNOverflows();
+                                  return mMRE.overflow(beg,end); });
+                if ( keysEnd )
+                    mMRE.reduce(keys,keysEnd);
+                else
+                    mStatus.fail();
+                alloc.deallocate(keys,capacity);
+            }
+        }
+
+    private:
+        MapReduceEngine mMRE;
+        Status& mStatus;
+        RunFiles& mRuns;
+        std::atomic_size_t& mNextPart;
+        size_t mMaxKsPerPart;
+        Itr mBeg;
+        Itr mEnd;
+    };
+
 public:
     MapReduceEngine( Impl const& impl=Impl(),
                         Hash const& hasher=Hash(),
                         Comp const& comparator=Comp() )
-    : mImpl(impl), mHasher(hasher), mComparator(comparator), mFailed(false)
+    : mImpl(impl), mHasher(hasher), mComparator(comparator),
+      mMaxPasses(DEFAULT_MAX_PASSES), mFailed(false)
     {}
 
     ~MapReduceEngine()
@@ -383,6 +602,14 @@ public:
 
     enum class VERBOSITY { SILENT, QUIET, NOISY };
 
+    static size_t const DEFAULT_MAX_PASSES = 4;
+    static size_t const MIN_BATCH_SIZE = 100000;
+
+    // Inputs that would need more than this many in-memory passes are run in
+    // external-memory mode.  Zero means always use external-memory mode.
+    size_t getMaxPasses() const { return mMaxPasses; }
+    void setMaxPasses( size_t maxPasses ) { mMaxPasses = maxPasses; }
+
     // nKs must be an upper bound on the number of Ks produced by mapping the
     // entire input set.  We assume that largish subsets of the input are
     // linearish in their production of Ks.
@@ -400,8 +627,11 @@ public:
 
         // these three consts could be made into an arguments, if necessary
         //size_t const minPasses = 0;
+        // each thread needs room for at least a minimal batch for every
+        // thread, so run fewer of them when memory is short
         size_t const maxMem = MemAvailable(.9);
-        size_t const nThreads = getConfiguredNumThreads();
+        size_t const nThreads = MemBoundedThreads(
+                    MIN_BATCH_SIZE*(getConfiguredNumThreads()+1)*sizeof(Key));
 
         size_t maxKs = meanUsage*nThreads/(nThreads+1)*maxMem/sizeof(Key);
         if ( !maxKs )
@@ -410,14 +640,8 @@ public:
         size_t nPasses = (nKs+maxKs-1)/maxKs;
         if ( nPasses == 0 )
             FatalErr("No work to do. The calling code should watch for this case");
-        size_t const MAX_PASSES = 100;
-        if ( nPasses > MAX_PASSES )
-        {   cout << "\nWell this is unfortunate.  It seems that there is "
-                 << "unsufficient memory.\n"
-                 << "We would need " << nPasses << " passes, but the maximum "
-                 << "allowed here is 100." << endl;
-            cout << "Giving up." << endl << endl;
-            _exit(1);    }
+        if ( nPasses > mMaxPasses )
+            return runExternal(nKs,beg,end,verbose,meanUsage,maxMem,nThreads);
 
         //if ( nPasses < minPasses )
         //    nPasses = minPasses;
@@ -428,13 +652,13 @@ public:
         size_t nKsPerBatch = meanKsPerBatch/meanUsage;
         size_t memUsed = nKsPerBatch*nThreads*(nThreads+1)*sizeof(Key);
         nKsPerBatch = nKsPerBatch*std::min(1.*maxMem/memUsed,2.);
-        size_t const MIN_BATCH_SIZE = 100000;
         if ( nKsPerBatch < MIN_BATCH_SIZE )
             nKsPerBatch = MIN_BATCH_SIZE;
         if ( verbose != VERBOSITY::SILENT )
             std::cout << "Expect " << meanKsPerBatch << " keys per batch.\n"
             "Provide " << nKsPerBatch << " keys per batch." << std::endl;
 
+        StageProfile prof("MapReduceEngine",std::to_string(nPasses)+" passes");
         Status status(nThreads,nPasses,nKsPerBatch);
         std::thread* threads = new std::thread[nThreads];
         for ( size_t thread = 0; thread != nThreads; ++thread )
@@ -495,6 +719,62 @@ public:
     }
 
 private:
+    // Map the input once, spilling the keys into hash-partitioned run files,
+    // and then have each thread read back and reduce a partition at a time.
+    template <class Itr>
+    bool runExternal( size_t nKs, Itr beg, Itr end, VERBOSITY verbose,
+                        double meanUsage, size_t maxMem, size_t nThreads )
+    {
+        static_assert(std::is_trivially_copyable<Key>::value,
+                "External-memory mode requires a trivially copyable Key.");
+
+        // a partition has to fit in a thread's share of memory, with a factor
+        // of 2 to spare for uneven hashing
+        size_t maxKsPerPart = meanUsage*maxMem/nThreads/sizeof(Key)/2;
+        if ( !maxKsPerPart )
+            FatalErr("Insufficient memory.");
+        size_t nParts = std::max((nKs+maxKsPerPart-1)/maxKsPerPart,4*nThreads);
+
+        // the map threads' buffers get the other half of the memory
+        size_t const MAX_BUF_BYTES = 1ul << 20;
+        size_t nKsPerBuf = meanUsage*maxMem/2/nThreads/nParts/sizeof(Key);
+        nKsPerBuf = std::min(nKsPerBuf,MAX_BUF_BYTES/sizeof(Key));
+        if ( !nKsPerBuf )
+            nKsPerBuf = 1;
+        if ( verbose != VERBOSITY::SILENT )
+            std::cout << "Spilling keys to " << nParts << " partitions on disk "
+                "using buffers of " << nKsPerBuf << " keys." << std::endl;
+
+        StageProfile prof("MapReduceEngine",
+                            std::to_string(nParts)+" partitions on disk");
+        RunFiles runs(nParts);
+        Status status(nThreads,1,nKsPerBuf);
+        std::atomic_size_t nextPart(0);
+        std::thread* threads = new std::thread[nThreads];
+        for ( size_t thread = 0; thread != nThreads; ++thread )
+            threads[thread] = std::thread(ExternalClient<Itr>(thread,*this,
+                                                status,runs,nextPart,
+                                                maxKsPerPart,beg,end));
+        for ( size_t thread = 0; thread != nThreads; ++thread )
+            threads[thread].join();
+        delete [] threads;
+
+        if ( (mFailed = !status.OK()) )
+            std::cout << "Map/Reduce operation has failed:  a partition "
+                            "wouldn't fit in memory." << std::endl;
+
+        if ( verbose != VERBOSITY::SILENT )
+        {
+            size_t nOverflows = status.getNOverflows();
+            if ( nOverflows )
+                std::cout << "There were " << nOverflows
+                            << " partition overflows." << std::endl;
+        }
+
+        omp_set_num_threads(getConfiguredNumThreads());
+        return status.OK();
+    }
+
     template <class Itr>
     void runSingleThreaded( size_t nKs, Itr itr, Itr end )
     { std::vector<Key> keys;
@@ -539,6 +819,7 @@ private:
     Impl mImpl;
     Hash mHasher;
     Comp mComparator;
+    size_t mMaxPasses;
     bool mFailed;
 };
 
@@ -689,6 +689,8 @@ template<class T> Bool Meet2( vec<T> v1, vec<T> v2 )
 /// For example, if you had a vector of edge ids for each read, calling this
 /// would return a vector of read ids for each edge.  As a bonus, the read ids
 /// are sorted.
+/// To index a large ReadPathVec this way, see ReadPathIndex in
+/// paths/long/ReadPathIndex.h, which is built in parallel and stored flat.
 template <class VVIn, class VVOut>
 void invert( VVIn const& in, VVOut& out, size_t minOutSize=0 )
 {
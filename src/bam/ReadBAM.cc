@@ -17,12 +17,15 @@
 #include "ParallelVecUtilities.h"
 #include "system/LockedData.h"
 #include "system/SortInPlace.h"
+#include "system/SysConf.h"
 #include <algorithm>
 #include <array>
 #include <cstdint>
 #include <cstring>
+#include <limits>
 #include <istream>
 #include <thread>
+#include <vector>
 // MakeDepend: library ZLIB
 #include <zlib.h>
 #include <iostream>
@@ -249,58 +252,126 @@ bool BAMbuf::readBlock()
 }
 #endif
 
+// reads the next BGZF block into filBuf.  returns false at end of file.
+bool readBGZFBlock( FileReader const& fr, char* filBuf, size_t blockNo )
+{
+    size_t nRead;
+    GZipHeader const& hdr = *reinterpret_cast<GZipHeader*>(filBuf);
+    if ( (nRead = fr.readSome(filBuf,sizeof(hdr))) != sizeof(hdr) )
+    {
+        if ( !nRead )
+            return false;
+        BAMERR(fr.getFilename(),
+                " is corrupt.  Partial GZIP header at block " << blockNo+1);
+    }
+    if ( !hdr.isBGZFBlock() )
+        BAMERR(fr.getFilename(),
+                " is uninterpretable as BGZF at block " << blockNo+1);
+
+    char* itr = filBuf + sizeof(hdr);
+    size_t remain = hdr.getBlockLen() - sizeof(hdr);
+    if ( (nRead = fr.readSome(itr,remain)) != remain )
+        BAMERR(fr.getFilename()," is truncated in block " << blockNo+1);
+    return true;
+}
+
+// inflates the block in filBuf into infBuf, leaving room for a put-back char
+// at the front.
+void inflateBGZFBlock( std::string const& fileName, char* filBuf, char* infBuf,
+                        size_t infBufSiz, size_t* pLen, size_t blockNo )
+{
+    GZipHeader const& hdr = *reinterpret_cast<GZipHeader*>(filBuf);
+    char* itr = filBuf + sizeof(hdr);
+    char* end = filBuf + hdr.getBlockLen();
+    if ( hdr.hasFName() ) itr += strlen(itr)+1;
+    if ( hdr.hasComment() ) itr += strlen(itr)+1;
+    if ( hdr.hasHdrCRC() ) itr += 2;
+
+    *pLen = 0;
+    end -= sizeof(GZipFooter);
+    if ( itr == end ) return; // read an empty block
+    else if ( itr > end )
+        BAMERR(fileName,
+                " has bogus block length at block " << blockNo+1);
+
+    z_stream zs;
+    zs.zalloc = nullptr;
+    zs.zfree = nullptr;
+    zs.opaque = nullptr;
+    zs.data_type = Z_BINARY;
+    zs.next_in = reinterpret_cast<uint8_t*>(itr);
+    zs.avail_in = end-itr;
+    zs.next_out = reinterpret_cast<uint8_t*>(infBuf+1);
+    zs.avail_out = infBufSiz-1;
+
+    if ( ::inflateInit2(&zs,-15) != Z_OK ||
+            ::inflate(&zs,Z_FINISH) != Z_STREAM_END ||
+            ::inflateEnd(&zs) != Z_OK ||
+            GZipFooter(end) != GZipFooter(zs) ||
+            zs.avail_in )
+        BAMERR(fileName,
+                " can't be unzipped at block " << blockNo+1);
+    *pLen = zs.total_out;
+}
+
 // a streambuf that grabs the next decompressed BGZF block on underflow.
-// this version uses one thread to unzip while the main thread reads aligns.
-// it appears that unzipping is just a bit slower than processing aligns.
+// BGZF blocks are independent, so this version has a pool of threads that
+// inflate blocks concurrently into a ring of slots.  the file is read
+// sequentially (the threads take turns reading the next block), and the
+// blocks are handed to the main thread, which reads aligns, in file order.
 class BAMbuf : public std::streambuf
 {
 public:
-    BAMbuf( String const& bamFile )
-    : mFR(bamFile), mBlockNo(0), mBufAvailable(mLock), mBufConsumed(mLock),
-      mBeg(nullptr), mNext(nullptr), mEnd(nullptr), mQuit(false),
-      mUnzipThread([this](){unzipBlocks();})
-    { char* end = &mInfBuf[0].back(); setg(&mInfBuf[0].front(),end,end); }
+    BAMbuf( String const& bamFile, unsigned nThreads )
+    : mFR(bamFile), mNSlots(4*nThreads), mSlots(new Slot[mNSlots]),
+      mpCurSlot(nullptr), mNextRead(0), mNextConsume(0), mEOF(false),
+      mQuit(false), mPutBack{0}, mSlotFree(mLock), mSlotReady(mLock)
+    { char* end = &mPutBack[1]; setg(&mPutBack[0],end,end);
+      mThreads.reserve(nThreads);
+      for ( unsigned idx = 0; idx != nThreads; ++idx )
+          mThreads.emplace_back([this](){unzipBlocks();}); }
 
     BAMbuf( BAMbuf const& )=delete;
 
     ~BAMbuf()
     { if ( true )
-      { Locker locker(mLock); mQuit = true; mBeg = nullptr; }
-      mBufConsumed.signal(); mUnzipThread.join(); }
+      { Locker locker(mLock); mQuit = true; }
+      mSlotFree.broadcast();
+      for ( std::thread& thread : mThreads ) thread.join();
+      delete [] mSlots; }
 
     BAMbuf& operator=( BAMbuf const& )=delete;
 
 private:
     int_type underflow() override;
     void unzipBlocks();
-    bool offerBuf( char* beg, char* next, char* end )
-    {
-        Locker locker(mLock);
-        while ( mBeg )
-            locker.wait(mBufConsumed);
-        if ( mQuit )
-            return true;
-        mNext = next;
-        mEnd = end;
-        mBeg = beg;
-        return false;
-    }
 
     static size_t const FIL_BUF_SIZ = 64*1024ul;
-    static size_t const INF_BUF_SIZ = 256*1024ul;
+    static size_t const INF_BUF_SIZ = 64*1024ul+1; // BGZF max, plus put-back
+
+    enum class State { FREE, INFLATING, READY, END };
+    struct Slot
+    {
+        Slot() : mState(State::FREE), mLen(0) {}
+        State mState;
+        size_t mLen;
+        std::array<char,FIL_BUF_SIZ> mFilBuf;
+        std::array<char,INF_BUF_SIZ> mInfBuf;
+    };
 
     FileReader mFR;
-    size_t mBlockNo;
-    std::array<char,FIL_BUF_SIZ> mFilBuf;
-    std::array<char,INF_BUF_SIZ> mInfBuf[3];
-    LockedData mLock;
-    Condition mBufAvailable;
-    Condition mBufConsumed;
-    char* mBeg;
-    char* mNext;
-    char* mEnd;
+    size_t mNSlots;
+    Slot* mSlots;
+    Slot* mpCurSlot;
+    size_t mNextRead;
+    size_t mNextConsume;
+    bool mEOF;
     bool mQuit;
-    std::thread mUnzipThread;
+    char mPutBack[1];
+    LockedData mLock;
+    Condition mSlotFree;
+    Condition mSlotReady;
+    std::vector<std::thread> mThreads;
 };
 
 std::streambuf::int_type BAMbuf::underflow()
@@ -308,17 +379,33 @@ std::streambuf::int_type BAMbuf::underflow()
     if ( gptr() == egptr() )
     {
         char putBackChr = gptr()[-1];
+        Slot* pSlot;
         if ( true )
         {
             Locker locker(mLock);
-            while ( !mBeg )
-                locker.wait(mBufAvailable);
-            if ( mNext == mEnd )
-                return traits_type::eof();
-            setg(mBeg,mNext,mEnd);
-            mBeg = nullptr;
+            if ( mpCurSlot )
+            {
+                mpCurSlot->mState = State::FREE;
+                mpCurSlot = nullptr;
+                mSlotFree.broadcast();
+            }
+            while ( true )
+            {
+                pSlot = &mSlots[mNextConsume%mNSlots];
+                while ( pSlot->mState != State::READY &&
+                        pSlot->mState != State::END )
+                    locker.wait(mSlotReady);
+                if ( pSlot->mState == State::END )
+                    return traits_type::eof();
+                mNextConsume += 1;
+                if ( pSlot->mLen ) break;
+                pSlot->mState = State::FREE; // skip an empty block
+                mSlotFree.broadcast();
+            }
+            mpCurSlot = pSlot;
         }
-        mBufConsumed.signal();
+        char* beg = &pSlot->mInfBuf.front();
+        setg(beg,beg+1,beg+1+pSlot->mLen);
         *eback() = putBackChr;
     }
     return traits_type::to_int_type(*gptr());
@@ -326,77 +413,129 @@ std::streambuf::int_type BAMbuf::underflow()
 
 void BAMbuf::unzipBlocks()
 {
-    size_t bufId = 0;
     while ( true )
     {
-        char* infBuf = &mInfBuf[bufId].front();
-        size_t nRead;
-        char* filBuf = &mFilBuf.front();
-        GZipHeader const& hdr = *reinterpret_cast<GZipHeader*>(filBuf);
-        if ( (nRead = mFR.readSome(filBuf,sizeof(hdr))) != sizeof(hdr) )
+        Slot* pSlot;
+        size_t blockNo;
+        if ( true )
         {
-            if ( !nRead )
+            Locker locker(mLock);
+            while ( !mQuit && !mEOF &&
+                    mSlots[mNextRead%mNSlots].mState != State::FREE )
+                locker.wait(mSlotFree);
+            if ( mQuit || mEOF )
+                break;
+            blockNo = mNextRead++;
+            pSlot = &mSlots[blockNo%mNSlots];
+            if ( !readBGZFBlock(mFR,&pSlot->mFilBuf.front(),blockNo) )
             {
-                if ( !offerBuf(infBuf,infBuf,infBuf) )
-                    mBufAvailable.signal();
+                mEOF = true;
+                pSlot->mState = State::END;
+                mSlotReady.broadcast();
+                mSlotFree.broadcast();
                 break;
             }
-            BAMERR(mFR.getFilename(),
-                    " is corrupt.  Partial GZIP header at block " << mBlockNo+1);
+            pSlot->mState = State::INFLATING;
         }
-        ++mBlockNo;
-        if ( !hdr.isBGZFBlock() )
-            BAMERR(mFR.getFilename(),
-                    " is uninterpretable as BGZF at block " << mBlockNo);
-
-        char* itr = filBuf + sizeof(hdr);
-        char* end = filBuf + hdr.getBlockLen();
-        size_t remain = end - itr;
-        if ( (nRead = mFR.readSome(itr,remain)) != remain )
-            BAMERR(mFR.getFilename()," is truncated in block " << mBlockNo);
-
-        if ( hdr.hasFName() ) itr += strlen(itr)+1;
-        if ( hdr.hasComment() ) itr += strlen(itr)+1;
-        if ( hdr.hasHdrCRC() ) itr += 2;
-
-        end -= sizeof(GZipFooter);
-        if ( itr == end ) continue; // read an empty block
-        else if ( itr > end )
-            BAMERR(mFR.getFilename(),
-                    " has bogus block length at block " << mBlockNo);
-
-        z_stream zs;
-        zs.zalloc = nullptr;
-        zs.zfree = nullptr;
-        zs.opaque = nullptr;
-        zs.data_type = Z_BINARY;
-        zs.next_in = reinterpret_cast<uint8_t*>(itr);
-        zs.avail_in = end-itr;
-        zs.next_out = reinterpret_cast<uint8_t*>(infBuf+1);
-        zs.avail_out = INF_BUF_SIZ-1;
-
-        if ( ::inflateInit2(&zs,-15) != Z_OK ||
-                ::inflate(&zs,Z_FINISH) != Z_STREAM_END ||
-                ::inflateEnd(&zs) != Z_OK ||
-                GZipFooter(end) != GZipFooter(zs) ||
-                zs.avail_in )
-            BAMERR(mFR.getFilename(),
-                    " can't be unzipped at block " << mBlockNo);
-
-        if ( zs.total_out )
+        inflateBGZFBlock(mFR.getFilename(),&pSlot->mFilBuf.front(),
+                            &pSlot->mInfBuf.front(),INF_BUF_SIZ,
+                            &pSlot->mLen,blockNo);
+        if ( true )
         {
-            char* next = reinterpret_cast<char*>(zs.next_out-zs.total_out);
-            if ( offerBuf(infBuf,next,next+zs.total_out) ) break;
-            mBufAvailable.signal();
-            if ( ++bufId == 3 ) bufId = 0;
+            Locker locker(mLock);
+            pSlot->mState = State::READY;
         }
+        mSlotReady.broadcast();
+    }
+}
+
+// a streambuf over a BGZF file that can be positioned at a BAM "virtual file
+// offset" (i.e., the offset of a BGZF block in the file in the upper 48 bits,
+// and the offset in the inflated block in the lower 16 bits).  blocks are
+// inflated serially, which is appropriate for reading small regions.
+class BGZFSeekBuf : public std::streambuf
+{
+public:
+    explicit BGZFSeekBuf( String const& bamFile )
+    : mFR(bamFile), mBlockOff(0), mNextBlockOff(0), mBlockNo(0),
+      mLoaded(false)
+    { char* end = &mInfBuf[1]; mInfBuf[0] = 0; setg(&mInfBuf[0],end,end); }
+
+    BGZFSeekBuf( BGZFSeekBuf const& )=delete;
+    BGZFSeekBuf& operator=( BGZFSeekBuf const& )=delete;
+
+    void seekVirtual( uint64_t vOff );
+
+    uint64_t tellVirtual() const
+    { if ( gptr() == egptr() ) return mNextBlockOff << 16;
+      return mBlockOff << 16 | (gptr()-&mInfBuf[1]); }
+
+private:
+    int_type underflow() override;
+    bool loadBlock();
+
+    static size_t const FIL_BUF_SIZ = 64*1024ul;
+    static size_t const INF_BUF_SIZ = 64*1024ul+1; // BGZF max, plus put-back
+
+    FileReader mFR;
+    uint64_t mBlockOff;
+    uint64_t mNextBlockOff;
+    size_t mBlockNo;
+    bool mLoaded;
+    std::array<char,FIL_BUF_SIZ> mFilBuf;
+    std::array<char,INF_BUF_SIZ> mInfBuf;
+};
+
+void BGZFSeekBuf::seekVirtual( uint64_t vOff )
+{
+    uint64_t blockOff = vOff >> 16;
+    size_t inBlockOff = vOff & 0xffff;
+    if ( !mLoaded || blockOff != mBlockOff )
+    {
+        mFR.seek(blockOff);
+        mNextBlockOff = blockOff;
+        if ( !loadBlock() )
+            BAMERR(mFR.getFilename()," has an index that points past the end "
+                    "of the file");
+    }
+    if ( &mInfBuf[1]+inBlockOff > egptr() )
+        BAMERR(mFR.getFilename()," has an index with a bad offset");
+    setg(&mInfBuf[0],&mInfBuf[1]+inBlockOff,egptr());
+}
+
+bool BGZFSeekBuf::loadBlock()
+{
+    mBlockOff = mNextBlockOff;
+    mLoaded = false;
+    if ( !readBGZFBlock(mFR,&mFilBuf.front(),mBlockNo) )
+        return false;
+    mLoaded = true;
+    mNextBlockOff = mFR.tell();
+    size_t len;
+    inflateBGZFBlock(mFR.getFilename(),&mFilBuf.front(),&mInfBuf.front(),
+                        INF_BUF_SIZ,&len,mBlockNo++);
+    setg(&mInfBuf[0],&mInfBuf[1],&mInfBuf[1]+len);
+    return true;
+}
+
+std::streambuf::int_type BGZFSeekBuf::underflow()
+{
+    while ( gptr() == egptr() )
+    {
+        char putBackChr = gptr()[-1];
+        if ( !loadBlock() )
+            return traits_type::eof();
+        *eback() = putBackChr;
     }
+    return traits_type::to_int_type(*gptr());
 }
 
 // read over the header and dictionary part of a BAM file, leaving us
-// positioned at the alignments section
+// positioned at the alignments section.  optionally returns the names of the
+// reference sequences.
 
-void skipToAligns( std::istream& is, String const& bamFile )
+void skipToAligns( std::istream& is, String const& bamFile,
+                    vec<String>* pRefNames = nullptr )
 {
     uint32_t val;
     if ( !is.read(reinterpret_cast<char*>(&val),sizeof(val)) )
@@ -414,13 +553,144 @@ void skipToAligns( std::istream& is, String const& bamFile )
     {
         if ( !is.read(reinterpret_cast<char*>(&val),sizeof(val)) )
             BAMERR(bamFile," is truncated in ref desc len");
-        if ( !is.ignore(val) )
+        if ( pRefNames && val )
+        {
+            String name(val-1,' ');
+            if ( !is.read(&name.front(),val-1) || !is.ignore(1) )
+                BAMERR(bamFile," is truncated at ref desc name");
+            pRefNames->push_back(name);
+        }
+        else if ( !is.ignore(val) )
             BAMERR(bamFile," is truncated at ref desc name");
         if ( !is.read(reinterpret_cast<char*>(&val),sizeof(val)) )
             BAMERR(bamFile," is truncated in ref desc size");
     }
 }
 
+// reads the rest of an alignment, after its header, into seq, quals, and
+// readName.  if pCigar is non-null, the cigar ops are returned there.
+
+void readAlign( std::istream& is, const String& bamFile, size_t alnNo,
+        BAMAlignHead const& alnHd, RNGen& rng, std::vector<char>& nibbleSeq,
+        basevector& seq, qvec& quals, String& readName,
+        std::vector<uint32_t>* pCigar = nullptr )
+{
+     readName.reserve(alnHd.mNameLen + 1);
+     readName.resize(alnHd.mNameLen - 1);
+     if ( !is.read(&readName.front(), alnHd.mNameLen - 1) || !is.ignore(1) )
+          BAMERR(bamFile," is truncated in read name of alignment " << alnNo);
+     readName.push_back('.');
+     if ( alnHd.isFirstRead() ) readName.push_back('1');
+     else if ( alnHd.isSecondRead() ) readName.push_back('2');
+     else readName.push_back('3');
+
+     if ( pCigar )
+     {    pCigar->resize(alnHd.mCigarLen);
+          if ( !is.read(reinterpret_cast<char*>(pCigar->data()),
+                    4 * alnHd.mCigarLen) )
+               BAMERR(bamFile," is truncated in cigar of alignment "
+                    << alnNo);    }
+     else if ( !is.ignore(4 * alnHd.mCigarLen) )
+          BAMERR(bamFile," is truncated in cigar of alignment " << alnNo);
+
+     seq.reserve(alnHd.mSeqLen);
+     nibbleSeq.resize((alnHd.mSeqLen+1)/2);
+     char* nibbles = &nibbleSeq.front();
+     if ( !is.read(nibbles,nibbleSeq.size()) )
+         BAMERR(bamFile," is truncated in seq of alignment " << alnNo);
+     char packedSeq = 0;
+     for ( unsigned idx = 0; idx != alnHd.mSeqLen; ++idx )
+     {   if ( idx & 1 ) packedSeq <<= 4;
+         else packedSeq = *nibbles++;
+         char bits = (packedSeq >> 4) & 0x0f;
+         if ( !bits )
+             BAMERR(bamFile," has uninterpretable seq data in alignment "
+                         << alnNo);
+         seq.push_back(GeneralizedBase::fromBits(bits).random(rng));    }
+
+    quals.resize(alnHd.mSeqLen);
+    char* qBuf = reinterpret_cast<char*>(&quals.front());
+    if ( !is.read(qBuf,alnHd.mSeqLen) )
+        BAMERR(bamFile," is truncated in quals of alignment " << alnNo);
+
+    long auxLen = alnHd.remainingLen() - alnHd.mNameLen
+                - 4*alnHd.mCigarLen - (alnHd.mSeqLen + 1)/2 - alnHd.mSeqLen;
+    while ( auxLen > 0 )
+    {
+        char tag[3];
+        if ( !is.read(tag, sizeof(tag)) )
+            BAMERR(bamFile," is truncated in tag header for alignment "
+                    << alnNo);
+        auxLen -= 3;
+        int tagLen = getTagLength(tag[2]);
+        if ( tagLen == -1 )
+            BAMERR(bamFile," has bad data type in tag header for alignment "
+                    << alnNo);
+        if ( tag[2] == 'B' )
+        {
+            char dataType;
+            uint32_t arrLen;
+            if ( !is.get(dataType)
+                    || !is.read(reinterpret_cast<char*>(&arrLen),
+                            sizeof(arrLen)) )
+                BAMERR(bamFile,
+                        " is truncated in B tag header for alignment "
+                           << alnNo);
+            tagLen = getTagLength(dataType);
+            if ( tagLen <= 0 )
+                BAMERR(bamFile,
+                        " has bad data type in B tag header for alignment "
+                            << alnNo);
+            tagLen *= arrLen;
+            auxLen -= 5;
+        }
+
+        if ( tagLen )
+        {
+            if ( !is.ignore(tagLen) )
+                BAMERR(bamFile," is truncated in tag data for alignment "
+                            << alnNo);
+            auxLen -= tagLen;
+        }
+        else if ( tag[0] == 'O' && tag[1] == 'Q' )
+        {
+            if ( tag[2] != 'Z' )
+                BAMERR(bamFile," contains OM tag with non-Z data type "
+                                "for alignment " << alnNo);
+            if ( !is.read(qBuf,alnHd.mSeqLen) )
+                BAMERR(bamFile," is truncated in OM tag"
+                                " data for alignment " << alnNo);
+            for ( unsigned char& val : quals )
+                val -= 33;
+            char byte;
+            if ( !is.get(byte) || byte )
+                BAMERR(bamFile," contains OM tag with the wrong length "
+                                "for alignment " << alnNo);
+            auxLen -= alnHd.mSeqLen + 1;
+        }
+        else // has to be H or Z tag type
+        {    char byte;
+             do
+             {    if ( !is.get(byte) )
+                       BAMERR(bamFile," is truncated in null-delimited tag"
+                                    " data for alignment " << alnNo);
+                  auxLen -= 1;    }
+             while ( byte );    }
+    }
+
+     if ( auxLen < 0 )
+          BAMERR(bamFile," has bogus alignment block len for alignment "
+               << alnNo);
+
+     if ( alnHd.mFlags & BAMAlignHead::FLAG_REVERSED )
+     {    seq.ReverseComplement( );
+          quals.ReverseMe( );    }
+}
+
+bool isSkipped( BAMAlignHead const& alnHd, bool pfOnly )
+{    return (pfOnly && !(alnHd.mFlags & BAMAlignHead::FLAG_PF)) ||
+          (alnHd.mFlags & BAMAlignHead::FLAG_SECONDARY_ALIGNMENT);    }
+
 void readAligns( std::istream& is, const String& bamFile, 
         MempoolAllocator<char> const& alloc, bool pfOnly, 
         vecbasevector& reads_b, VecPQVec& reads_q, vecString& reads_n )
@@ -442,8 +712,7 @@ void readAligns( std::istream& is, const String& bamFile,
      {    ++alnNo;
           if ( !is.read(reinterpret_cast<char*>(&alnHd), sizeof(alnHd)) )
                BAMERR(bamFile," is truncated in alignment " << alnNo);
-          if ( (pfOnly && !(alnHd.mFlags & BAMAlignHead::FLAG_PF)) ||
-               (alnHd.mFlags & BAMAlignHead::FLAG_SECONDARY_ALIGNMENT) )
+          if ( isSkipped(alnHd,pfOnly) )
           {    if ( !is.ignore(alnHd.remainingLen()) )
                     BAMERR(bamFile," is truncated in skipped alignment " << alnNo);
                continue;    }
@@ -454,111 +723,8 @@ void readAligns( std::istream& is, const String& bamFile,
           basevector& seq = reads_b.back();
           String& readName = reads_n.back();
 
-          readName.reserve(alnHd.mNameLen + 1);
-          readName.resize(alnHd.mNameLen - 1);
-          if ( !is.read(&readName.front(), alnHd.mNameLen - 1) || !is.ignore(1) )
-               BAMERR(bamFile," is truncated in read name of alignment " << alnNo);
-          readName.push_back('.');
-          if ( alnHd.isFirstRead() ) readName.push_back('1');
-          else if ( alnHd.isSecondRead() ) readName.push_back('2');
-          else readName.push_back('3');
-
-          if ( !is.ignore(4 * alnHd.mCigarLen) )
-               BAMERR(bamFile," is truncated in cigar of alignment " << alnNo);
-
-          seq.reserve(alnHd.mSeqLen);
-          nibbleSeq.resize((alnHd.mSeqLen+1)/2);
-          char* nibbles = &nibbleSeq.front();
-          if ( !is.read(nibbles,nibbleSeq.size()) )
-              BAMERR(bamFile," is truncated in seq of alignment " << alnNo);
-          char packedSeq = 0;
-          for ( unsigned idx = 0; idx != alnHd.mSeqLen; ++idx )
-          {   if ( idx & 1 ) packedSeq <<= 4;
-              else packedSeq = *nibbles++;
-              char bits = (packedSeq >> 4) & 0x0f;
-              if ( !bits )
-                  BAMERR(bamFile," has uninterpretable seq data in alignment "
-                              << alnNo);
-              seq.push_back(GeneralizedBase::fromBits(bits).random(rng));    }
-  
-        qvec& quals = qualsbuf[qbcount];
-        qbcount++;
-        quals.resize(alnHd.mSeqLen);
-        char* qBuf = reinterpret_cast<char*>(&quals.front());
-        if ( !is.read(qBuf,alnHd.mSeqLen) )
-            BAMERR(bamFile," is truncated in quals of alignment " << alnNo);
-
-        long auxLen = alnHd.remainingLen() - alnHd.mNameLen
-                    - 4*alnHd.mCigarLen - (alnHd.mSeqLen + 1)/2 - alnHd.mSeqLen;
-        while ( auxLen > 0 )
-        {
-            char tag[3];
-            if ( !is.read(tag, sizeof(tag)) )
-                BAMERR(bamFile," is truncated in tag header for alignment "
-                        << alnNo);
-            auxLen -= 3;
-            int tagLen = getTagLength(tag[2]);
-            if ( tagLen == -1 )
-                BAMERR(bamFile," has bad data type in tag header for alignment "
-                        << alnNo);
-            if ( tag[2] == 'B' )
-            {
-                char dataType;
-                uint32_t arrLen;
-                if ( !is.get(dataType)
-                        || !is.read(reinterpret_cast<char*>(&arrLen),
-                                sizeof(arrLen)) )
-                    BAMERR(bamFile,
-                            " is truncated in B tag header for alignment "
-                               << alnNo);
-                tagLen = getTagLength(dataType);
-                if ( tagLen <= 0 )
-                    BAMERR(bamFile,
-                            " has bad data type in B tag header for alignment "
-                                << alnNo);
-                tagLen *= arrLen;
-                auxLen -= 5;
-            }
-
-            if ( tagLen )
-            {
-                if ( !is.ignore(tagLen) )
-                    BAMERR(bamFile," is truncated in tag data for alignment "
-                                << alnNo);
-                auxLen -= tagLen;
-            }
-            else if ( tag[0] == 'O' && tag[1] == 'Q' )
-            {
-                if ( tag[2] != 'Z' )
-                    BAMERR(bamFile," contains OM tag with non-Z data type "
-                                    "for alignment " << alnNo);
-                if ( !is.read(qBuf,alnHd.mSeqLen) )
-                    BAMERR(bamFile," is truncated in OM tag"
-                                    " data for alignment " << alnNo);
-                for ( unsigned char& val : quals )
-                    val -= 33;
-                char byte;
-                if ( !is.get(byte) || byte )
-                    BAMERR(bamFile," contains OM tag with the wrong length "
-                                    "for alignment " << alnNo);
-                auxLen -= alnHd.mSeqLen + 1;
-            }
-            else // has to be H or Z tag type
-            {    char byte;
-                 do
-                 {    if ( !is.get(byte) )
-                           BAMERR(bamFile," is truncated in null-delimited tag"
-                                        " data for alignment " << alnNo);
-                      auxLen -= 1;    }
-                 while ( byte );    }
-        }
-
-     if ( auxLen < 0 )
-          BAMERR(bamFile," has bogus alignment block len for alignment " << alnNo);
-
-     if ( alnHd.mFlags & BAMAlignHead::FLAG_REVERSED )
-     {    seq.ReverseComplement( );
-          quals.ReverseMe( );    }
+          readAlign( is, bamFile, alnNo, alnHd, rng, nibbleSeq, seq,
+               qualsbuf[qbcount++], readName );
 
      // Convert a batch of quality scores.
 
@@ -576,6 +742,159 @@ void readAligns( std::istream& is, const String& bamFile,
 
 }
 
+// a span of a BAM file, as a pair of virtual file offsets
+struct BAIChunk
+{
+    uint64_t mBeg;
+    uint64_t mEnd;
+
+    friend bool operator<( BAIChunk const& c1, BAIChunk const& c2 )
+    { return c1.mBeg < c2.mBeg; }
+};
+
+// the bins of the BAM binning scheme that overlap [beg,end)
+void reg2bins( int beg, int end, std::vector<uint32_t>* pBins )
+{
+    if ( end > 1<<29 ) end = 1<<29;
+    --end;
+    pBins->push_back(0);
+    for ( int k = 1 + (beg>>26); k <= 1 + (end>>26); ++k ) pBins->push_back(k);
+    for ( int k = 9 + (beg>>23); k <= 9 + (end>>23); ++k ) pBins->push_back(k);
+    for ( int k = 73 + (beg>>20); k <= 73 + (end>>20); ++k )
+        pBins->push_back(k);
+    for ( int k = 585 + (beg>>17); k <= 585 + (end>>17); ++k )
+        pBins->push_back(k);
+    for ( int k = 4681 + (beg>>14); k <= 4681 + (end>>14); ++k )
+        pBins->push_back(k);
+}
+
+// uses the BAI index to find the sorted, non-overlapping chunks of the BAM file
+// that may contain alignments to [beg,end) on reference sequence refID.
+std::vector<BAIChunk> findChunks( String const& bamFile, int refID,
+                                    int beg, int end )
+{
+    String baiFile = bamFile + ".bai";
+    if ( !IsRegularFile(baiFile) && bamFile.Contains(".bam",-1) )
+        baiFile = bamFile.substr(0,bamFile.size()-4) + ".bai";
+    if ( !IsRegularFile(baiFile) )
+        FatalErr("Can't find the index for BAM file " << bamFile << ".\n"
+                  "Please index it with a tool such as samtools index.");
+
+    FileReader fr(baiFile);
+    std::vector<char> bai(fr.getSize());
+    fr.read(bai.data(),bai.size());
+    char const* itr = bai.data();
+    char const* stop = itr + bai.size();
+    auto get = [&itr,stop,&baiFile]( size_t len )
+    { if ( size_t(stop-itr) < len ) FatalErr(baiFile << " is truncated.");
+      char const* result = itr; itr += len; return result; };
+    auto get32 = [&get]()
+    { uint32_t val; memcpy(&val,get(sizeof(val)),sizeof(val)); return val; };
+
+    if ( memcmp(get(4),"BAI\1",4) )
+        FatalErr(baiFile << " is not a BAM index.");
+    std::vector<BAIChunk> chunks;
+    if ( refID < 0 || uint32_t(refID) >= get32() )
+        return chunks;
+    for ( int ref = 0; ref < refID; ++ref )
+    {
+        uint32_t nBins = get32();
+        while ( nBins-- )
+        {
+            get32();
+            get(sizeof(BAIChunk)*get32());
+        }
+        get(sizeof(uint64_t)*get32());
+    }
+
+    std::vector<uint32_t> bins;
+    reg2bins(beg,end,&bins);
+    uint32_t nBins = get32();
+    while ( nBins-- )
+    {
+        uint32_t bin = get32();
+        uint32_t nChunks = get32();
+        char const* pChunks = get(sizeof(BAIChunk)*nChunks);
+        // pseudo-bin 37450 holds metadata, not chunks
+        if ( bin == 37450 || !std::binary_search(bins.begin(),bins.end(),bin) )
+            continue;
+        size_t off = chunks.size();
+        chunks.resize(off+nChunks);
+        memcpy(&chunks[off],pChunks,sizeof(BAIChunk)*nChunks);
+    }
+
+    // the linear index gives the lowest offset of an alignment that overlaps
+    // the 16kb window containing beg
+    uint32_t nIntervals = get32();
+    char const* pIntervals = get(sizeof(uint64_t)*nIntervals);
+    uint64_t minOff = 0;
+    if ( uint32_t(beg>>14) < nIntervals )
+        memcpy(&minOff,pIntervals+sizeof(uint64_t)*(beg>>14),sizeof(minOff));
+
+    auto dead = [minOff]( BAIChunk const& chunk )
+                { return chunk.mEnd <= minOff; };
+    chunks.erase(std::remove_if(chunks.begin(),chunks.end(),dead),chunks.end());
+    std::sort(chunks.begin(),chunks.end());
+    std::vector<BAIChunk> merged;
+    for ( BAIChunk const& chunk : chunks )
+    {
+        if ( !merged.empty() && chunk.mBeg <= merged.back().mEnd )
+            merged.back().mEnd = std::max(merged.back().mEnd,chunk.mEnd);
+        else
+            merged.push_back(chunk);
+    }
+    return merged;
+}
+
+// reads the alignments in the given chunks that overlap [beg,end) on reference
+// sequence refID
+void readRegionAligns( BGZFSeekBuf& buf, std::istream& is,
+        const String& bamFile, MempoolAllocator<char> const& alloc, bool pfOnly,
+        int refID, int beg, int end, std::vector<BAIChunk> const& chunks,
+        vecbasevector& reads_b, VecPQVec& reads_q, vecString& reads_n )
+{
+     vec<qvec> quals;
+     BAMAlignHead alnHd;
+     size_t alnNo = 0;
+     RNGen rng;
+     std::vector<char> nibbleSeq;
+     std::vector<uint32_t> cigar;
+     for ( BAIChunk const& chunk : chunks )
+     {    buf.seekVirtual(chunk.mBeg);
+          is.clear( );
+          while ( buf.tellVirtual( ) < chunk.mEnd
+               && is.peek() != std::istream::traits_type::eof() )
+          {    ++alnNo;
+               if ( !is.read(reinterpret_cast<char*>(&alnHd), sizeof(alnHd)) )
+                    BAMERR(bamFile," is truncated in alignment " << alnNo);
+               if ( alnHd.mRefID != refID || alnHd.mPos >= end ) break;
+               if ( isSkipped(alnHd,pfOnly) )
+               {    if ( !is.ignore(alnHd.remainingLen()) )
+                         BAMERR(bamFile," is truncated in skipped alignment "
+                              << alnNo);
+                    continue;    }
+
+               reads_b.push_back( basevector(alloc) );
+               reads_n.push_back( String(alloc) );
+               quals.push_back( qvec(alloc) );
+               readAlign( is, bamFile, alnNo, alnHd, rng, nibbleSeq,
+                    reads_b.back( ), quals.back( ), reads_n.back( ), &cigar );
+
+               // Toss alignments that end before the region.  Cigar ops M, D,
+               // N, =, and X consume the reference.
+
+               int refLen = 0;
+               for ( uint32_t op : cigar )
+               {    switch ( op & 0xf )
+                    {    case 0: case 2: case 3: case 7: case 8:
+                              refLen += op >> 4;    }    }
+               if ( alnHd.mPos + std::max(refLen,1) <= beg )
+               {    reads_b.pop_back( );
+                    reads_n.pop_back( );
+                    quals.pop_back( );    }    }    }
+     convertAppendParallel( quals.begin( ), quals.end( ), reads_q );
+}
+
 class FunnyIterator
 {
 public:
@@ -601,6 +920,7 @@ template <class T> void movePairs( size_t nReads, vecbasevector& reads_b,
      size_t nPairs = (nReads + 1)/2;
      if (pReadNames)
      {    pReadNames->reserve(pReadNames->size() + nReads);
+          size_t nNamePairs = nPairs;
           auto prev = readIndices.begin();
           auto end = readIndices.end();
           for ( auto itr = prev+1; itr != end; ++itr,++prev )
@@ -618,9 +938,9 @@ template <class T> void movePairs( size_t nReads, vecbasevector& reads_b,
                     else
                     {    pReadNames->push_back(String(name1.begin(),name1.end()-2));
                          pReadNames->push_back(String(name2.begin(),name2.end()-2));
-                             }    }
-               ++prev;
-               if ( ++itr == end || !--nPairs ) break;    }    }
+                             }
+                    ++prev;
+                    if ( ++itr == end || !--nNamePairs ) break;    }    }    }
      vec<T> ids;
      {    auto prev = readIndices.begin();
           auto end = readIndices.end();
@@ -644,6 +964,35 @@ template <class T> void movePairs( size_t nReads, vecbasevector& reads_b,
           pVPQV->push_back( reads_q[ readIndices[ ids[i] + 1 ] ] );    }
      Destroy(reads_q);    }
 
+// sorts the reads by name, and appends the first nReads of those that can be
+// paired to the outputs, pair by pair
+
+void pairReads( size_t nReads, vecbasevector& reads_b, VecPQVec& reads_q,
+     vecString& reads_n, bool uniquifyNames, vecbvec* pVBV, VecPQVec* pVPQV,
+     vecString* pReadNames, bool verbose )
+{
+    if ( (int64_t) reads_b.size( ) < UINT32_MAX )
+    {    vec<uint32_t> readIndices(rangeItr(0ul),rangeItr(reads_b.size()));
+         ParallelSort( readIndices, [&reads_n]( size_t idx1, size_t idx2 )
+              { return reads_n[idx1] < reads_n[idx2]; } );
+         if (verbose)
+         {    cout << Date( ) << ": reads sorted" << endl;
+              cout << Date( ) << ": memory in use = " << MemUsageGBString( ) 
+                   << ", peak = " << PeakMemUsageGBString( ) << endl;    }
+         movePairs( nReads, reads_b, reads_q, reads_n, readIndices, 
+              uniquifyNames, pVBV, pVPQV, pReadNames );    }
+    else
+    {    vec<uint64_t> readIndices(rangeItr(0ul),rangeItr(reads_b.size()));
+         ParallelSort( readIndices, [&reads_n]( size_t idx1, size_t idx2 )
+              { return reads_n[idx1] < reads_n[idx2]; } );
+         if (verbose)
+         {    cout << Date( ) << ": reads sorted" << endl;
+              cout << Date( ) << ": memory in use = " << MemUsageGBString( ) 
+                   << ", peak = " << PeakMemUsageGBString( ) << endl;    }
+         movePairs( nReads, reads_b, reads_q, reads_n, readIndices, 
+              uniquifyNames, pVBV, pVPQV, pReadNames );    }
+}
+
 } // end of anonymous namespace
 
 
@@ -656,7 +1005,9 @@ void BAMReader::readBAM( String const& bamFile,
     vecbasevector reads_b;
     VecPQVec reads_q;
     vecString reads_n;
-    BAMbuf* pBB = new BAMbuf(bamFile);
+    unsigned nThreads = mNUnzipThreads;
+    if ( !nThreads ) nThreads = getConfiguredNumThreads();
+    BAMbuf* pBB = new BAMbuf(bamFile,nThreads);
     {    std::istream is(pBB);
          skipToAligns(is,bamFile);
          MempoolOwner<char> alloc;
@@ -679,25 +1030,56 @@ void BAMReader::readBAM( String const& bamFile,
           << ", peak = " << PeakMemUsageGBString( ) << endl;
     nReads = (nReads + 1ul) & ~1ul;
     if ( !nReads ) return;
-    if ( (int64_t) reads_b.size( ) < UINT32_MAX )
-    {    vec<uint32_t> readIndices(rangeItr(0ul),rangeItr(reads_b.size()));
-         ParallelSort( readIndices, [&reads_n]( size_t idx1, size_t idx2 )
-              { return reads_n[idx1] < reads_n[idx2]; } );
-         cout << Date( ) << ": reads sorted" << endl;
-         cout << Date( ) << ": memory in use = " << MemUsageGBString( ) 
-               << ", peak = " << PeakMemUsageGBString( ) << endl;
-         movePairs( nReads, reads_b, reads_q, reads_n, readIndices, 
-              mUniquifyNames, pVBV, pVPQV, pReadNames );    }
-    else
-    {    vec<uint64_t> readIndices(rangeItr(0ul),rangeItr(reads_b.size()));
-         ParallelSort( readIndices, [&reads_n]( size_t idx1, size_t idx2 )
-              { return reads_n[idx1] < reads_n[idx2]; } );
-         cout << Date( ) << ": reads sorted" << endl;
-         cout << Date( ) << ": memory in use = " << MemUsageGBString( ) 
-               << ", peak = " << PeakMemUsageGBString( ) << endl;
-         movePairs( nReads, reads_b, reads_q, reads_n, readIndices, 
-              mUniquifyNames, pVBV, pVPQV, pReadNames );    }
+    pairReads( nReads, reads_b, reads_q, reads_n, mUniquifyNames,
+         pVBV, pVPQV, pReadNames, true );
     cout << Date( ) << ": data stashed in output structures" << std::endl;
     cout << Date( ) << ": memory in use = " << MemUsageGBString( ) 
           << ", peak = " << PeakMemUsageGBString( ) << endl;
 }
+
+void BAMReader::readBAMRegion( String const& bamFile, String const& region,
+                               vecbvec* pVBV, VecPQVec* pVPQV,
+                               vecString* pReadNames )
+{
+    // Parse the region, which is 1-based and inclusive.
+
+    String refName = region;
+    int beg = 0, end = std::numeric_limits<int>::max();
+    size_t colon = region.rfind(':');
+    if ( colon != String::npos )
+    {    String range = region.substr(colon+1);
+         range.GlobalReplaceBy( ",", "" );
+         if ( range.Contains("-") && range.Before("-").IsInt( )
+              && range.After("-").IsInt( ) )
+         {    refName = region.substr(0,colon);
+              beg = range.Before("-").Int( ) - 1;
+              end = range.After("-").Int( );    }
+         else if ( range.IsInt( ) )
+         {    refName = region.substr(0,colon);
+              beg = range.Int( ) - 1;    }    }
+    if ( beg < 0 ) beg = 0;
+
+    BGZFSeekBuf buf(bamFile);
+    std::istream is(&buf);
+    vec<String> refNames;
+    skipToAligns(is,bamFile,&refNames);
+    int refID = Position( refNames, refName );
+    if ( refID < 0 )
+         FatalErr("BAM file " << bamFile << " has no reference sequence named "
+                    << refName << ".");
+    if ( end <= beg ) return;
+    std::vector<BAIChunk> chunks = findChunks(bamFile,refID,beg,end);
+
+    vecbasevector reads_b;
+    VecPQVec reads_q;
+    vecString reads_n;
+    MempoolOwner<char> alloc;
+    readRegionAligns( buf, is, bamFile, alloc, mPFOnly, refID, beg, end, 
+         chunks, reads_b, reads_q, reads_n );
+
+    size_t nReads = std::min(size_t(mSelectFrac*reads_b.size()),mReadsToUse);
+    nReads = (nReads + 1ul) & ~1ul;
+    if ( !nReads ) return;
+    pairReads( nReads, reads_b, reads_q, reads_n, mUniquifyNames,
+         pVBV, pVPQV, pReadNames, false );
+}
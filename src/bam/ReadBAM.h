@@ -22,12 +22,16 @@
 class BAMReader
 {
 public:
+    // nUnzipThreads is the number of threads used to decompress BGZF blocks;
+    // 0 means the configured number of threads.
     explicit BAMReader( bool pfOnly=false,
                         bool uniquifyNames=true,
                         double selectFrac=1.,
-                        size_t readsToUse=~0ul )
+                        size_t readsToUse=~0ul,
+                        unsigned nUnzipThreads=0 )
     : mPFOnly(pfOnly), mUniquifyNames(uniquifyNames),
-      mSelectFrac(selectFrac), mReadsToUse(readsToUse) {}
+      mSelectFrac(selectFrac), mReadsToUse(readsToUse),
+      mNUnzipThreads(nUnzipThreads) {}
 
     // Appends sequence, quals, and (optionally) names of the paired reads
     // in the given BAM to the given vecvecs.
@@ -35,11 +39,21 @@ public:
                     vecbvec* pVBV, VecPQVec* pVPQV,
                     vecString* pReadNames=nullptr );
 
+    // Like readBAM, but only for reads having an alignment that overlaps the
+    // region, given as for samtools (e.g., "chr1:1001-2000", 1-based and
+    // inclusive, or just "chr1").  Pairs are kept only if both reads overlap.
+    // Uses the BAM index (bamFile.bai or bamFile with .bam replaced by .bai)
+    // to read only the parts of the file that might contain such alignments.
+    void readBAMRegion( String const& bamFile, String const& region,
+                        vecbvec* pVBV, VecPQVec* pVPQV,
+                        vecString* pReadNames=nullptr );
+
 private:
     bool mPFOnly;
     bool mUniquifyNames;
     double mSelectFrac;
     size_t mReadsToUse;
+    unsigned mNUnzipThreads;
 };
 
 #endif /* BAM_READBAM_H_ */
@@ -509,6 +509,28 @@ unsigned int LargestOverlap(const BaseVec& s, const BaseVec& t,
 inline unsigned LargestOverlap( BaseVec const& s, BaseVec const& t )
 { return LargestOverlap(s,t,s.size(),0U); }
 
+/// Reverse complement k <= 16 bases packed as by BaseVec::extractKmer, i.e.,
+/// with the left-most base in the lowest two bits.
+inline unsigned int ReverseComplementKmer( unsigned int x, unsigned int k )
+{ x = ~x;
+  x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+  x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+  x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+  x = (x >> 16) | (x << 16);
+  return x >> 2*(16-k); }
+
+/// Is t the reverse complement of s?  Compares sixteen bases at a time, in
+/// place, without making a copy.
+inline bool IsReverseComplement( BaseVec const& s, BaseVec const& t )
+{ unsigned n = s.size();
+  if ( t.size() != n ) return false;
+  for ( unsigned o = 0; o < n; o += 16 )
+  { unsigned k = std::min(16u,n-o);
+    if ( t.extractKmer(o,k) !=
+            ReverseComplementKmer(s.extractKmer(n-o-k,k),k) )
+        return false; }
+  return true; }
+
 /// Compute the concatenation of two basevectors
 inline BaseVec Cat(const BaseVec& left, const BaseVec& right)
 {
@@ -0,0 +1,68 @@
+///////////////////////////////////////////////////////////////////////////////
+//                   SOFTWARE COPYRIGHT NOTICE AGREEMENT                     //
+//       This software and its documentation are copyright (2015) by the     //
+//   Broad Institute.  All rights are reserved.  This software is supplied   //
+//   without any warranty or guaranteed support whatsoever. The Broad        //
+//   Institute is not responsible for its use, misuse, or functionality.     //
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * \file BloomFilter.h
+ *
+ * \brief Concurrent, cache-friendly Bloom filter.
+ */
+#ifndef FEUDAL_BLOOMFILTER_H
+#define FEUDAL_BLOOMFILTER_H
+
+#include "math/PowerOf2.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/// A blocked Bloom filter.  All the bits for a value fall within a single
+/// 64-bit word, so testing and setting them is one atomic fetch_or:  however
+/// the threads presenting a value interleave, every presentation after the
+/// first is told that the value was seen already.  Values are presented as
+/// hashes, which ought to be reasonably well mixed.
+///
+/// Thread-safe for concurrent calls to testAndSet.
+class BlockedBloomFilter
+{
+public:
+    /// Sized for nValues distinct values at about bitsPerValue bits each.
+    /// At the default, the false-positive rate is around 2%.
+    explicit BlockedBloomFilter( size_t nValues, unsigned bitsPerValue = 16 )
+    { size_t nBits = std::max(nValues,1ul)*bitsPerValue;
+      mNWords = 1ul << PowerOf2::ceilLg2((nBits+63)/64);
+      mWords.reset(new std::atomic<uint64_t>[mNWords]()); }
+
+    BlockedBloomFilter( BlockedBloomFilter const& )=delete;
+    BlockedBloomFilter& operator=( BlockedBloomFilter const& )=delete;
+
+    /// Records the value, and returns true if it had (probably) been recorded
+    /// already.  Always returns true for the second and later presentations.
+    bool testAndSet( size_t hash )
+    { // word from the folded hash, bit positions by double hashing on the
+      // high bits of a remix
+      std::atomic<uint64_t>& word = mWords[(hash ^ hash >> 32) & (mNWords-1)];
+      uint64_t mixed = hash * 0x9e3779b97f4a7c15ul;
+      unsigned pos = mixed >> 58;
+      unsigned step = (mixed >> 52) | 1u;
+      uint64_t mask = 0;
+      for ( unsigned idx = 0; idx != N_PROBES; ++idx )
+      { mask |= 1ul << pos;
+        pos = (pos+step) % 64; }
+      return (word.fetch_or(mask,std::memory_order_relaxed) & mask) == mask; }
+
+    size_t allocatedBytes() const
+    { return mNWords*sizeof(uint64_t); }
+
+private:
+    static unsigned const N_PROBES = 4;
+
+    size_t mNWords;
+    std::unique_ptr<std::atomic<uint64_t>[]> mWords;
+};
+
+#endif /* FEUDAL_BLOOMFILTER_H */
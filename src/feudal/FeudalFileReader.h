@@ -55,6 +55,12 @@ public:
     { AssertLt(ele,getNElements());
       return mpMapper->getOffset(ele+1)-mpMapper->getOffset(ele); }
 
+    /// Get the file offset of the variable-length data for the specified
+    /// element.  The offset for getNElements() is the end of the data.
+    size_t getDataOffset( size_t ele ) const
+    { AssertLe(ele,getNElements());
+      return mpMapper->getOffset(ele); }
+
     /// Get a BinaryReader positioned so that it's ready to read the variable-
     /// length data for the specified element
     BinaryReader& getData( size_t ele )
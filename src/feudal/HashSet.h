@@ -294,8 +294,8 @@ protected:
     const_pointer lookup( key_type val, size_t hash ) const
     { return find(val,hash%capacity()); }
 
-    template <class Comp>
-    const_pointer lookup( key_type val, size_t hash, Comp const& comp ) const
+    template <class Key, class Comp>
+    const_pointer lookup( Key const& val, size_t hash, Comp const& comp ) const
     { // Check home slot.
       const_pointer pBkt = 0;
       BktStatus const* pInfo = mBktInfo + hash%capacity();
@@ -679,8 +679,10 @@ public:
     { size_t hash = mHCF.hash(val);
       return findHHSC(hash)->lookup(val,hash); }
 
-    template <class Comp>
-    const_pointer lookup( size_t hash, key_type val, Comp const& comp ) const
+    /// The value that comp(val,entry) says is equal to val, which may be of
+    /// some other type, given its hash.  Same rules as for the other lookup.
+    template <class Key, class Comp>
+    const_pointer lookup( size_t hash, Key const& val, Comp const& comp ) const
     { return findHHSC(hash)->lookup(val,hash,comp); }
 
     /// Returns true if the value was added (otherwise, it was already present).
@@ -713,6 +715,16 @@ public:
       if ( !pEnt ) pEnt = &insertLocked(val,hash,pHHS);
       func(*pEnt); pHHS->unlock(); }
 
+    /// Applies functor to entry, if present.  Returns false (and does nothing)
+    /// if the value isn't present.  Threadsafe.
+    template <class Func>
+    bool applyIfPresent( key_type val, Func func )
+    { size_t hash = mHCF.hash(val);
+      HHS* pHHS = findHHS(hash);
+      const_pointer pEnt = pHHS->lookup(val,hash);
+      if ( pEnt ) func(*pEnt);
+      pHHS->unlock(); return pEnt; }
+
     /// Returns a reference to the value.  Inserts value, if not present.
     const_reference operator[]( key_type val )
     { size_t hash = mHCF.hash(val);
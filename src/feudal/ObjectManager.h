@@ -16,6 +16,7 @@
 
 #include "feudal/BinaryStream.h"
 #include "feudal/MasterVec.h"
+#include "feudal/PQVec.h"
 #include "system/Assert.h"
 #include "system/file/File.h"
 
@@ -25,6 +26,7 @@ class ObjectManagerImpl
 protected:
     void loadImpl( File const& file, T* pObj )
     { BinaryReader::readFile(file,pObj); }
+    void unloadImpl( T* ) {}
     void storeImpl( File const& file, T const& obj )
     { BinaryWriter::writeFile(file,obj); }
 };
@@ -35,10 +37,26 @@ class ObjectManagerImpl<MasterVec<T>>
 protected:
     void loadImpl( File const& file, MasterVec<T>* pObj )
     { pObj->ReadAll(String(file.c_str())); }
+    void unloadImpl( MasterVec<T>* ) {}
     void storeImpl( File const& file, MasterVec<T> const& obj )
     { obj.WriteAll(String(file.c_str())); }
 };
 
+// quals are mapped rather than read, so that repeated loads are cheap
+template <>
+class ObjectManagerImpl<VecPQVec>
+{
+protected:
+    void loadImpl( File const& file, VecPQVec* pObj )
+    { mMapping.map(String(file.c_str()),pObj); }
+    void unloadImpl( VecPQVec* pObj ) { mMapping.unmap(pObj); }
+    void storeImpl( File const& file, VecPQVec const& obj )
+    { obj.WriteAll(String(file.c_str())); }
+
+private:
+    VecPQVecMapping mMapping;
+};
+
 template <class T>
 class ObjectManager : ObjectManagerImpl<T>
 {
@@ -46,15 +64,16 @@ public:
     ObjectManager( String const& fileName ) : mFile(fileName), mpObj(nullptr) {}
     ObjectManager( ObjectManager const& )=delete;
     ObjectManager& operator=( ObjectManager const& )=delete;
-    ~ObjectManager() { delete mpObj; }
+    ~ObjectManager() { unload(); }
 
-    T& create() { delete mpObj; mpObj = new T; return *mpObj; }
+    T& create() { unload(); mpObj = new T; return *mpObj; }
 
     T const& load()
     { if ( !mpObj ) { mpObj=new T; this->loadImpl(mFile,mpObj); }
       return *mpObj; }
 
-    void unload() { delete mpObj; mpObj = nullptr; }
+    void unload()
+    { if ( mpObj ) { this->unloadImpl(mpObj); delete mpObj; mpObj = nullptr; } }
     void store() { ForceAssert(mpObj); this->storeImpl(mFile,*mpObj); }
     bool onDisk() { return mFile.exists(true); }
     void remove() { mFile.remove(); }
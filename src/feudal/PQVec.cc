@@ -13,7 +13,13 @@
  */
 
 #include "feudal/PQVec.h"
+#include "feudal/FeudalFileReader.h"
 #include "math/PowerOf2.h"
+#include "system/file/FileReader.h"
+#include <cstdint>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
 
 void PQVecEncoder::init( qvec const& qv )
 {
@@ -84,43 +90,130 @@ void PQVecEncoder::init( qvec const& qv )
     }
 }
 
+namespace
+{
+
+using byte = PQVecEncoder::byte;
+
+// The bit-packing is done 8 quals at a time, in a 64-bit word (the 8 quals'
+// offsets from the block's minimum occupy exactly NBITS bytes when packed), so
+// there's no per-qual shifting and branching on the bit position.
+uint64_t const ONES = 0x0101010101010101ul;
+
+// the low NBITS bits of each byte, packed together.  (written out, rather than
+// looped over, so that it's unrolled at -O2.)
+template <unsigned NBITS>
+inline uint64_t packBits( uint64_t qs )
+{
+    uint64_t const M = (1ul << NBITS) - 1ul;
+    return (qs & M) | (qs >> 8 & M) << NBITS |
+            (qs >> 16 & M) << 2*NBITS | (qs >> 24 & M) << 3*NBITS |
+            (qs >> 32 & M) << 4*NBITS | (qs >> 40 & M) << 5*NBITS |
+            (qs >> 48 & M) << 6*NBITS | (qs >> 56 & M) << 7*NBITS;
+}
+
+// the inverse:  8 NBITS-bit fields spread out into bytes
+template <unsigned NBITS>
+inline uint64_t unpackBits( uint64_t bits )
+{
+    uint64_t const M = (1ul << NBITS) - 1ul;
+    return (bits & M) | (bits >> NBITS & M) << 8 |
+            (bits >> 2*NBITS & M) << 16 | (bits >> 3*NBITS & M) << 24 |
+            (bits >> 4*NBITS & M) << 32 | (bits >> 5*NBITS & M) << 40 |
+            (bits >> 6*NBITS & M) << 48 | (bits >> 7*NBITS & M) << 56;
+}
+
+// packs nQs quals after the header, which leaves one bit (carry) of the
+// current byte used
+template <unsigned NBITS>
+byte* encodeBlock( byte const* pQs, unsigned nQs, unsigned minQ, uint64_t carry,
+                    byte* pBuf )
+{
+    uint64_t const minQs = minQ*ONES;
+    while ( nQs >= 8 )
+    {
+        uint64_t qs;
+        memcpy(&qs,pQs,8);
+        uint64_t bits = packBits<NBITS>(qs-minQs) << 1 | carry;
+        memcpy(pBuf,&bits,NBITS);
+        carry = bits >> 8*NBITS;
+        pQs += 8; nQs -= 8; pBuf += NBITS;
+    }
+    unsigned off = 1;
+    while ( nQs-- )
+    {
+        carry |= uint64_t(*pQs++ - minQ) << off;
+        off += NBITS;
+    }
+    while ( off >= 8 )
+    {
+        *pBuf++ = carry;
+        carry >>= 8;
+        off -= 8;
+    }
+    if ( off )
+        *pBuf++ = carry;
+    return pBuf;
+}
+
+// unpacks nQs quals from bits that start at bit 1 of pBits, without reading
+// at or beyond pEnd
+template <unsigned NBITS>
+void decodeBlock( byte const* pBits, byte const* pEnd, unsigned nQs,
+                    unsigned minQ, byte* pQs )
+{
+    uint64_t const minQs = minQ*ONES;
+    uint64_t bits;
+    while ( nQs >= 8 && pEnd-pBits >= 8 )
+    {
+        memcpy(&bits,pBits,8);
+        uint64_t qs = unpackBits<NBITS>(bits >> 1) + minQs;
+        memcpy(pQs,&qs,8);
+        pQs += 8; nQs -= 8; pBits += NBITS;
+    }
+    // what's left fits in a word
+    if ( pEnd-pBits >= 8 )
+        memcpy(&bits,pBits,8);
+    else
+    {
+        bits = 0;
+        for ( unsigned idx = 0; pBits+idx != pEnd; ++idx )
+            bits |= uint64_t(pBits[idx]) << 8*idx;
+    }
+    bits >>= 1;
+    uint64_t const MASK = (1ul << NBITS) - 1ul;
+    while ( nQs-- )
+    {
+        *pQs++ = minQ + (bits & MASK);
+        bits >>= NBITS;
+    }
+}
+
+} // end of anonymous namespace
+
 PQVecEncoder::byte* PQVecEncoder::encode( byte* pBuf ) const
 {
     Assert(mpQV);
-    auto itr = mpQV->begin();
+    byte const* pQs = mpQV->empty() ? nullptr : &mpQV->front();
     for ( Block const& block : mBlocks )
     {
-        uint64_t nQs = block.mNQs;
-        uint64_t nBits = block.mBits;
-        uint64_t minQ = block.mMinQ;
+        unsigned nQs = block.mNQs;
+        unsigned minQ = block.mMinQ;
         *pBuf++ = nQs;
-        uint64_t bits = nBits;
-        bits |= minQ << 3;
-        *pBuf++ = bits;
-        bits >>= 8;
-        if ( !nBits )
+        *pBuf++ = block.mBits | minQ << 3;
+        uint64_t carry = minQ >> 5;
+        switch ( block.mBits )
         {
-            *pBuf++ = bits;
-            itr += nQs;
-        }
-        else
-        {
-            uint64_t off = 1;
-            while ( nQs-- )
-            {
-                uint64_t val = *itr - minQ;
-                ++itr;
-                bits |= val << off;
-                if ( (off += nBits) >= 8 )
-                {
-                    *pBuf++ = bits;
-                    off -= 8;
-                    bits >>= 8;
-                }
-            }
-            if ( off )
-                *pBuf++ = bits;
+        case 0: *pBuf++ = carry; break;
+        case 1: pBuf = encodeBlock<1>(pQs,nQs,minQ,carry,pBuf); break;
+        case 2: pBuf = encodeBlock<2>(pQs,nQs,minQ,carry,pBuf); break;
+        case 3: pBuf = encodeBlock<3>(pQs,nQs,minQ,carry,pBuf); break;
+        case 4: pBuf = encodeBlock<4>(pQs,nQs,minQ,carry,pBuf); break;
+        case 5: pBuf = encodeBlock<5>(pQs,nQs,minQ,carry,pBuf); break;
+        case 6: pBuf = encodeBlock<6>(pQs,nQs,minQ,carry,pBuf); break;
+        case 7: pBuf = encodeBlock<7>(pQs,nQs,minQ,carry,pBuf); break;
         }
+        pQs += nQs;
     }
     *pBuf++ = 0;
     return pBuf;
@@ -128,63 +221,141 @@ PQVecEncoder::byte* PQVecEncoder::encode( byte* pBuf ) const
 
 void PQVecEncoder::decode( byte const* pqBuf, byte* pQs )
 {
-    uint64_t addr = reinterpret_cast<uint64_t>(pqBuf);
-    uint64_t* buf = reinterpret_cast<uint64_t*>(addr&~7);
-    uint64_t bits = *buf++;
-    addr = (addr & 7) << 3;
-    uint64_t remain = 64 - addr;
-    bits >>= addr;
-    uint64_t nQs;
-    while ( (nQs = bits&0xff) )
+    for ( BlockReader rdr(pqBuf); !rdr.atEnd(); rdr.next() )
     {
-        bits >>= 8;
-        if ( !(remain -= 8) )
-        {
-            bits = *buf++;
-            remain = 64;
-        }
-        uint64_t nBits = bits & 0x07;
-        bits >>= 3;
-        uint64_t minQ = bits & 0x3f;
-        bits >>= 6;
-        if ( remain < 9 )
+        rdr.unpack(pQs);
+        pQs += rdr.nQs();
+    }
+}
+
+void PQVecEncoder::BlockReader::unpack( byte* pQs ) const
+{
+    byte const* pBits = mpBuf + 2;
+    byte const* pEnd = mpBuf + Block::blockSize(mNQs,mNBits);
+    switch ( mNBits )
+    {
+    case 0: memset(pQs,mMinQ,mNQs); break;
+    case 1: decodeBlock<1>(pBits,pEnd,mNQs,mMinQ,pQs); break;
+    case 2: decodeBlock<2>(pBits,pEnd,mNQs,mMinQ,pQs); break;
+    case 3: decodeBlock<3>(pBits,pEnd,mNQs,mMinQ,pQs); break;
+    case 4: decodeBlock<4>(pBits,pEnd,mNQs,mMinQ,pQs); break;
+    case 5: decodeBlock<5>(pBits,pEnd,mNQs,mMinQ,pQs); break;
+    case 6: decodeBlock<6>(pBits,pEnd,mNQs,mMinQ,pQs); break;
+    case 7: decodeBlock<7>(pBits,pEnd,mNQs,mMinQ,pQs); break;
+    }
+}
+
+unsigned PQVecEncoder::firstGE( byte const* pqBuf, unsigned minQ )
+{
+    unsigned pos = 0;
+    byte qs[255];
+    for ( BlockReader rdr(pqBuf); !rdr.atEnd(); rdr.next() )
+    {
+        if ( rdr.minQ() >= minQ )
+            return pos;
+        if ( rdr.maxQ() >= minQ )
         {
-            bits = *buf++;
-            minQ |= (bits & 1) << 5;
-            bits >>= 1;
-            remain += 64;
+            rdr.unpack(qs);
+            for ( unsigned idx = 0; idx != rdr.nQs(); ++idx )
+                if ( qs[idx] >= minQ )
+                    return pos + idx;
         }
-        remain -= 9;
-        if ( !nBits )
-            while ( nQs-- )
-                *pQs++ = minQ;
-        else
+        pos += rdr.nQs();
+    }
+    return pos;
+}
+
+unsigned PQVecEncoder::lastGE( byte const* pqBuf, unsigned minQ )
+{
+    unsigned pos = 0;
+    unsigned result = ~0u;
+    byte qs[255];
+    for ( BlockReader rdr(pqBuf); !rdr.atEnd(); rdr.next() )
+    {
+        if ( rdr.minQ() >= minQ )
+            result = pos + rdr.nQs() - 1;
+        else if ( rdr.maxQ() >= minQ )
         {
-            uint64_t mask = (1ul<<nBits)-1ul;
-            while ( nQs-- )
-            {
-                uint64_t val = bits;
-                uint64_t used = nBits;
-                if ( remain < nBits )
+            rdr.unpack(qs);
+            for ( unsigned idx = rdr.nQs(); idx--; )
+                if ( qs[idx] >= minQ )
                 {
-                    bits = *buf++;
-                    val |= bits << remain;
-                    used -= remain;
-                    remain += 64;
+                    result = pos + idx;
+                    break;
                 }
-                remain -= nBits;
-                bits >>= used;
-                *pQs++ = minQ + (val & mask);
-            }
         }
-        bits >>= remain & 7;
-        remain &= ~7ul;
-        if ( !remain )
+        pos += rdr.nQs();
+    }
+    return result == ~0u ? pos : result;
+}
+
+unsigned PQVecEncoder::lastRunEnd( byte const* pqBuf, unsigned minQ,
+                                    unsigned runLen )
+{
+    unsigned pos = 0;
+    unsigned run = 0;
+    unsigned result = 0;
+    byte qs[255];
+    for ( BlockReader rdr(pqBuf); !rdr.atEnd(); rdr.next() )
+    {
+        unsigned nQs = rdr.nQs();
+        if ( rdr.minQ() >= minQ )
         {
-            bits = *buf++;
-            remain = 64;
+            if ( (run += nQs) >= runLen )
+                result = pos + nQs;
         }
+        else if ( rdr.maxQ() < minQ )
+            run = 0;
+        else
+        {
+            rdr.unpack(qs);
+            for ( unsigned idx = 0; idx != nQs; ++idx )
+                if ( qs[idx] < minQ )
+                    run = 0;
+                else if ( ++run >= runLen )
+                    result = pos + idx + 1;
+        }
+        pos += nQs;
+    }
+    return result;
+}
+
+void VecPQVecMapping::map( String const& fileName, VecPQVec* pVPQV )
+{
+    unmap(pVPQV);
+    FeudalFileReader rdr(fileName.c_str());
+    size_t nnn = rdr.getNElements();
+    size_t dataBeg = rdr.getDataOffset(0);
+    size_t dataEnd = rdr.getDataOffset(nnn);
+    pVPQV->resize(nnn);
+    if ( dataBeg == dataEnd )
+        return;
+
+    size_t mappedOffset = dataBeg - dataBeg%getpagesize();
+    mMappedLen = dataEnd - mappedOffset;
+    mpMappedBit = FileReader(fileName.c_str()).map(mappedOffset,mMappedLen,true);
+    unsigned char* base = static_cast<unsigned char*>(mpMappedBit)-mappedOffset;
+    size_t off = dataBeg;
+    for ( size_t idx = 0; idx != nnn; ++idx )
+    {
+        size_t nextOff = rdr.getDataOffset(idx+1);
+        if ( nextOff != off )
+            (*pVPQV)[idx].setData(base+off);
+        off = nextOff;
+    }
+}
+
+void VecPQVecMapping::unmap( VecPQVec* pVPQV )
+{
+    if ( mpMappedBit )
+    {
+        for ( PQVec& pqv : *pVPQV )
+            pqv.releaseData();
+        munmap(mpMappedBit,mMappedLen);
+        mpMappedBit = nullptr;
+        mMappedLen = 0;
     }
+    pVPQV->clear();
 }
 
 #include "feudal/OuterVecDefs.h"
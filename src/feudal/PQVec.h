@@ -50,7 +50,23 @@ public:
 
     static void decode( byte const* pqBuf, byte* pQs );
 
+    // queries on the encoded form.  each returns the number of quals when
+    // there's no such position.
+
+    // position of the first qual >= minQ
+    static unsigned firstGE( byte const* pqBuf, unsigned minQ );
+
+    // position of the last qual >= minQ
+    static unsigned lastGE( byte const* pqBuf, unsigned minQ );
+
+    // length of the prefix that ends with the last run of at least runLen
+    // quals >= minQ (or 0, rather than the number of quals, if there's none)
+    static unsigned lastRunEnd( byte const* pqBuf, unsigned minQ,
+                                    unsigned runLen );
+
 private:
+    template <class Alloc> friend class PQVecA;
+
     struct Block
     { Block( byte nQs, byte bits, byte minQ )
       : mNQs(nQs), mBits(bits), mMinQ(minQ) {}
@@ -59,6 +75,37 @@ private:
       { return (nQs*nBits+17+7)>>3; }
       byte mNQs; byte mBits; byte mMinQ; };
 
+    // walks the blocks of an encoded buffer.  a block is a count, then 3 bits
+    // of bit-width and 6 bits of minimum qual, then the count's worth of
+    // offsets from the minimum, each bit-width bits long, padded to a byte.
+    class BlockReader
+    {
+    public:
+        explicit BlockReader( byte const* pBuf ) : mpBuf(pBuf) { readHeader(); }
+
+        bool atEnd() const { return !mNQs; }
+        void next() { mpBuf += Block::blockSize(mNQs,mNBits); readHeader(); }
+
+        unsigned nQs() const { return mNQs; }
+        unsigned minQ() const { return mMinQ; }
+        // an upper bound -- the actual max may be lower
+        unsigned maxQ() const { return mMinQ + (1u<<mNBits) - 1u; }
+
+        // writes nQs() quals
+        void unpack( byte* pQs ) const;
+
+    private:
+        void readHeader()
+        { if ( (mNQs = mpBuf[0]) )
+          { mNBits = mpBuf[1] & 7;
+            mMinQ = (mpBuf[1] >> 3) | (mpBuf[2] & 1u) << 5; } }
+
+        byte const* mpBuf;
+        unsigned mNQs;
+        unsigned mNBits;
+        unsigned mMinQ;
+    };
+
     std::vector<Block> mBlocks;
     std::vector<unsigned> mCosts;
     qvec const* mpQV;
@@ -92,6 +139,20 @@ public:
 
     operator qvec() const { qvec qv; unpack(&qv); return qv; }
 
+    // these scan the compressed representation, unpacking only the blocks
+    // that straddle minQ.  see PQVecEncoder for what they return.
+    size_type firstGE( unsigned minQ ) const
+    { byte const* buf = data();
+      return buf ? PQVecEncoder::firstGE(buf,minQ) : 0; }
+
+    size_type lastGE( unsigned minQ ) const
+    { byte const* buf = data();
+      return buf ? PQVecEncoder::lastGE(buf,minQ) : 0; }
+
+    size_type lastRunEnd( unsigned minQ, unsigned runLen ) const
+    { byte const* buf = data();
+      return buf ? PQVecEncoder::lastRunEnd(buf,minQ,runLen) : 0; }
+
     // all the rest of this crap is boilerplate
     PQVecA() { new (&allocator()) Alloc; }
 
@@ -178,6 +239,10 @@ public:
     { Assert(!data());
       mData |= reinterpret_cast<size_t>(buf)&PTRMASK; return buf; }
 
+    // and this:  forgets the data without freeing it (see VecPQVecMapping)
+    byte* releaseData()
+    { byte* buf = data(); mData &= ~PTRMASK; return buf; }
+
 private:
     static_assert(sizeof(byte*)==sizeof(size_t),"Weird pointer size.");
     static_assert(sizeof(Alloc)<=size_t(2),"Allocator too big.");
@@ -204,6 +269,31 @@ using PQVec = PQVecA<>;
 using VecPQVec = MasterVec<PQVec>;
 extern template class OuterVec<PQVec>;
 
+// Fills a VecPQVec with PQVecs that point straight into a memory-mapped .qualp
+// file, rather than into copies on the heap.  Mapping costs a pass over the
+// file's offsets table, and nothing else:  the data is paged in as it's read,
+// and the page cache is shared with anyone else mapping the same file.
+// The VecPQVec must be treated as read-only, and unmap must be called before
+// it is destroyed.
+class VecPQVecMapping
+{
+public:
+    VecPQVecMapping() : mpMappedBit(nullptr), mMappedLen(0) {}
+    VecPQVecMapping( VecPQVecMapping const& )=delete;
+    VecPQVecMapping& operator=( VecPQVecMapping const& )=delete;
+    ~VecPQVecMapping() { ForceAssert(!mpMappedBit); }
+
+    // pVPQV is cleared, and then filled
+    void map( String const& fileName, VecPQVec* pVPQV );
+
+    // pVPQV is cleared
+    void unmap( VecPQVec* pVPQV );
+
+private:
+    void* mpMappedBit;
+    size_t mMappedLen;
+};
+
 template <class Itr> // Itr is a random-access iterator over const qvec's
 void convertCopy( Itr beg, Itr end, VecPQVec::iterator oItr )
 { if ( beg != end )
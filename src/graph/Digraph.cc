@@ -476,11 +476,38 @@ void digraphX::Components( vec< vec<int> >& comp, const vec<Bool>* invisible ) c
                used[w] = True;
                C.push_back(w);
                // Expand this component recursively
-               Cnext.append( From(w) );
-               Cnext.append( To(w) );    }
+               Cnext.insert( Cnext.end( ), From(w).begin( ), From(w).end( ) );
+               Cnext.insert( Cnext.end( ), To(w).begin( ), To(w).end( ) );    }
          Sort(C);
          comp.push_back(C);    }    }
 
+void digraphX::WriteRuns( BinaryWriter& writer, const vec<int>& starts,
+     const vec<int>& x )
+{    const size_t n = starts.size( ) - 1;
+     writer.write(n);
+     for ( size_t v = 0; v < n; v++ )
+     {    const unsigned int len = starts[v+1] - starts[v];
+          writer.write(len);
+          writer.write( x.data( ) + starts[v], x.data( ) + starts[v+1] );    }    }
+
+void digraphX::ReadRuns( BinaryReader& reader, vec<int>& starts, vec<int>& x,
+     const vec<int>* expected_starts )
+{    size_t n;
+     reader.read(&n);
+     starts.resize( n + 1 );
+     starts[0] = 0;
+     x.clear( );
+     if ( expected_starts != NULL )
+     {    ForceAssertEq( expected_starts->size( ), n + 1 );
+          x.reserve( expected_starts->back( ) );    }
+     for ( size_t v = 0; v < n; v++ )
+     {    unsigned int len;
+          reader.read(&len);
+          starts[v+1] = starts[v] + len;
+          x.resize( starts[v+1] );
+          reader.read( x.data( ) + starts[v], x.data( ) + starts[v+1] );    }
+     if ( expected_starts != NULL ) ForceAssert( starts == *expected_starts );    }
+
 void digraph::ComponentsAlt( vec< vec<int> >& comp ) const
 {    comp.clear( );
      equiv_rel e( N( ) );
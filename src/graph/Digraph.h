@@ -383,35 +383,102 @@ SELF_SERIALIZABLE(digraph);
 // ============================ DIGRAPHX CLASS =====================================
 // =================================================================================
 
+// A digraphX is an immutable digraph whose adjacency lists are stored in
+// compressed sparse row form: the vertices adjacent from v are
+// from_[ from_starts_[v] ] through from_[ from_starts_[v+1] - 1 ], and likewise
+// for to_.  So there are four arrays in all, rather than two heap vectors per
+// vertex, and walking the graph touches memory in order.  From(v) and To(v)
+// return lightweight views of these runs.
+//
+// The binary format is unchanged: each adjacency list is written as a
+// VecIntVec would write it.
+
 class digraphX
 {
      public:
+
+     // A run of adjacent vertices (or edge objects).  It supports the operations
+     // used on a SerfVec<int>, and is valid as long as the graph is.
+
+     class adj_ref {
+
+          public:
+
+          typedef int value_type;
+          typedef const int* const_iterator;
+
+          adj_ref( const int* b, const int* e ) : b_(b), e_(e) { }
+
+          const_iterator begin( ) const { return b_; }
+          const_iterator end( ) const { return e_; }
+          size_t size( ) const { return e_ - b_; }
+          int isize( ) const { return e_ - b_; }
+          Bool empty( ) const { return b_ == e_; }
+          Bool nonempty( ) const { return b_ != e_; }
+          Bool solo( ) const { return e_ - b_ == 1; }
+          int operator[]( const int j ) const { return b_[j]; }
+          int front( ) const { return *b_; }
+          int back( ) const { return e_[-1]; }
+          Bool Contains( const int x ) const 
+          {    return std::find( b_, e_, x ) != e_;    }
+          vec<int> Vec( ) const { return vec<int>( b_, e_ ); }
+
+          private:
+
+          const int *b_, *e_;
+
+     };
      
-     digraphX( ) { }
+     digraphX( ) : from_starts_( 1, 0 ), to_starts_( 1, 0 ) { }
 
-     int N( ) const { return from_.size( ); } // number of vertices
+     int N( ) const { return from_starts_.isize( ) - 1; } // number of vertices
 
      void CheckGoodVertex( int v ) const
      {    AssertGe( v, 0 );
           AssertLt( v, N( ) );    }
 
-     const SerfVec<int>& From( int v ) const { CheckGoodVertex(v); return from_[v]; }
-     const SerfVec<int>& To( int v ) const { CheckGoodVertex(v); return to_[v]; }
+     adj_ref From( int v ) const 
+     {    CheckGoodVertex(v);
+          return Run( from_starts_, from_, v );    }
+     adj_ref To( int v ) const 
+     {    CheckGoodVertex(v);
+          return Run( to_starts_, to_, v );    }
 
      void Components( vec< vec<int> >& comp, const vec<Bool>* invisible = NULL ) 
           const;
 
      void writeBinary( BinaryWriter& writer ) const
-     { writer.write(from_);
-       writer.write(to_); }
+     {    WriteRuns( writer, from_starts_, from_ );
+          WriteRuns( writer, to_starts_, to_ );    }
 
      void readBinary( BinaryReader& reader )
-     { reader.read(&from_);
-       reader.read(&to_); }
+     {    ReadRuns( reader, from_starts_, from_ );
+          ReadRuns( reader, to_starts_, to_ );    }
 
      protected:
 
-     VecIntVec from_, to_;
+     static adj_ref Run( const vec<int>& starts, const vec<int>& x, const int v )
+     {    return adj_ref( x.data( ) + starts[v], x.data( ) + starts[v+1] );    }
+
+     // Set starts from the sizes of n lists, given by size(v).
+
+     template<class SizeFn> static void SetStarts( 
+          const int n, vec<int>& starts, SizeFn size )
+     {    starts.resize( n + 1 );
+          starts[0] = 0;
+          for ( int v = 0; v < n; v++ )
+               starts[v+1] = starts[v] + size(v);    }
+
+     // Write or read runs in the format of a VecIntVec.  On reading, if
+     // expected_starts is given, the runs must have those starts.
+
+     static void WriteRuns( BinaryWriter& writer, const vec<int>& starts,
+          const vec<int>& x );
+     static void ReadRuns( BinaryReader& reader, vec<int>& starts, vec<int>& x,
+          const vec<int>* expected_starts = NULL );
+
+     vec<int> from_starts_, to_starts_;
+     vec<int> from_, to_;
 
 };
 
@@ -1322,14 +1389,30 @@ template<class F> class digraphEX : public digraphX {
      int IFrom( int v, int j ) const
      {    CheckGoodVertex(v);
           AssertGe( j, 0 );
-          AssertLt( j, (int) from_edge_obj_[v].size( ) );
-          return from_edge_obj_[v][j];    }
+          AssertLt( j, From(v).isize( ) );
+          return from_edge_obj_[ from_starts_[v] + j ];    }
 
      int ITo( int v, int j ) const
      {    CheckGoodVertex(v);
           AssertGe( j, 0 );
-          AssertLt( j, (int) to_edge_obj_[v].size( ) );
-          return to_edge_obj_[v][j];    }
+          AssertLt( j, To(v).isize( ) );
+          return to_edge_obj_[ to_starts_[v] + j ];    }
+
+     int EdgeObjectIndexByIndexFrom( int v, int j ) const { return IFrom( v, j ); }
+     int EdgeObjectIndexByIndexTo( int v, int j ) const { return ITo( v, j ); }
+     const F& EdgeObjectByIndexFrom( int v, int j ) const 
+     {    return EdgeObject( IFrom( v, j ) );    }
+     const F& EdgeObjectByIndexTo( int v, int j ) const 
+     {    return EdgeObject( ITo( v, j ) );    }
+
+     // The edge objects leaving or entering v, parallel to From(v) or To(v).
+
+     adj_ref FromEdgeObj( int v ) const 
+     {    CheckGoodVertex(v);
+          return Run( from_starts_, from_edge_obj_, v );    }
+     adj_ref ToEdgeObj( int v ) const 
+     {    CheckGoodVertex(v);
+          return Run( to_starts_, to_edge_obj_, v );    }
 
      int E( ) const { return edges_.size( ); }
 
@@ -1388,7 +1471,7 @@ template<class F> class digraphEX : public digraphX {
      private:
 
      MasterVec<F> edges_;
-     VecIntVec to_edge_obj_, from_edge_obj_;
+     vec<int> to_edge_obj_, from_edge_obj_; // share to_starts_ and from_starts_
      vec<int> to_left_, to_right_;
 
 };
@@ -2241,16 +2241,17 @@ void digraphE<E>::readBinary( BinaryReader& reader )
 
 template<class F> void digraphEX<F>::writeBinary( BinaryWriter& writer ) const
 {   digraphX::writeBinary(writer);
-    writer.write(from_edge_obj_);
-    writer.write(to_edge_obj_);
+    WriteRuns( writer, from_starts_, from_edge_obj_ );
+    WriteRuns( writer, to_starts_, to_edge_obj_ );
     writer.write(edges_);
     writer.write(to_left_);
     writer.write(to_right_);     }
 
 template<class F> void digraphEX<F>::readBinary( BinaryReader& reader )
 {   digraphX::readBinary(reader);
-    reader.read(&from_edge_obj_);
-    reader.read(&to_edge_obj_);
+    vec<int> starts;
+    ReadRuns( reader, starts, from_edge_obj_, &from_starts_ );
+    ReadRuns( reader, starts, to_edge_obj_, &to_starts_ );
     reader.read(&edges_);
     reader.read(&to_left_);
     reader.read(&to_right_);    }
@@ -2400,51 +2401,41 @@ template<class E> const E& digraphEX<E>::EdgeObject( int i ) const
      AssertLt( i, (int) edges_.size( ) );
      return edges_[i];    }
 
+// Freeze G: size each run from G, then copy the lists into place.
+
 template<class F> digraphEX<F>::digraphEX( const digraphE<F>& G )
-{    from_.resize( G.N( ) );
-     to_.resize( G.N( ) );
-     from_edge_obj_.resize( G.N( ) );
-     to_edge_obj_.resize( G.N( ) );
-     for ( int i = 0; i < G.N( ); i++ )
-     {    from_[i].resize( G.From(i).size( ) );
-          for ( int j = 0; j < G.From(i).isize( ); j++ )
-               from_[i][j] = G.From(i)[j];
-          to_[i].resize( G.To(i).size( ) );
-          for ( int j = 0; j < G.To(i).isize( ); j++ )
-               to_[i][j] = G.To(i)[j];
-          from_edge_obj_[i].resize( G.From(i).size( ) );
-          for ( int j = 0; j < G.From(i).isize( ); j++ )
-               from_edge_obj_[i][j] = G.IFrom( i, j );
-          to_edge_obj_[i].resize( G.To(i).size( ) );
-          for ( int j = 0; j < G.To(i).isize( ); j++ )
-               to_edge_obj_[i][j] = G.ITo( i, j );    }
-     edges_.resize( G.EdgeObjectCount( ) );
-     for ( int e = 0; e < G.EdgeObjectCount( ); e++ )
-          edges_[e] = G.EdgeObject(e);
+{    const int n = G.N( );
+     SetStarts( n, from_starts_, [&G]( int v ){ return G.From(v).isize( ); } );
+     SetStarts( n, to_starts_, [&G]( int v ){ return G.To(v).isize( ); } );
+     from_.resize( from_starts_[n] ), from_edge_obj_.resize( from_starts_[n] );
+     to_.resize( to_starts_[n] ), to_edge_obj_.resize( to_starts_[n] );
+     #pragma omp parallel for schedule(dynamic, 10000)
+     for ( int v = 0; v < n; v++ )
+     {    std::copy( G.From(v).begin( ), G.From(v).end( ), 
+               from_.begin( ) + from_starts_[v] );
+          std::copy( G.FromEdgeObj(v).begin( ), G.FromEdgeObj(v).end( ), 
+               from_edge_obj_.begin( ) + from_starts_[v] );
+          std::copy( G.To(v).begin( ), G.To(v).end( ), 
+               to_.begin( ) + to_starts_[v] );
+          std::copy( G.ToEdgeObj(v).begin( ), G.ToEdgeObj(v).end( ), 
+               to_edge_obj_.begin( ) + to_starts_[v] );    }
+     edges_.assign( G.Edges( ).begin( ), G.Edges( ).end( ) );
      to_left_.resize( E( ) ), to_right_.resize( E( ) );
      for ( int v = 0; v < N( ); v++ )
-     {    for ( int j = 0; j < (int) From(v).size( ); j++ )
-               to_left_[ IFrom( v, j ) ] = v;
-          for ( int j = 0; j < (int) To(v).size( ); j++ )
-               to_right_[ ITo( v, j ) ] = v;    }    }
+     {    for ( int j = from_starts_[v]; j < from_starts_[v+1]; j++ )
+               to_left_[ from_edge_obj_[j] ] = v;
+          for ( int j = to_starts_[v]; j < to_starts_[v+1]; j++ )
+               to_right_[ to_edge_obj_[j] ] = v;    }    }
 
 template<class F> digraphE<F> digraphEX<F>::AsDigraphE() const {
     vec< vec<int> > from(N()), to(N());
     vec< vec<int> > to_edge_obj(N()), from_edge_obj(N());
     vec<F> edges(E());
     for ( int i = 0; i < N( ); i++ ) {
-	from[i].resize( From(i).size( ) );
-	for ( size_t j = 0; j < From(i).size( ); j++ )
-	    from[i][j] = From(i)[j];
-	to[i].resize( To(i).size( ) );
-	for ( size_t j = 0; j < To(i).size( ); j++ )
-	    to[i][j] = To(i)[j];
-	from_edge_obj[i].resize( From(i).size( ) );
-	for ( size_t j = 0; j < From(i).size( ); j++ )
-	    from_edge_obj[i][j] = IFrom( i, j );
-	to_edge_obj[i].resize( To(i).size( ) );
-	for ( size_t j = 0; j < To(i).size( ); j++ )
-	    to_edge_obj[i][j] = ITo( i, j );    
+	from[i] = From(i).Vec( );
+	to[i] = To(i).Vec( );
+	from_edge_obj[i] = FromEdgeObj(i).Vec( );
+	to_edge_obj[i] = ToEdgeObj(i).Vec( );
     }
     for ( int e = 0; e < E(); e++ )
 	edges[e] = EdgeObject(e);
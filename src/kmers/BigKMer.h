@@ -19,6 +19,7 @@
 #include "dna/CanonicalForm.h"
 #include "feudal/Iterator.h"
 #include "kmers/KMerContext.h"
+#include <cstdint>
 #include <ostream>
 
 template <unsigned K>
@@ -56,8 +57,9 @@ public:
     {}
 
     BigKMer( bvec const& bv, size_t hash,
-                KMerContext context=KMerContext(), unsigned offset = 0 )
-    : mpBV(&bv), mOffset(offset), mRC(false), mAssigned(false),
+                KMerContext context=KMerContext(), unsigned offset = 0,
+                bool rc = false, bool assigned = false )
+    : mpBV(&bv), mOffset(offset), mRC(rc), mAssigned(assigned),
       mContext(context), mHash(hash)
     {}
 
@@ -138,5 +140,67 @@ public:
     size_t mHash;
 };
 
+/// A compact version of a BigKMer, for storing in a dictionary.  Instead of a
+/// pointer to its bvec, it has the bvec's index in one of a few vecbvecs (the
+/// "source"), and it keeps just 32 bits of its hash as a fingerprint.  It's
+/// 16 bytes to a BigKMer's 24.  Whatever holds the BigKRefs must know the
+/// sources, and turn a BigKRef back into a BigKMer to get at the bases.
+template <unsigned K>
+class BigKRef
+{
+public:
+    struct hasher
+    {
+        typedef BigKRef argument_type;
+        size_t operator()( BigKRef const& ref ) const
+        { return ref.mHash; }
+    };
+
+    BigKRef() : mId(0), mOffset(0), mHash(0), mFlags(0) {}
+
+    BigKRef( unsigned source, unsigned id, BigKMer<K> const& kmer )
+    : mId(id), mOffset(kmer.getOffset()), mHash(fingerprint(kmer)),
+      mContext(kmer.getContext()),
+      mFlags(source<<SOURCE_SHIFT | (kmer.isRC()?RC:0) |
+                (kmer.isUnassigned()?0:ASSIGNED))
+    { AssertLt(source,1u<<(8-SOURCE_SHIFT)); }
+
+    // compiler-supplied copying and destructor are OK
+
+    unsigned getSource() const { return mFlags >> SOURCE_SHIFT; }
+    unsigned getId() const { return mId; }
+    unsigned getOffset() const { return mOffset; }
+    bool isRC() const { return mFlags & RC; }
+    size_t getHash() const { return mHash; }
+
+    KMerContext getContext() const { return mContext; }
+    void addContext( KMerContext context ) { mContext |= context; }
+
+    bool isUnassigned() const { return !(mFlags & ASSIGNED); }
+    void setAssigned() { mFlags |= ASSIGNED; }
+    void setUnassigned() { mFlags &= ~ASSIGNED; }
+
+    /// Point at another occurrence of the same kmer.
+    void updateLocation( unsigned source, unsigned id, BigKMer<K> const& kmer )
+    { AssertEq(mHash,fingerprint(kmer));
+      mId = id; mOffset = kmer.getOffset();
+      mFlags = source<<SOURCE_SHIFT | (kmer.isRC()?RC:0) | (mFlags&ASSIGNED); }
+
+    /// The hash that a BigKRef made from the kmer would have.
+    static size_t fingerprint( BigKMer<K> const& kmer )
+    { return static_cast<uint32_t>(typename BigKMer<K>::hasher()(kmer)); }
+
+private:
+    static unsigned char const RC = 1;
+    static unsigned char const ASSIGNED = 2;
+    static unsigned const SOURCE_SHIFT = 2;
+
+    uint32_t mId;
+    uint32_t mOffset;
+    uint32_t mHash;
+    KMerContext mContext;
+    unsigned char mFlags;
+};
+
 
 #endif /* BIGKMER_H_ */
@@ -20,13 +20,92 @@
 #include "paths/long/LargeKDispatcher.h"
 #include "system/SpinLockedData.h"
 #include "system/WorklistN.h"
+#include <cstdint>
 #include <iostream>
+#include <limits>
 
 namespace
 {
 
+// The dictionary of canonical kmers.  The entries are BigKRefs, so they have
+// to be resolved against the reads or the edges (their sources) to look at the
+// bases.  Lookups take a BigKMer, and compare it to an entry's bases only when
+// the hash fingerprints match.
 template <unsigned BIGK>
-using BigDict = HashSet<BigKMer<BIGK>,typename BigKMer<BIGK>::hasher>;
+class BigDict
+{
+public:
+    typedef BigKMer<BIGK> BigKmer;
+    typedef BigKRef<BIGK> Ref;
+    enum Source { READS, EDGES };
+
+    class RefComp
+    {
+    public:
+        explicit RefComp( BigDict const* pDict ) : mpDict(pDict) {}
+
+        bool operator()( Ref const& ref1, Ref const& ref2 ) const
+        { return ref1.getHash() == ref2.getHash() &&
+                    matches(mpDict->resolve(ref1),ref2); }
+
+        bool operator()( BigKmer const& kmer, Ref const& ref ) const
+        { return Ref::fingerprint(kmer) == ref.getHash() && matches(kmer,ref); }
+
+    private:
+        bool matches( BigKmer const& kmer, Ref const& ref ) const
+        { BigKmer entry = mpDict->resolve(ref);
+          return identical(kmer,entry) ||
+                  std::equal(kmer.begin(),kmer.end(),entry.begin()); }
+
+        BigDict const* mpDict;
+    };
+
+    typedef HashSet<Ref,typename Ref::hasher,RefComp> RefSet;
+    typedef typename RefSet::HHS HHS;
+    typedef typename RefSet::const_iterator const_iterator;
+
+    BigDict( size_t cap, vecbvec const& reads, vecbvec const& edges )
+    : mSet(cap,typename Ref::hasher(),RefComp(this))
+    { ForceAssertLe(reads.size(),std::numeric_limits<uint32_t>::max());
+      mSources[READS] = &reads; mSources[EDGES] = &edges; }
+
+    BigDict( BigDict const& )=delete;
+    BigDict& operator=( BigDict const& )=delete;
+
+    size_t size() const { return mSet.size(); }
+    const_iterator begin() const { return mSet.begin(); }
+    const_iterator end() const { return mSet.end(); }
+
+    template <class Proc>
+    void parallelForEachHHS( Proc proc ) const
+    { mSet.parallelForEachHHS(proc); }
+
+    unsigned getId( Source source, BigKmer const& kmer ) const
+    { return &kmer.getBV() - &(*mSources[source])[0]; }
+
+    Ref makeRef( Source source, BigKmer const& kmer ) const
+    { return Ref(source,getId(source,kmer),kmer); }
+
+    BigKmer resolve( Ref const& ref ) const
+    { return BigKmer((*mSources[ref.getSource()])[ref.getId()],ref.getHash(),
+                        ref.getContext(),ref.getOffset(),ref.isRC(),
+                        !ref.isUnassigned()); }
+
+    // the kmer must be canonical
+    Ref const* lookup( BigKmer const& kmer ) const
+    { return mSet.lookup(Ref::fingerprint(kmer),kmer,mSet.getComparator()); }
+
+    template <class Func>
+    void apply( Ref const& ref, Func func )
+    { mSet.apply(ref,func); }
+
+    void insertUniqueValue( Ref const& ref )
+    { mSet.insertUniqueValue(ref); }
+
+private:
+    RefSet mSet;
+    vecbvec const* mSources[2];
+};
 
 
 template <unsigned BIGK>
@@ -78,7 +157,7 @@ public:
     void reduce( BigKMer<BIGK>* key1, BigKMer<BIGK>* key2 )
     { for ( auto itr=key1+1; itr != key2; ++itr )
         key1->addContext(itr->getContext());
-      mDict.insertUniqueValue(*key1); }
+      mDict.insertUniqueValue(mDict.makeRef(BigKDict::READS,*key1)); }
 
     // We build the dictionary with BigKMers pointing to reads.  This updates
     // all the BigKMers in the dictionary to point to edges instead.
@@ -97,12 +176,13 @@ private:
     { canonicalAdd( kmer.isRev() ? kmer.rc() : kmer ); }
 
     void update( BigKMer<BIGK> const& kmer )
-    { const_cast<BigKMer<BIGK>*>(mDict.lookup(kmer))->updateLocation(kmer); }
+    { const_cast<BigKRef<BIGK>*>(mDict.lookup(kmer))->updateLocation(
+                BigKDict::EDGES,mDict.getId(BigKDict::EDGES,kmer),kmer); }
 
     void canonicalAdd( BigKMer<BIGK> const& kmer ) const
-    { mDict.apply(kmer,
-        [&kmer]( BigKMer<BIGK> const& entry )
-        { const_cast<BigKMer<BIGK>&>(entry).addContext(kmer.getContext()); }); }
+    { mDict.apply(mDict.makeRef(BigKDict::READS,kmer),
+        [&kmer]( BigKRef<BIGK> const& entry )
+        { const_cast<BigKRef<BIGK>&>(entry).addContext(kmer.getContext()); }); }
 
     BigKDict& mDict;
 };
@@ -112,6 +192,7 @@ class BigKEdgeBuilder
 {
 public:
     typedef BigKMer<BIGK> BigKmer;
+    typedef BigKRef<BIGK> BigKref;
     typedef BigKMerizer<BIGK> BigKmerizer;
     typedef BigDict<BIGK> BigKDict;
 
@@ -120,7 +201,7 @@ public:
         BigKEdgeBuilder eb(dict,pEdges);
         dict.parallelForEachHHS(
                 [eb]( typename BigKDict::HHS const& hhs ) mutable
-                { for ( BigKmer const& entry : hhs )
+                { for ( BigKref const& entry : hhs )
                     if ( entry.isUnassigned() )
                       eb.buildEdge(entry); });
 
@@ -140,26 +221,28 @@ private:
     BigKEdgeBuilder( BigKDict const& dict, vecbvec* pEdges )
     : mDict(dict), mEdges(*pEdges) {}
 
-    void buildEdge( BigKmer const& entry )
-    { if ( isPalindrome(entry) )
-        make1KmerEdge(entry);
+    void buildEdge( BigKref const& ref )
+    { BigKmer entry = mDict.resolve(ref);
+      if ( isPalindrome(entry) )
+        make1KmerEdge(ref);
       else if ( upstreamExtensionPossible(entry) )
       { if ( downstreamExtensionPossible(entry) )
           return;
         BigKmer rc = entry.rc();
         mEdgeSeq.assign(rc.begin(),rc.end());
-        mEdgeEntries.push_back(&entry);
+        mEdgeEntries.push_back(&ref);
         extend(rc.getContext()); }
       else if ( downstreamExtensionPossible(entry) )
       { mEdgeSeq.assign(entry.begin(),entry.end());
-        mEdgeEntries.push_back(&entry);
+        mEdgeEntries.push_back(&ref);
         extend(entry.getContext()); }
       else
-        make1KmerEdge(entry); }
+        make1KmerEdge(ref); }
 
     // not thread-safe
-    void simpleCircle( BigKmer const& entry )
-    { BigKmer const* pFirstEntry = &entry;
+    void simpleCircle( BigKref const& ref )
+    { BigKref const* pFirstEntry = &ref;
+      BigKmer entry = mDict.resolve(ref);
       mEdgeSeq.assign(entry.begin(),entry.end());
       mEdgeEntries.push_back(pFirstEntry);
       auto itr = mEdgeSeq.begin();
@@ -171,7 +254,7 @@ private:
         ForceAssertEq(context.getSuccessorCount(),1u);
         mEdgeSeq.push_back(context.getSingleSuccessor());
         kmer.successor(hasher.stepF(++itr));
-        BigKmer const* pEntry = lookup(kmer,&context);
+        BigKref const* pEntry = lookup(kmer,&context);
         if ( pEntry == pFirstEntry )
         { mEdgeSeq.pop_back();
           break; }
@@ -179,18 +262,20 @@ private:
         { std::cout << "Failed to close circle.\n";
           for ( auto beg=mEdgeEntries.begin(),end=mEdgeEntries.end();
                   beg != end; ++beg )
-            std::cout << *beg << ' ' << **beg;
-          std::cout << pEntry << ' ' << *pEntry << std::endl;
+            std::cout << *beg << ' ' << mDict.resolve(**beg);
+          std::cout << pEntry << ' ' << mDict.resolve(*pEntry) << std::endl;
           CRD::exit(1); }
         mEdgeEntries.push_back(pEntry); }
       canonicalizeCircle();
       addEdge(); }
 
     void canonicalizeCircle()
-    { auto itr = std::min_element(mEdgeEntries.begin(),mEdgeEntries.end(),
-                            []( BigKmer const* pEnt1, BigKmer const* pEnt2 )
-                            { return *pEnt1 < *pEnt2; });
-      BigKmer const& minKmer = **itr;
+    { BigKDict const& dict = mDict;
+      auto less = [&dict]( BigKref const* pEnt1, BigKref const* pEnt2 )
+                  { return dict.resolve(*pEnt1) < dict.resolve(*pEnt2); };
+      auto itr = std::min_element(mEdgeEntries.begin(),mEdgeEntries.end(),
+                                    less);
+      BigKmer minKmer = mDict.resolve(**itr);
       size_t idx = itr - mEdgeEntries.begin();
       if ( !std::equal(minKmer.begin(),minKmer.end(),mEdgeSeq.begin(idx)) )
       { mEdgeSeq.ReverseComplement();
@@ -235,9 +320,10 @@ private:
       lookup(kmer,&context);
       return context.getPredecessorCount() == 1; }
 
-    void make1KmerEdge( BigKmer const& entry )
-    { mEdgeSeq.assign(entry.begin(),entry.end());
-      mEdgeEntries.push_back(&entry);
+    void make1KmerEdge( BigKref const& ref )
+    { BigKmer entry = mDict.resolve(ref);
+      mEdgeSeq.assign(entry.begin(),entry.end());
+      mEdgeEntries.push_back(&ref);
       addEdge(); }
 
     void extend( KMerContext context )
@@ -250,7 +336,7 @@ private:
         if ( isPalindrome(kmer) )
         { mEdgeSeq.pop_back();
           break; }
-        BigKmer const* pEntry = lookup(kmer,&context);
+        BigKref const* pEntry = lookup(kmer,&context);
         if ( context.getPredecessorCount() != 1 )
         { mEdgeSeq.pop_back();
           break; }
@@ -264,8 +350,8 @@ private:
        case CanonicalForm::REV:
          mEdgeSeq.clear(); mEdgeEntries.clear(); break; } }
 
-    BigKmer const* lookup( BigKmer const& kmer, KMerContext* pContext )
-    { BigKmer const* result;
+    BigKref const* lookup( BigKmer const& kmer, KMerContext* pContext )
+    { BigKref const* result;
       if ( kmer.isRev() )
       { result = mDict.lookup(kmer.rc());
         ForceAssert(result);
@@ -287,9 +373,9 @@ private:
         mEdges.push_back(mEdgeSeq); }
       unsigned offset = 0;
       bool err = false;
-      for ( BigKmer const* pEnt : mEdgeEntries )
+      for ( BigKref const* pEnt : mEdgeEntries )
       { if ( pEnt->isUnassigned() )
-          const_cast<BigKmer*>(pEnt)->setAssigned();
+          const_cast<BigKref*>(pEnt)->setAssigned();
         else
         { std::cout << edgeId << ':' << offset++ << ' ' << pEnt
                     << " Already occupied." << std::endl;
@@ -301,7 +387,7 @@ private:
 
     BigKDict const& mDict;
     vecbvec& mEdges;
-    std::vector<BigKmer const*> mEdgeEntries;
+    std::vector<BigKref const*> mEdgeEntries;
     bvec mEdgeSeq;
 };
 
@@ -354,12 +440,12 @@ public:
 private:
     BigKMer<BIGK> lookup( BigKMer<BIGK> const& kmer )
     { if ( kmer.isRev() )
-      { BigKMer<BIGK> const* pEnt = mDict.lookup(kmer.rc());
+      { BigKRef<BIGK> const* pEnt = mDict.lookup(kmer.rc());
         ForceAssert(pEnt);
-        return pEnt->rc(); }
-      BigKMer<BIGK> const* pEnt = mDict.lookup(kmer);
+        return mDict.resolve(*pEnt).rc(); }
+      BigKRef<BIGK> const* pEnt = mDict.lookup(kmer);
       ForceAssert(pEnt);
-      return *pEnt; }
+      return mDict.resolve(*pEnt); }
 
     void buildKmerPath( size_t edgeLenRemaining )
     { if ( mTmpReadPath.size() == 1 )
@@ -470,13 +556,13 @@ void readsToHBV( vecbvec const& reads, unsigned coverage,
         return;
     }
 
-    BigDict<BIGK> bigDict(nKmers/coverage);
+    vecbvec edges;
+    BigDict<BIGK> bigDict(nKmers/coverage,reads,edges);
     BigKMerizer<BIGK> kmerizer(&bigDict);
     parallelFor(0ul,reads.size(),
             [kmerizer,&reads]( size_t readId ) mutable
             { kmerizer.kmerize(reads[readId]); });
 
-    vecbvec edges;
     edges.reserve(bigDict.size()/100);
     BigKEdgeBuilder<BIGK>::buildEdges(bigDict,&edges);
     AssertEq(edges.getKmerCount(BIGK),bigDict.size());
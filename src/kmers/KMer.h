@@ -251,6 +251,40 @@ public:
           else *out = krc < kkk ? krc : kkk; }
         ++out; } }
 
+    /// Calls func(kmer,form,context,offset) for each kmer in [beg,end).  The
+    /// kmer is canonical, form is the form it had in the sequence, and context
+    /// describes the adjacent bases in the kmer's (canonical) orientation.
+    /// The kmer and its reverse-complement are rolled along together, so the
+    /// canonical form is a single comparison rather than a base-by-base scan
+    /// and an rc() at each offset.
+    template <class Itr, class Func>
+    static void kmerizeCanonically( Itr beg, Itr const& end, Func func )
+    { using std::distance;
+      if ( distance(beg,end) < K ) return;
+      KMer kkk(beg);
+      KMer krc(kkk); krc.rc();
+      Itr itr(beg+K);
+      KMerContext predContext;
+      for ( size_t offset = 0; ; ++offset )
+      { bool hasSucc = itr != end;
+        unsigned char succ = hasSucc ? *itr : 0;
+        KMerContext kc = predContext;
+        if ( hasSucc ) kc |= KMerContext::initialContext(succ);
+        CanonicalForm form;
+        if ( K&1 )
+          form = kkk[K/2] & 2 ? CanonicalForm::REV : CanonicalForm::FWD;
+        else
+        { int cmp = compare(kkk,krc);
+          form = cmp < 0 ? CanonicalForm::FWD :
+                  cmp > 0 ? CanonicalForm::REV : CanonicalForm::PALINDROME; }
+        if ( form == CanonicalForm::REV )
+          func(krc,form,kc.rc(),offset);
+        else
+          func(kkk,form,kc,offset);
+        if ( !hasSucc ) break;
+        predContext = KMerContext::finalContext(kkk.front());
+        kkk.toSuccessor(succ); krc.toPredecessor(succ^3); ++itr; } }
+
     template <class Itr, class OItr>
     static void kmerizeNonCanonically( Itr beg, Itr const& end,
                                                  OItr out )
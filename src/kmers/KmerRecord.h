@@ -738,19 +738,28 @@ template<int K> class kmer {
 
   void Set( const basevector& b ) { Set( b, -1, -1 ); }
 
+  // Set the bases from a buffer in basevector packing, with zeros past K.
+  // The buffer must cover all of the bytes, including padding.
+  void SetBits( const void* bits )
+  { memcpy( data_.bytes, bits, sizeof(data_.bytes) ); }
+
   void ReverseComplement( )
-  { if ( K & 3 ) // if K is not evenly divisible by 4
-      Set( bvec(K,data_.begin()).ReverseComplement(), -1, -1 );
-    else
-    { // run algorithm byte-wise
-      unsigned char* head = data_.begin();
-      unsigned char* tail = head+K/4;
-      while ( head != tail )
-      { unsigned char tmp = Base::rcByte(*--tail);
-        if ( head == tail )
-        { *head = tmp; break; }
-        *tail = Base::rcByte(*head);
-        *head++ = tmp; } } }
+  { // run algorithm byte-wise
+    unsigned char* head = data_.begin();
+    unsigned char* tail = head+(K+3)/4;
+    while ( head != tail )
+    { unsigned char tmp = Base::rcByte(*--tail);
+      if ( head == tail )
+      { *head = tmp; break; }
+      *tail = Base::rcByte(*head);
+      *head++ = tmp; }
+    if ( K & 3 ) // if K is not evenly divisible by 4
+    { // the unused bases at the end are now at the start: shift them out
+      unsigned const SHIFT = 2*(4-(K&3));
+      unsigned char* bytes = data_.begin();
+      for ( int idx = 0; idx < (K+3)/4; idx++ )
+      { unsigned next = ( idx+1 < (K+3)/4 ? bytes[idx+1] : 0 );
+        bytes[idx] = (bytes[idx] >> SHIFT) | (next << (8-SHIFT)); } } }
 
   friend bool operator==(const kmer & l, const kmer& r) {
     return l.data_ == r.data_;
@@ -784,6 +793,73 @@ template <int K>
 struct Serializability< kmer<K> >
 { typedef TriviallySerializable type; };
 
+/**
+   Class: kmer_stream
+
+   Steps a <kmer> along a basevector one base at a time, keeping its reverse
+   complement in step, so that neither has to be rebuilt at each position by
+   SetToSubOf and ReverseComplement.  The bases are held in 64-bit words in
+   basevector packing, so a step costs a couple of shifts per word.
+*/
+template<int K> class kmer_stream {
+
+     public:
+
+     // Start at the kmer beginning at position start of b.
+     kmer_stream( const basevector& b, const int start ) : b_(b), pos_(start)
+     {    AssertLe( start + K, b.isize( ) );
+          for ( int w = 0; w < WORDS; w++ )
+               fw_[w] = rc_[w] = 0;
+          for ( int idx = 0; idx < K; idx += 16 )
+          {    uint64_t bits = b.extractKmer( start + idx, Min( 16, K - idx ) );
+               fw_[idx/32] |= bits << ( 2 * (idx%32) );    }
+          for ( int idx = 0; idx < K; idx++ )
+          {    uint64_t base = 3 - b[ start + K - 1 - idx ];
+               rc_[idx/32] |= base << ( 2 * (idx%32) );    }    }
+
+     int Pos( ) const { return pos_; }
+
+     // Is there another kmer after this one?
+     Bool More( ) const { return pos_ + K < b_.isize( ); }
+
+     // Advance to the next kmer.
+     void Next( )
+     {    AssertLt( pos_ + K, b_.isize( ) );
+          uint64_t base = b_[ pos_ + K ];
+          for ( int w = 0; w < WORDS; w++ )
+          {    fw_[w] >>= 2;
+               if ( w + 1 < WORDS ) fw_[w] |= fw_[w+1] << 62;    }
+          fw_[ (K-1)/32 ] |= base << ( 2 * ((K-1)%32) );
+          for ( int w = WORDS - 1; w >= 0; w-- )
+          {    rc_[w] <<= 2;
+               if ( w > 0 ) rc_[w] |= rc_[w-1] >> 62;    }
+          rc_[0] |= 3 - base;
+          if ( (2*K) % 64 != 0 ) rc_[WORDS-1] &= ( 1ul << ((2*K)%64) ) - 1;
+          ++pos_;    }
+
+     void Fw( kmer<K>& x ) const { x.SetBits(fw_); }
+     void Rc( kmer<K>& x ) const { x.SetBits(rc_); }
+
+     // Set x to the lesser of the kmer and its reverse complement, and
+     // return True if that's the kmer itself.
+     Bool Canonical( kmer<K>& x ) const
+     {    kmer<K> xrc;
+          Fw(x), Rc(xrc);
+          if ( !( xrc < x ) ) return True;
+          x = xrc;
+          return False;    }
+
+     private:
+
+     static const int WORDS = (K+31)/32;
+     static_assert( sizeof(kmer<K>) <= WORDS * sizeof(uint64_t),
+          "kmer too big for stream buffer." );
+
+     const basevector& b_;
+     int pos_;
+     uint64_t fw_[WORDS], rc_[WORDS];
+};
+
 template < nbases_t K > inline
 ostream& operator<< ( ostream& s, const kmer< K >& k ) {
   basevector b;
@@ -205,6 +205,12 @@ public:
     void applyCanonical( KMer<K> const& kmer, Func const& func )
     { mKSet.apply(kmer,func); }
 
+    /// Like applyCanonical, but never inserts.  Returns false if kmer isn't in
+    /// dictionary.
+    template <class Func>
+    bool applyCanonicalIfPresent( KMer<K> const& kmer, Func const& func )
+    { return mKSet.applyIfPresent(kmer,func); }
+
     /// Returns null pointer if kmer isn't in dictionary.
     KDef* lookup( KMer<K> const& kmer )
     { Entry const* pEnt = findEntry(kmer);
@@ -626,7 +626,8 @@ void naif_kmerize(KERNEL_t     * p_kernel_main,
       proc(0);
     }
     else {
-      parallelFor(0ul,n_threads,proc,n_threads);
+      // the threads meet at barriers, so each needs a thread of its own
+      parallelForThreads(0ul,n_threads,proc);
     }
   }
 
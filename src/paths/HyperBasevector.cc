@@ -645,16 +645,135 @@ template digraphEX<BaseVec>::digraphEX(digraphE<BaseVec> const&);
 template
 void DistancesToEndArr<BaseVec>(digraphE<BaseVec> const&, vec<int, std::allocator<int> > const&, int, unsigned char, vec<int, std::allocator<int> >&);
 
-void HyperBasevector::Involution( vec<int>& inv )
-{    vecbasevector edges( EdgeObjectCount( ) );
-     for ( int e = 0; e < EdgeObjectCount( ); e++ )
-          edges[e] = EdgeObject(e);
-     vec<int> x1( E( ), vec<int>::IDENTITY ), x2( E( ), vec<int>::IDENTITY );
-     inv.resize( edges.size( ) );
-     ParallelSort( x1, [&edges](int i1, int i2){ return edges[i1] < edges[i2]; } );
-     #pragma omp parallel for
-     for ( int i = 0; i < (int) edges.size( ); i++ )
-          edges[i].ReverseComplement( );
-     ParallelSort( x2, [&edges](int i1, int i2){ return edges[i1] < edges[i2]; } );
-     for ( int i = 0; i < E( ); i++ )
-          inv[ x1[i] ] = x2[i];    }
+namespace {
+
+const uint64_t InvHashMult = 0x9E3779B97F4A7C15ull;
+
+// The bases of an edge, unpacked from the basevector into a buffer from which
+// any sixteen of them can be had with a load and a shift.  It assumes the
+// little-endian layout that extractKmer describes.
+
+class packed_edge {
+
+     public:
+
+     void Load( const basevector& b )
+     {    n_ = b.size( );
+          const unsigned int len = ( n_ + 3 ) / 4 + sizeof(uint64_t);
+          bytes_.resize(len);
+          b.extractBaseBits( bytes_.data( ), len );    }
+
+     int N( ) const { return n_; }
+
+     // Get k <= 16 bases starting at pos, as extractKmer would.
+
+     unsigned int Get( const int pos, const int k ) const
+     {    uint64_t x;
+          memcpy( &x, bytes_.data( ) + pos/4, sizeof(x) );
+          x >>= 2 * ( pos & 3 );
+          return k == 16 ? (unsigned int) x 
+               : (unsigned int) x & ( ( 1u << ( 2 * k ) ) - 1 );    }
+
+     // Is this the reverse complement of e?
+
+     Bool IsRcOf( const packed_edge& e ) const
+     {    if ( e.n_ != n_ ) return False;
+          for ( int o = 0; o < n_; o += 16 )
+          {    const int k = Min( 16, n_ - o );
+               if ( Get( o, k ) 
+                    != ReverseComplementKmer( e.Get( n_ - o - k, k ), k ) )
+               {    return False;    }    }
+          return True;    }
+
+     // Hash this and its reverse complement in one pass, sixteen bases at a
+     // time.  The hash of a sequence folds in its 16-base chunks from the left,
+     // so the chunks of the reverse complement are the reverse complements of
+     // the chunks of this taken from the right.
+
+     void HashBothWays( uint64_t& fw, uint64_t& rc ) const
+     {    uint64_t f = 0, r = 0;
+          for ( int o = 0; o < n_; o += 16 )
+          {    const int k = Min( 16, n_ - o );
+               f = ( f + Get( o, k ) + 1 ) * InvHashMult;
+               r = ( r + ReverseComplementKmer( Get( n_ - o - k, k ), k ) + 1 )
+                    * InvHashMult;    }
+          fw = f ^ n_, rc = r ^ n_;    }
+
+     private:
+
+     int n_;
+     std::vector<unsigned char> bytes_;
+
+};
+
+}
+
+// The edges are put in an open-addressed table keyed by forward hash.  Then
+// each edge finds its rank among the edges having the same sequence (those
+// ahead of it in its probe sequence), and takes the edge of the same rank among
+// those that are its reverse complement.  Sequences are only compared when
+// hashes agree.  If duplicates aren't to be paired, an edge instead needs to be
+// the only one with its sequence, and to have just one reverse complement.
+
+void HyperBasevector::PartialInvolution( const vec<int>& ids, vec<int>& inv,
+     const Bool pair_duplicates ) const
+{    const int n = ids.size( );
+     vec<uint64_t> fw(n), rc(n);
+     #pragma omp parallel
+     {    packed_edge x;
+          #pragma omp for schedule(dynamic, 1000)
+          for ( int i = 0; i < n; i++ )
+          {    x.Load( EdgeObject( ids[i] ) );
+               x.HashBothWays( fw[i], rc[i] );    }    }
+     int bits = 1;
+     while( ( 1ll << bits ) < 2 * (int64_t) n ) bits++;
+     const uint64_t mask = ( 1ull << bits ) - 1;
+     auto slot = [bits]( const uint64_t h )
+          { return ( h * InvHashMult ) >> ( 64 - bits ); };
+     vec<int> table( mask + 1, -1 );
+     for ( int i = 0; i < n; i++ )
+     {    uint64_t s = slot( fw[i] );
+          while( table[s] >= 0 ) s = ( s + 1 ) & mask;
+          table[s] = i;    }
+     #pragma omp parallel
+     {    packed_edge x, y;
+          #pragma omp for schedule(dynamic, 1000)
+          for ( int i = 0; i < n; i++ )
+          {    const basevector& b = EdgeObject( ids[i] );
+               int rank = 0;
+               for ( uint64_t s = slot( fw[i] ); table[s] >= 0; 
+                    s = ( s + 1 ) & mask )
+               {    const int j = table[s];
+                    if ( j == i )
+                    {    if (pair_duplicates) break;
+                         continue;    }
+                    if ( fw[j] == fw[i] && EdgeObject( ids[j] ) == b ) 
+                         rank++;    }
+               if ( !pair_duplicates && rank > 0 )
+               {    inv[ ids[i] ] = -1;
+                    continue;    }
+               int match = -1;
+               Bool loaded = False;
+               for ( uint64_t s = slot( rc[i] ); table[s] >= 0; 
+                    s = ( s + 1 ) & mask )
+               {    const int j = table[s];
+                    if ( fw[j] != rc[i] ) continue;
+                    if ( !loaded ) 
+                    {    x.Load(b);
+                         loaded = True;    }
+                    y.Load( EdgeObject( ids[j] ) );
+                    if ( !y.IsRcOf(x) ) continue;
+                    if (pair_duplicates)
+                    {    if ( rank-- == 0 )
+                         {    match = j;
+                              break;    }    }
+                    else if ( match < 0 ) match = j;
+                    else
+                    {    match = -1;
+                         break;    }    }
+               inv[ ids[i] ] = ( match >= 0 ? ids[match] : -1 );    }    }    }
+
+void HyperBasevector::Involution( vec<int>& inv ) const
+{    inv.resize( EdgeObjectCount( ) );
+     PartialInvolution( 
+          vec<int>( EdgeObjectCount( ), vec<int>::IDENTITY ), inv );    }
@@ -126,10 +126,20 @@ class HyperBasevector : public digraphE<basevector> {
           const int e5 ) const;
      basevector Cat( const vec<int>& e ) const;
 
-     // Get involution of a HyperBasevector.  If it doesn't exist you'll get
-     // garbage.  Parallel.
+     // Get involution of a HyperBasevector.  Edges are matched to their reverse
+     // complements by hashing, and identical edges are paired in index order.
+     // An edge whose reverse complement is missing gets -1.  Parallel.
 
-     void Involution( vec<int>& inv );
+     void Involution( vec<int>& inv ) const;
+
+     // PartialInvolution: set inv[e] for each edge e in ids, pairing it with
+     // its reverse complement among ids, or -1 if there isn't one.  Other
+     // entries of inv, which should have size EdgeObjectCount( ), are
+     // unchanged.  Unless pair_duplicates is set, an edge that has an identical
+     // copy, or whose reverse complement does, gets -1.
+
+     void PartialInvolution( const vec<int>& ids, vec<int>& inv,
+          const Bool pair_duplicates = True ) const;
 
      void LowerK( int newK );
 
@@ -24,6 +24,7 @@
 #include "Vec.h"
 #include "dna/Bases.h"
 #include "feudal/BinaryStream.h"
+#include "feudal/BloomFilter.h"
 #include "feudal/VirtualMasterVec.h"
 //#include "kmers/BigKPather.h"
 #include "kmers/ReadPatherDefs.h"
@@ -32,6 +33,7 @@
 #include "paths/UnibaseUtils.h"
 #include "paths/long/HBVFromEdges.h"
 #include "paths/long/KmerCount.h"
+#include "reporting/StageProfiler.h"
 #include "system/SortInPlace.h"
 #include "system/SpinLockedData.h"
 #include "system/WorklistN.h"
@@ -56,31 +58,24 @@ typedef KmerDict<K> Dict;
 typedef UnipathGraph<K> Graph;
 typedef std::vector<std::atomic_size_t> SpectrumBins;
 
-class GoodLenTailFinder
+// length of the prefix of a read that ends with its last run of K good quals
+unsigned findGoodLen( qvec const& qv, unsigned minQual )
 {
-public:
-    GoodLenTailFinder( VecPQVec const& quals, unsigned minQual,
-                        std::vector<unsigned>* pGoodLens )
-    : mQuals(quals), mMinQual(minQual), mGoodLens(*pGoodLens) {}
-
-    void operator()( size_t readId )
-    { mQuals[readId].unpack(&mQV);
-      unsigned minQual = mMinQual;
-      auto itr = mQV.end();
-      auto beg = mQV.begin();
-      unsigned good = 0;
-      while ( itr != beg )
+    auto itr = qv.end();
+    auto beg = qv.begin();
+    unsigned good = 0;
+    while ( itr != beg )
         if ( *--itr < minQual ) good = 0;
         else if ( ++good == K )
-        { mGoodLens[readId] = (itr-beg)+K; return; }
-      mGoodLens[readId] = 0; }
+            return (itr-beg)+K;
+    return 0;
+}
 
-private:
-    VecPQVec const& mQuals;
-    unsigned mMinQual;
-    std::vector<unsigned>& mGoodLens;
-    qvec mQV;
-};
+// the same thing, without unpacking the quals
+unsigned findGoodLen( PQVec const& pqv, unsigned minQual )
+{
+    return pqv.lastRunEnd(minQual,K);
+}
 
 inline void summarizeEntries( Entry* e1, Entry* e2 )
 {
@@ -97,63 +92,77 @@ inline void summarizeEntries( Entry* e1, Entry* e2 )
     kDef.setCount(count);
 }
 
-class Kmerizer
+// Kmerizes the good part of each read into the dictionary.  In FILL mode each
+// kmer is added and counted.  In SCREEN mode the first occurrence of each kmer
+// is just noted in a Bloom filter, which keeps the kmers that occur only once
+// -- typically the majority -- out of the dictionary:  later occurrences add
+// the kmer but don't count it.  In RECOUNT mode kmers that are already in the
+// dictionary are counted, and nothing is added.  Screening and then recounting
+// gives exactly the counts and contexts that FILL mode would for every kmer
+// that occurs more than once.
+class DictFiller
 {
 public:
-    Kmerizer( vecbvec const& reads, std::vector<unsigned> const& goodLengths,
-                unsigned minFreq, Dict* pDict, std::atomic_size_t* pTotKmers )
-    : mReads(reads), mGoodLengths(goodLengths), mMinFreq(minFreq),
-      mpDict(pDict), mpTotKmers(pTotKmers), mNKmers(0)
-    {}
+    enum Mode { FILL, SCREEN, RECOUNT };
 
-    ~Kmerizer()
-    { if ( mpTotKmers ) *mpTotKmers += mNKmers; }
+    DictFiller( vecbvec const& reads, std::vector<unsigned> const& goodLengths,
+                Dict* pDict, Mode mode, BlockedBloomFilter* pFilter = nullptr )
+    : mReads(reads), mGoodLengths(goodLengths), mDict(*pDict), mMode(mode),
+      mpFilter(pFilter)
+    { AssertEq(mMode==SCREEN,mpFilter!=nullptr); }
 
-    template <class OItr>
-    void map( size_t readId, OItr oItr )
+    void operator()( size_t readId )
     { unsigned len = mGoodLengths[readId];
       if ( len < K+1 ) return;
-      auto beg = mReads[readId].begin(), itr=beg+K, last=beg+(len-1);
-      Kmer kkk(beg);
-      KMerContext kc = KMerContext::initialContext(*itr);
-      *oItr++ = kkk.isRev() ? Entry(Kmer(kkk).rc(),kc.rc()) : Entry(kkk,kc);
-      while ( itr != last )
-      { unsigned char pred = kkk.front();
-        kkk.toSuccessor(*itr); ++itr;
-        kc = KMerContext(pred,*itr);
-        *oItr++ = kkk.isRev() ? Entry(Kmer(kkk).rc(),kc.rc()) : Entry(kkk,kc); }
-      kc = KMerContext::finalContext(kkk.front());
-      kkk.toSuccessor(*last);
-      *oItr++ = kkk.isRev() ? Entry(Kmer(kkk).rc(),kc.rc()) : Entry(kkk,kc); }
-
-    void reduce( Entry* e1, Entry* e2 )
-    { summarizeEntries(e1,e2);
-      if ( e1->getKDef().getCount() >= mMinFreq )
-      { ++mNKmers;
-        if ( mpDict ) mpDict->insertEntry(std::move(*e1)); } }
-
-    Entry* overflow( Entry* e1, Entry* e2 )
-    { if ( e2-e1 > 1 ) summarizeEntries(e1,e2); return e1+1; }
+      auto beg = mReads[readId].begin();
+      Kmer::kmerizeCanonically(beg,beg+len,
+          [this]( Kmer const& kmer, CanonicalForm, KMerContext kc, size_t )
+          { addCanonical(kmer,kc); }); }
 
 private:
+    void addCanonical( Kmer const& kmer, KMerContext kc )
+    { auto count = [kc]( Entry const& entry )
+                   { KDef& kDef = const_cast<KDef&>(entry.getKDef());
+                     kDef.incrementCount();
+                     kDef.orContext(kc); };
+      switch ( mMode )
+      {
+      case FILL:
+        mDict.applyCanonical(kmer,count);
+        break;
+      case SCREEN:
+        if ( mpFilter->testAndSet(Kmer::Hasher()(kmer)) )
+          mDict.applyCanonical(kmer,[]( Entry const& ) {});
+        break;
+      case RECOUNT:
+        mDict.applyCanonicalIfPresent(kmer,count);
+        break;
+      } }
+
     vecbvec const& mReads;
     std::vector<unsigned> const& mGoodLengths;
-    unsigned mMinFreq;
-    Dict* mpDict;
-    std::atomic_size_t* mpTotKmers;
-    size_t mNKmers;
+    Dict& mDict;
+    Mode mMode;
+    BlockedBloomFilter* mpFilter;
 };
-typedef MapReduceEngine<Kmerizer,Entry,Kmer::Hasher> KMRE;
 
 Dict* createDict( vecbvec const& reads, ObjectManager<VecPQVec>& quals,
-                        unsigned minQual, unsigned minFreq )
+                        unsigned minQual, unsigned minFreq,
+                        ReadKmerCensus* pCensus )
 {
     // figure out how much of the read to kmerize by examining quals
     //std::cout << Date() << ": processing quals." << std::endl;
-    std::vector<unsigned> goodLens(reads.size());
-    parallelForBatch(0ul,reads.size(),100000,
-                         GoodLenTailFinder(quals.load(),minQual,&goodLens));
-    quals.unload();
+    StageProfile prof("createDict");
+    ReadKmerCensus localCensus(minQual,minFreq);
+    if ( !pCensus || !pCensus->isComplete(reads.size(),minQual,minFreq) )
+    { StageProfile prof2("census");
+      pCensus = &localCensus;
+      pCensus->addReads(reads,quals.load(),0,reads.size());
+      quals.unload(); }
+    size_t nDistinct = pCensus->estimateDistinctKmers();
+    size_t dictSize = pCensus->estimateDictSize();
+    std::vector<unsigned> goodLens;
+    pCensus->release(&goodLens);
     size_t nKmers = std::accumulate(goodLens.begin(),goodLens.end(),0ul);
 
     if ( nKmers == 0 )
@@ -161,29 +170,27 @@ Dict* createDict( vecbvec const& reads, ObjectManager<VecPQVec>& quals,
               << "Giving up.\n" << endl;
          Scram(1);    }
 
-    size_t dictSize;
-    if ( true )
-    { // count uniq kmers that occur at minFreq or more
-        std::atomic_size_t nUniqKmers(0);
-        Kmerizer impl(reads,goodLens,minFreq,nullptr,&nUniqKmers);
-        KMRE mre(impl);
-        if ( !mre.run(nKmers,0ul,reads.size(),KMRE::VERBOSITY::QUIET,.9) )
-            FatalErr("Failed to count unique kmers.  Out of buffer space.  ");
-        dictSize = nUniqKmers;
-    }
-
-    // kmerize reads into dictionary
+    // kmerize reads into dictionary.  when singletons are unwanted this takes
+    // two passes over the reads:  one that screens them out, and one that
+    // recounts what got past the screen.
+    StageProfile prof2("fill");
     Dict* pDict = new Dict(dictSize);
-    Kmerizer impl(reads,goodLens,minFreq,pDict,nullptr);
-    KMRE mre(impl);
-    if ( !mre.run(nKmers,0ul,reads.size(),KMRE::VERBOSITY::QUIET,.9) )
-        FatalErr("Failed to kmerize.  Out of buffer space.  ");
-
-    // some kmers were discarded because they didn't occur often enough to
-    // convince us that they were real -- recompute adjacencies to compensate
-    // for these missing kmers.
-    if ( minFreq > 1 )
-        pDict->recomputeAdjacencies();
+    if ( minFreq <= 1 )
+        parallelForBatch(0ul,reads.size(),10000,
+                    DictFiller(reads,goodLens,pDict,DictFiller::FILL));
+    else
+    {
+        { BlockedBloomFilter filter(nDistinct);
+          parallelForBatch(0ul,reads.size(),10000,
+                             DictFiller(reads,goodLens,pDict,
+                                        DictFiller::SCREEN,&filter)); }
+        parallelForBatch(0ul,reads.size(),10000,
+                    DictFiller(reads,goodLens,pDict,DictFiller::RECOUNT));
+
+        // toss kmers that didn't occur often enough to convince us that they
+        // were real, and recompute adjacencies to compensate for them.
+        pDict->clean(Dict::BadKmerCountFunctor(minFreq));
+    }
 
     return pDict;
 }
@@ -1297,6 +1304,101 @@ void repathUnpathedReads(const vecbvec& reads, const VecPQVec& quals,
 
 } // end of anonymous namespace
 
+// The sample is the kmers whose hash has its top SAMPLE_LG2 bits clear.  Its
+// entries just count occurrences.
+class ReadKmerCensus::Sample : public Dict
+{
+public:
+    static unsigned const SAMPLE_LG2 = 12;
+
+    Sample() : Dict(1ul << 16) {}
+
+    static bool isSampled( Kmer const& kmer )
+    { size_t hash = Kmer::Hasher()(kmer) * 0x9e3779b97f4a7c15ul;
+      return !(hash >> (64-SAMPLE_LG2)); }
+
+    void addCanonical( Kmer const& kmer )
+    { if ( isSampled(kmer) )
+        applyCanonical(kmer,
+            []( Entry const& entry )
+            { const_cast<KDef&>(entry.getKDef()).incrementCount(); }); }
+};
+
+ReadKmerCensus::ReadKmerCensus( unsigned minQual, unsigned minFreq )
+: mMinQual(minQual), mMinFreq(minFreq), mNReadsAdded(0),
+  mpSample(new Sample)
+{}
+
+ReadKmerCensus::~ReadKmerCensus()
+{
+    delete mpSample;
+}
+
+void ReadKmerCensus::addRead( size_t readId, bvec const& read,
+                                qvec const& quals )
+{
+    addGoodLen(readId,read,findGoodLen(quals,mMinQual));
+}
+
+void ReadKmerCensus::addGoodLen( size_t readId, bvec const& read,
+                                    unsigned len )
+{
+    ForceAssertLt(readId,mGoodLens.size());
+    mGoodLens[readId] = len;
+    ++mNReadsAdded;
+
+    // the same kmers that DictFiller will see
+    if ( len < K+1 ) return;
+    Sample& sample = *mpSample;
+    Kmer::kmerizeCanonically(read.begin(),read.begin()+len,
+        [&sample]( Kmer const& kmer, CanonicalForm, KMerContext, size_t )
+        { sample.addCanonical(kmer); });
+}
+
+void ReadKmerCensus::addReads( vecbvec const& reads, VecPQVec const& quals,
+                                size_t readBeg, size_t readEnd )
+{
+    if ( mGoodLens.size() < readEnd )
+        reserve(readEnd);
+    parallelForBatch(readBeg,readEnd,100000,
+            [this,&reads,&quals]( size_t readId )
+            { addGoodLen(readId,reads[readId],
+                            findGoodLen(quals[readId],mMinQual)); });
+}
+
+size_t ReadKmerCensus::estimateDistinctKmers() const
+{
+    ForceAssert(mpSample);
+    return std::max(1ul << 16,mpSample->size() << Sample::SAMPLE_LG2);
+}
+
+size_t ReadKmerCensus::estimateDictSize() const
+{
+    ForceAssert(mpSample);
+    // kmers seen more than once make it into the dictionary, at least until
+    // it's cleaned, as do the few singletons that the Bloom filter lets by
+    size_t minCount = std::min(mMinFreq,2u);
+    size_t nSampled = 0, nSingles = 0;
+    for ( auto const& hhs : *mpSample )
+        for ( auto const& entry : hhs )
+            if ( entry.getKDef().getCount() >= minCount )
+                nSampled += 1;
+            else
+                nSingles += 1;
+    nSampled += nSingles/32;
+    // a little extra, since it's just an estimate
+    return std::max(1ul << 16,size_t((nSampled << Sample::SAMPLE_LG2) * 1.1));
+}
+
+void ReadKmerCensus::release( std::vector<unsigned>* pGoodLens )
+{
+    pGoodLens->swap(mGoodLens);
+    mGoodLens.clear();
+    mGoodLens.shrink_to_fit();
+    delete mpSample;
+    mpSample = nullptr;
+}
+
 void buildReadQGraph( vecbvec const& reads, ObjectManager<VecPQVec>& quals,
                         bool doFillGaps, bool doJoinOverlaps,
                         unsigned minQual, unsigned minFreq,
@@ -1304,17 +1406,20 @@ void buildReadQGraph( vecbvec const& reads, ObjectManager<VecPQVec>& quals,
                         String const& refFasta,
          		bool useNewAligner, bool repathUnpathed,
                         HyperBasevector* pHBV, ReadPathVec* pPaths,
-                        bool const VERBOSE )
+                        bool const VERBOSE,
+                        ReadKmerCensus* pCensus )
 {
     //std::cout << Date() << ": loading reads." << std::endl;
 
-    Dict* pDict = createDict(reads,quals,minQual,minFreq);
+    Dict* pDict = createDict(reads,quals,minQual,minFreq,pCensus);
 
     // figure out the complete base sequence of each edge
     //std::cout << Date() << ": finding edge sequences." << std::endl;
     vecbvec edges;
     edges.reserve(pDict->size()/100);
-    buildEdges(*pDict,&edges);
+    if ( true )
+    { StageProfile prof("buildEdges");
+      buildEdges(*pDict,&edges); }
 
     unsigned minFreq2 = std::max(2u,unsigned(minFreq2Fract*minFreq+.5));
 
@@ -1338,6 +1443,7 @@ void buildReadQGraph( vecbvec const& reads, ObjectManager<VecPQVec>& quals,
     else
     {
         buildHBVFromEdges(edges,K,pHBV,&fwdEdgeXlat,&revEdgeXlat);
+        StageProfile prof("pathReads");
         pathReads(reads,quals.load(),*pDict,edges,*pHBV,
                     fwdEdgeXlat,revEdgeXlat,pPaths,useNewAligner,VERBOSE);
         delete pDict;
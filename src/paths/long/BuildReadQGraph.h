@@ -15,11 +15,16 @@
 #ifndef PATHS_LONG_BUILDREADQGRAPH_H_
 #define PATHS_LONG_BUILDREADQGRAPH_H_
 
+#include "Basevector.h"
+#include "Qualvector.h"
 #include "String.h"
 #include "feudal/ObjectManager.h"
 #include "feudal/PQVec.h"
 #include "paths/HyperBasevector.h"
 #include "paths/long/ReadPath.h"
+#include <atomic>
+#include <cstddef>
+#include <vector>
 
 inline void dumpHBV( ostream& out, const HyperBasevector& h )
 {
@@ -33,6 +38,64 @@ inline void dumpHBV( ostream& out, const HyperBasevector& h )
     }
 }
 
+/// Gathers, while reads are still being ingested, what buildReadQGraph would
+/// otherwise have to learn in a pass over the reads before it fills its kmer
+/// dictionary: the length of the high-quality part of each read, and the
+/// number of distinct kmers, both overall and occurring repeatedly.  These are
+/// estimated from an exact count over a hash-selected sample of the kmers,
+/// which is good enough to size the dictionary and its singleton filter.
+///
+/// Call reserve each time more reads are appended, then addRead (in parallel,
+/// if you like) for each of them, while their quals are still unpacked.
+class ReadKmerCensus
+{
+public:
+    ReadKmerCensus( unsigned minQual, unsigned minFreq );
+    ~ReadKmerCensus();
+
+    ReadKmerCensus( ReadKmerCensus const& )=delete;
+    ReadKmerCensus& operator=( ReadKmerCensus const& )=delete;
+
+    /// Make room for reads with IDs less than nReads.  Not thread-safe.
+    void reserve( size_t nReads ) { mGoodLens.resize(nReads); }
+
+    /// Thread-safe for distinct read IDs.
+    void addRead( size_t readId, bvec const& read, qvec const& quals );
+
+    /// Catch up on reads [readBeg,readEnd) that were appended with their
+    /// quals already packed (e.g., by BAMReader).  Reserves room for them.
+    void addReads( vecbvec const& reads, VecPQVec const& quals,
+                    size_t readBeg, size_t readEnd );
+
+    /// True if every one of nReads reads was counted with these settings.
+    bool isComplete( size_t nReads, unsigned minQual, unsigned minFreq ) const
+    { return mGoodLens.size() == nReads && mNReadsAdded == nReads &&
+                mMinQual == minQual && mMinFreq == minFreq; }
+
+    /// Estimated number of distinct kmers.
+    size_t estimateDistinctKmers() const;
+
+    /// Estimated number of distinct kmers that the dictionary will hold at
+    /// its largest: those that occur more than once, unless minFreq is 1.
+    size_t estimateDictSize() const;
+
+    /// Moves the good lengths into *pGoodLens, and frees the sample.
+    void release( std::vector<unsigned>* pGoodLens );
+
+private:
+    class Sample;
+
+    void addGoodLen( size_t readId, bvec const& read, unsigned len );
+
+    unsigned mMinQual;
+    unsigned mMinFreq;
+    std::vector<unsigned> mGoodLens;
+    std::atomic_size_t mNReadsAdded;
+    Sample* mpSample;
+};
+
+/// If pCensus is supplied, and it covers all the reads, the passes over the
+/// reads that it makes unnecessary are skipped.
 void buildReadQGraph( vecbvec const& reads, ObjectManager<VecPQVec>& quals,
                         bool doFillGaps, bool doJoinOverlaps,
                         unsigned minQual, unsigned minFreq,
@@ -40,7 +103,8 @@ void buildReadQGraph( vecbvec const& reads, ObjectManager<VecPQVec>& quals,
                         String const& refFasta,
        		        bool useNewAligner, bool repathUnpathed,
                         HyperBasevector* pHBV, ReadPathVec* pPaths,
-                        bool const VERBOSE = False );
+                        bool const VERBOSE = False,
+                        ReadKmerCensus* pCensus = nullptr );
 
 void rePath( HyperBasevector const& hbv,
                 vecbvec const& reads, VecPQVec const& quals,
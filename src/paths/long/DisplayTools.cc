@@ -94,7 +94,7 @@ void ParseSeeds( const HyperBasevector& hb, const vec<int>& to_right,
 
 Bool ParseSeeds( const HyperBasevectorX& hb, const vec<int>& inv,
      const vec< triple<kmer<20>,int,int> >& kmers_plus,
-     const vec<vec<vec<vec<int>>>>& lines, const vec<String>& genome_names,
+     const line_store& lines, const vec<String>& genome_names,
      const vec< pair<int,ho_interval> >& ambint, Bool& ambflag,
      const vec< vec< pair<int,int> > >& hits, const String& SEEDS, 
      const int RANDOM_SEED, const String& SEEDS_MINUS, vec<int>& seeds,
@@ -425,6 +425,12 @@ void ZeroCorrectedQuals( vecbasevector const& oreads, vecbvec const& creads,
 {
     ZeroCorrectedQuals_impl<decltype(oreads)>::do_it(oreads,creads,pQuals);
 }
+// zero all quality scores associated with corrections (for a subset of global reads)
+void ZeroCorrectedQuals( ReadSubset const& oreads, vecbvec const& creads,
+                            vecqvec* pQuals )
+{
+    ZeroCorrectedQuals_impl<decltype(oreads)>::do_it(oreads,creads,pQuals);
+}
 
 void CapQualityScores( vecqualvector& cquals, const vec<Bool>& done )
 {    const int cap_radius = 4;
@@ -476,7 +482,11 @@ void CorrectionSuite( LongProtoTmpDirManager& tmp_mgr, const long_heuristics& he
 
      {    double bclock = WallClockTime( );
           vecqualvector cquals;
-          if( bOrgReadsInMem ){
+          if( tmp_mgr[sFragReadsOrig].hasSubset() ){
+              tmp_mgr[sFragReadsOrig].subset().copyBases(&creads);
+              tmp_mgr[sFragReadsOrig].subset().copyQuals(&cquals);
+          }
+          else if( bOrgReadsInMem ){
               creads = tmp_mgr[sFragReadsOrig].reads();
               cquals = tmp_mgr[sFragReadsOrig].quals();
           }
@@ -514,7 +524,10 @@ void CorrectionSuite( LongProtoTmpDirManager& tmp_mgr, const long_heuristics& he
               pre_correct_parallel( pcp, K_PC, &creads, &cquals, &kspec,
                                         -1, NUM_THREADS );    }
 
-          if( bOrgReadsInMem ){
+          if( tmp_mgr[sFragReadsOrig].hasSubset() ){
+              ZeroCorrectedQuals(tmp_mgr[sFragReadsOrig].subset(),creads,&cquals);
+          }
+          else if( bOrgReadsInMem ){
               ZeroCorrectedQuals(tmp_mgr[sFragReadsOrig].reads(),creads,&cquals);
           }
           else{
@@ -25,6 +25,9 @@ void ZeroCorrectedQuals( String const& readsFile, vecbvec const& creads,
 // zero all quality scores associated with corrections (for reads already in memory)
 void ZeroCorrectedQuals( vecbasevector const& readsFile, vecbvec const& creads,
                             vecqvec* pQuals );
+// zero all quality scores associated with corrections (for a subset of global reads)
+void ZeroCorrectedQuals( ReadSubset const& oreads, vecbvec const& creads,
+                            vecqvec* pQuals );
 
 void SamIAm( const int i, const String& getsam, const String& TMP,
                 bool keepLocs = false, String const& dexterLibs = "",
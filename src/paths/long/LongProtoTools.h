@@ -29,6 +29,7 @@
 #include "paths/long/Logging.h"
 #include "paths/long/LongProtoTools.h"
 #include "paths/long/PairInfo.h"
+#include "paths/long/ReadSubset.h"
 #include "paths/long/ultra/ConsensusScoreModel.h"
 #include "system/ParsedArgs.h"
 #include "system/System.h"
@@ -189,6 +190,7 @@ class LongProtoReadsQualsPairs{
         T& get(bool bResetFile=false){ return const_cast<T&>( static_cast<const path_or_data<T>&>(*this).get(bResetFile) ); }
 
         bool inMem()const{return static_cast<bool>(ptr);};
+        void removeFile()const{ if(sPath.size()>0 && IsRegularFile(sPath)) Remove(sPath); }
 
         void setPath(const String&s){ sPath=s; }
         void clearPath(){sPath.clear();};
@@ -205,24 +207,40 @@ public:
         :reads_(head+".fastb") ,quals_(head+".qualb") ,pairs_(head+".pairs") {}
     LongProtoReadsQualsPairs(const String& head,vecbasevector const&a,vecqualvector const&b,PairsManager const&c)
         :reads_(head+".fastb",a) ,quals_(head+".qualb",b) ,pairs_(head+".pairs",c) {}
-    vecbasevector const& reads(bool bResetFile=false)const{return reads_.get(bResetFile);}
-    vecqualvector const& quals(bool bResetFile=false)const{return quals_.get(bResetFile);}
+    vecbasevector const& reads(bool bResetFile=false)const{
+        if(!subset_.empty() && !reads_.inMem()) subset_.copyBases(&const_cast<vecbasevector&>(reads_.get(bResetFile)));
+        return reads_.get(bResetFile);}
+    vecqualvector const& quals(bool bResetFile=false)const{
+        if(!subset_.empty() && !quals_.inMem()) subset_.copyQuals(&const_cast<vecqualvector&>(quals_.get(bResetFile)));
+        return quals_.get(bResetFile);}
     PairsManager  const& pairs(bool bResetFile=false)const{return pairs_.get(bResetFile);}
 
-    vecbasevector& reads(bool bResetFile=false){return reads_.get(bResetFile);}
-    vecqualvector& quals(bool bResetFile=false){return quals_.get(bResetFile);}
+    vecbasevector& reads(bool bResetFile=false){ return const_cast<vecbasevector&>( static_cast<const LongProtoReadsQualsPairs&>(*this).reads(bResetFile) ); }
+    vecqualvector& quals(bool bResetFile=false){ return const_cast<vecqualvector&>( static_cast<const LongProtoReadsQualsPairs&>(*this).quals(bResetFile) ); }
     PairsManager&  pairs(bool bResetFile=false){return pairs_.get(bResetFile);}
-    void write(){ reads_.write(); quals_.write(); pairs_.write(); }
+
+    // serve reads and quals from a subset of global reads instead of from files; nothing is copied
+    // until someone asks for reads() or quals(), so code that can use the subset directly should
+    void setSubset(ReadSubset subset){
+        reads_.clearMem(); quals_.clearMem();
+        reads_.removeFile(); quals_.removeFile();
+        subset_=std::move(subset);
+    }
+    bool hasSubset()const{return !subset_.empty();}
+    ReadSubset const& subset()const{return subset_;}
+
+    void write(){ if(hasSubset()){ reads(); quals(); } reads_.write(); quals_.write(); pairs_.write(); }
     void clearMem()const{
         reads_.clearMem();
         quals_.clearMem();
         pairs_.clearMem();
     }
-    bool inMem()const{return reads_.inMem() || quals_.inMem() || pairs_.inMem();};
+    bool inMem()const{return hasSubset() || reads_.inMem() || quals_.inMem() || pairs_.inMem();};
 private:
     path_or_data<vecbasevector> reads_;
     path_or_data<vecqualvector> quals_;
     path_or_data<PairsManager>  pairs_;
+    ReadSubset subset_;
 };
 
 // deals with Tmp directory's file, intended to replace all "TMP" hard coded stuff
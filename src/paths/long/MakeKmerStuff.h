@@ -25,14 +25,19 @@ template<int K> void MakeKmerLookup1( const vecbasevector& unibases,
      {    const basevector& u = unibases[i];
           starts.push_back( starts.back( ) + Max( 0, u.isize( ) - K + 1 ) );    }
      kmers_plus.resize( starts.back( ) );
+     const int block = 10000;
      for ( size_t i = 0; i < unibases.size( ); i++ )
      {    const basevector& u = unibases[i];
+          const int nkmers = u.isize( ) - K + 1;
           #pragma omp parallel for
-          for ( int j = 0; j <= u.isize( ) - K; j++ )
-          {    int64_t r = starts[i] + j;
-               kmers_plus[r].first.SetToSubOf( u, j );
-               kmers_plus[r].second = i;
-               kmers_plus[r].third = j;    }    }
+          for ( int j0 = 0; j0 < nkmers; j0 += block )
+          {    kmer_stream<K> ks( u, j0 );
+               for ( int j = j0; j < Min( nkmers, j0 + block ); j++ )
+               {    if ( j > j0 ) ks.Next( );
+                    int64_t r = starts[i] + j;
+                    ks.Fw( kmers_plus[r].first );
+                    kmers_plus[r].second = i;
+                    kmers_plus[r].third = j;    }    }    }
      ParallelSort(kmers_plus);    }
 
 template<int K> void MakeKmerLookup2( const vecbasevector& unibases,
@@ -46,16 +51,17 @@ template<int K> void MakeKmerLookup2( const vecbasevector& unibases,
      #pragma omp parallel for
      for ( size_t i = 0; i < unibases.size( ); i++ )
      {    const basevector& u = unibases[i];
+          if ( u.isize( ) < K ) continue;
           kmer<K> x, xrc;
-          for ( int j = 0; j <= u.isize( ) - K; j++ )
-          {    int64_t r = starts[i] + j;
-               x.SetToSubOf( u, j );
-               xrc = x;
-               xrc.ReverseComplement( );
+          for ( kmer_stream<K> ks( u, 0 ); ; ks.Next( ) )
+          {    int j = ks.Pos( );
+               int64_t r = starts[i] + j;
+               ks.Fw(x), ks.Rc(xrc);
                Bool fw = ( x < xrc );
                kmers_plus[r].first = ( fw ? x : xrc );
                kmers_plus[r].second = i;
-               kmers_plus[r].third = ( fw ? j : -j-1 );    }    }
+               kmers_plus[r].third = ( fw ? j : -j-1 );
+               if ( !ks.More( ) ) break;    }    }
      ParallelSort(kmers_plus);    }
 
 // unparallel version
@@ -70,11 +76,13 @@ template<int K> void MakeKmerLookup3( const vecbasevector& unibases,
      kmers_plus.resize( starts.back( ) );
      for ( size_t i = 0; i < unibases.size( ); i++ )
      {    const basevector& u = unibases[i];
-          for ( int j = 0; j <= u.isize( ) - K; j++ )
-          {    int64_t r = starts[i] + j;
-               kmers_plus[r].first.SetToSubOf( u, j );
+          if ( u.isize( ) < K ) continue;
+          for ( kmer_stream<K> ks( u, 0 ); ; ks.Next( ) )
+          {    int64_t r = starts[i] + ks.Pos( );
+               ks.Fw( kmers_plus[r].first );
                kmers_plus[r].second = i;
-               kmers_plus[r].third = j;    }    }
+               kmers_plus[r].third = ks.Pos( );
+               if ( !ks.More( ) ) break;    }    }
      Sort(kmers_plus);    }
 
 #endif
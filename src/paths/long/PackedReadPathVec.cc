@@ -0,0 +1,144 @@
+///////////////////////////////////////////////////////////////////////////////
+//                   SOFTWARE COPYRIGHT NOTICE AGREEMENT                     //
+//       This software and its documentation are copyright (2015) by the     //
+//   Broad Institute.  All rights are reserved.  This software is supplied   //
+//   without any warranty or guaranteed support whatsoever. The Broad        //
+//   Institute is not responsible for its use, misuse, or functionality.     //
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * \file PackedReadPathVec.cc
+ *
+ * \brief
+ */
+
+#include "paths/long/PackedReadPathVec.h"
+#include "feudal/FeudalControlBlock.h"
+#include "feudal/FeudalFileWriter.h"
+#include "system/WorklistN.h"
+#include "system/file/FileReader.h"
+#include <sys/mman.h>
+
+namespace
+{
+size_t const BATCH_SIZE = 10000;
+}
+
+PackedReadPathVec::PackedReadPathVec( ReadPathVec const& paths )
+: mMapped(0), mMappedLen(0)
+{
+    pack(paths);
+}
+
+PackedReadPathVec::PackedReadPathVec( String const& fileName )
+: mMapped(0), mMappedLen(0)
+{
+    FileReader fr(fileName.c_str());
+    size_t fileLen;
+    FeudalControlBlock fcb(fr,true,&fileLen);
+    if ( fcb.getSizeofA() != sizeof(ReadPath::value_type) )
+        FatalErr(fileName << " doesn't seem to be a ReadPathVec.");
+
+    // the old three-file format can't be used in place
+    if ( fcb.getNFiles() != 1 )
+    {
+        pack(ReadPathVec(fileName));
+        return;
+    }
+
+    mMappedLen = fileLen;
+    mMapped = fr.map(0ul,mMappedLen,true);
+    mBase = static_cast<char const*>(mMapped);
+    mStarts = mBase + fcb.getVarTabOffset();
+    mNPaths = fcb.getNElements();
+}
+
+PackedReadPathVec::~PackedReadPathVec()
+{
+    if ( mMapped )
+        munmap(mMapped,mMappedLen);
+}
+
+// Lay the paths out as a feudal file would, with offsets relative to the data.
+void PackedReadPathVec::pack( ReadPathVec const& paths )
+{
+    mNPaths = paths.size();
+    mStartsVec.resize(mNPaths+1);
+    size_t nInts = 0;
+    for ( size_t idx = 0; idx != mNPaths; ++idx )
+    {
+        mStartsVec[idx] = nInts*sizeof(int);
+        nInts += HEADER_INTS + paths[idx].size();
+    }
+    mStartsVec[mNPaths] = nInts*sizeof(int);
+
+    mData.resize(nInts);
+    int* data = mData.data();
+    size_t const* starts = mStartsVec.data();
+    parallelForBatch(0ul,mNPaths,BATCH_SIZE,
+        [&paths,data,starts]( size_t idx )
+        { ReadPath const& rp = paths[idx];
+          int* rec = data + starts[idx]/sizeof(int);
+          // the last skip isn't accessible, and is always 0
+          rec[0] = rp.getOffset();
+          rec[1] = 0;
+          std::copy(rp.begin(),rp.end(),rec+HEADER_INTS); });
+
+    mBase = reinterpret_cast<char const*>(data);
+    mStarts = reinterpret_cast<char const*>(starts);
+}
+
+ReadPath& PackedReadPathVec::edit( size_t idx )
+{
+    AssertLt(idx,mNPaths);
+    if ( mEdited.empty() )
+        mEdited.resize(mNPaths,false);
+    auto itr = mEdits.find(idx);
+    if ( itr != mEdits.end() )
+        return itr->second;
+    Path path = (*this)[idx];
+    ReadPath& rp = mEdits[idx];
+    rp.setOffset(path.getOffset());
+    rp.assign(path.begin(),path.end());
+    mEdited[idx] = true;
+    return rp;
+}
+
+void PackedReadPathVec::WriteAll( String const& fileName ) const
+{
+    FeudalFileWriter writer(fileName.c_str(),sizeof(ReadPath),
+                            sizeof(ReadPath::value_type),
+                            ReadPath::fixedDataLen(),mNPaths);
+    BinaryWriter& bw = writer.getWriter();
+    for ( size_t idx = 0; idx != mNPaths; ++idx )
+    {
+        if ( isEdited(idx) )
+        {
+            void const* pFixed;
+            mEdits.find(idx)->second.writeFeudal(bw,&pFixed);
+            writer.addElement(pFixed);
+        }
+        else
+        {
+            char const* beg = reinterpret_cast<char const*>(record(idx));
+            char const* end = reinterpret_cast<char const*>(record(idx+1));
+            bw.write(beg,end);
+            writer.addElement(nullptr);
+        }
+    }
+    writer.close();
+}
+
+void PackedReadPathVec::unpack( ReadPathVec* pPaths ) const
+{
+    ReadPathVec& paths = *pPaths;
+    paths.clear();
+    paths.resize(mNPaths);
+    for ( size_t idx = 0; idx != mNPaths; ++idx )
+        paths[idx].reserve((*this)[idx].size());
+    parallelForBatch(0ul,mNPaths,BATCH_SIZE,
+        [this,&paths]( size_t idx )
+        { Path path = (*this)[idx];
+          ReadPath& rp = paths[idx];
+          rp.setOffset(path.getOffset());
+          rp.assign(path.begin(),path.end()); });
+}
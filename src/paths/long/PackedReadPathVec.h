@@ -0,0 +1,133 @@
+///////////////////////////////////////////////////////////////////////////////
+//                   SOFTWARE COPYRIGHT NOTICE AGREEMENT                     //
+//       This software and its documentation are copyright (2015) by the     //
+//   Broad Institute.  All rights are reserved.  This software is supplied   //
+//   without any warranty or guaranteed support whatsoever. The Broad        //
+//   Institute is not responsible for its use, misuse, or functionality.     //
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * \file PackedReadPathVec.h
+ *
+ * \brief A ReadPathVec packed into a single block of memory.
+ */
+#ifndef PACKEDREADPATHVEC_H_
+#define PACKEDREADPATHVEC_H_
+
+#include "String.h"
+#include "paths/long/ReadPath.h"
+#include <cstddef>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+/// The same data as a ReadPathVec, but with all the paths packed end to end in
+/// one block, and a table of where each begins, instead of a separate
+/// allocation for each path.
+///
+/// The packing is exactly the variable-length data of a ReadPathVec feudal file
+/// (each path is its offset and last-skip, followed by its edge ids), and the
+/// table is the file's offsets table.  So a file (e.g., a.fin/a.paths) can be
+/// memory-mapped and used in place, without reading or allocating anything.
+///
+/// The packed paths are read-only.  Changing a path copies it into an overlay
+/// of edited paths, which then supersedes the packed one.  WriteAll merges the
+/// overlay back in.
+///
+/// Reading is thread-safe, but editing is not.
+class PackedReadPathVec
+{
+public:
+    /// A path, pointing into the packing or the overlay.  Valid until the
+    /// PackedReadPathVec is destroyed or the path is edited.
+    class Path
+    {
+    public:
+        typedef int value_type;
+        typedef int const* const_iterator;
+
+        Path( int offset, int const* beg, int const* end )
+        : mOffset(offset), mBeg(beg), mEnd(end) {}
+
+        int getOffset() const { return mOffset; }
+        unsigned getFirstSkip() const
+        { return mOffset < 0 ? 0u : static_cast<unsigned>(mOffset); }
+
+        const_iterator begin() const { return mBeg; }
+        const_iterator end() const { return mEnd; }
+        size_t size() const { return mEnd - mBeg; }
+        bool empty() const { return mBeg == mEnd; }
+        int operator[]( size_t idx ) const { return mBeg[idx]; }
+        int front() const { return *mBeg; }
+        int back() const { return mEnd[-1]; }
+
+    private:
+        int mOffset;
+        int const* mBeg;
+        int const* mEnd;
+    };
+
+    PackedReadPathVec() : mBase(0), mStarts(0), mNPaths(0),
+                          mMapped(0), mMappedLen(0) {}
+
+    /// Pack an existing ReadPathVec.
+    explicit PackedReadPathVec( ReadPathVec const& paths );
+
+    /// Map a ReadPathVec feudal file.
+    explicit PackedReadPathVec( String const& fileName );
+
+    ~PackedReadPathVec();
+
+    PackedReadPathVec( PackedReadPathVec const& )=delete;
+    PackedReadPathVec& operator=( PackedReadPathVec const& )=delete;
+
+    size_t size() const { return mNPaths; }
+
+    Path operator[]( size_t idx ) const
+    { if ( !mEdits.empty() && mEdited[idx] )
+      { ReadPath const& rp = mEdits.find(idx)->second;
+        int const* beg = rp.empty() ? nullptr : &rp[0];
+        return Path(rp.getOffset(),beg,beg+rp.size()); }
+      int const* rec = record(idx);
+      return Path(rec[0],rec+HEADER_INTS,record(idx+1)); }
+
+    /// Get a modifiable copy of a path, which replaces it from now on.  The
+    /// overlay isn't locked:  edits must come from a single thread, and nobody
+    /// may be reading paths while they're made.
+    ReadPath& edit( size_t idx );
+
+    bool isEdited( size_t idx ) const
+    { return !mEdits.empty() && mEdited[idx]; }
+
+    size_t getNEdited() const { return mEdits.size(); }
+
+    /// Write a ReadPathVec feudal file, including any edits.
+    void WriteAll( String const& fileName ) const;
+
+    /// Copy into a ReadPathVec, including any edits.
+    void unpack( ReadPathVec* pPaths ) const;
+
+private:
+    // each path begins with mOffset and mLastSkip, as ReadPath::writeFeudal
+    // writes them
+    static size_t const HEADER_INTS = 2;
+
+    void pack( ReadPathVec const& paths );
+
+    // mStarts may not be aligned, so we have to memcpy
+    int const* record( size_t idx ) const
+    { size_t start;
+      memcpy(&start,mStarts+idx*sizeof(start),sizeof(start));
+      return reinterpret_cast<int const*>(mBase+start); }
+
+    char const* mBase;
+    char const* mStarts;
+    size_t mNPaths;
+    std::vector<int> mData;
+    std::vector<size_t> mStartsVec;
+    void* mMapped;
+    size_t mMappedLen;
+    std::unordered_map<size_t,ReadPath> mEdits;
+    std::vector<bool> mEdited;
+};
+
+#endif /* PACKEDREADPATHVEC_H_ */
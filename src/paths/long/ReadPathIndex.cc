@@ -0,0 +1,62 @@
+///////////////////////////////////////////////////////////////////////////////
+//                   SOFTWARE COPYRIGHT NOTICE AGREEMENT                     //
+//       This software and its documentation are copyright (2015) by the     //
+//   Broad Institute.  All rights are reserved.  This software is supplied   //
+//   without any warranty or guaranteed support whatsoever. The Broad        //
+//   Institute is not responsible for its use, misuse, or functionality.     //
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * \file ReadPathIndex.cc
+ *
+ * \brief
+ */
+
+#include "paths/long/ReadPathIndex.h"
+#include "feudal/FeudalFileReader.h"
+#include "feudal/FeudalFileWriter.h"
+
+// The file has the layout of a VecULongVec: ULongVec has no fixed-length data,
+// so each edge is just its run of ids.
+void ReadPathIndex::WriteAll( String const& fileName ) const
+{
+    ForceAssertEq(ULongVec::fixedDataLen(),0u);
+    size_t nnn = size();
+    FeudalFileWriter writer(fileName.c_str(),sizeof(ULongVec),
+                            sizeof(value_type),0u,nnn);
+    value_type const* ids = mIds.data();
+    for ( size_t edge = 0; edge != nnn; ++edge )
+    {
+        writer.getWriter().write(ids+mOffsets[edge],ids+mOffsets[edge+1]);
+        writer.addElement(nullptr);
+    }
+    writer.close();
+}
+
+void ReadPathIndex::ReadAll( String const& fileName )
+{
+    FeudalFileReader rdr(fileName.c_str());
+    size_t nnn = rdr.getNElements();
+    mOffsets.resize(nnn+1);
+    mOffsets[0] = 0;
+    for ( size_t edge = 0; edge != nnn; ++edge )
+        mOffsets[edge+1] = mOffsets[edge] +
+                                rdr.getDataLen(edge)/sizeof(value_type);
+    mIds.resize(mOffsets[nnn]);
+    value_type* ids = mIds.data();
+    if ( nnn )
+        rdr.getData(0).read(ids,ids+mIds.size());
+}
+
+void ReadPathIndex::unpack( VecULongVec* pVV ) const
+{
+    size_t nnn = size();
+    VecULongVec& vv = *pVV;
+    vv.clear();
+    vv.resize(nnn);
+    for ( size_t edge = 0; edge != nnn; ++edge )
+        vv[edge].reserve(mOffsets[edge+1]-mOffsets[edge]);
+    parallelForBatch(0ul,nnn,BATCH_SIZE,
+        [this,&vv]( size_t edge )
+        { Ids ids = (*this)[edge];
+          vv[edge].assign(ids.begin(),ids.end()); });
+}
@@ -0,0 +1,152 @@
+///////////////////////////////////////////////////////////////////////////////
+//                   SOFTWARE COPYRIGHT NOTICE AGREEMENT                     //
+//       This software and its documentation are copyright (2015) by the     //
+//   Broad Institute.  All rights are reserved.  This software is supplied   //
+//   without any warranty or guaranteed support whatsoever. The Broad        //
+//   Institute is not responsible for its use, misuse, or functionality.     //
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * \file ReadPathIndex.h
+ *
+ * \brief Edge-to-read index for a ReadPathVec, in compressed sparse row form.
+ */
+#ifndef READPATHINDEX_H_
+#define READPATHINDEX_H_
+
+#include "Intvector.h"
+#include "String.h"
+#include "system/Assert.h"
+#include "system/WorklistN.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/// For each edge, the sorted ids of the paths that traverse it (once for each
+/// traversal).  This is what invert() makes of a ReadPathVec, but the ids are
+/// held in one flat array with an array of per-edge offsets into it, rather
+/// than in a separately allocated vector for each edge, and it's built in
+/// parallel by a counting sort.
+///
+/// The index is immutable once built.  WriteAll writes the same file format as
+/// VecULongVec::WriteAll (e.g., a.paths.inv), and ReadAll reads that format.
+/// Consumers that edit the index as they edit the graph can unpack it into a
+/// VecULongVec.
+class ReadPathIndex
+{
+public:
+    typedef unsigned long value_type;
+    typedef value_type const* const_iterator;
+
+    /// The path ids for one edge.
+    class Ids
+    {
+    public:
+        Ids( const_iterator beg, const_iterator end ) : mBeg(beg), mEnd(end) {}
+
+        const_iterator begin() const { return mBeg; }
+        const_iterator end() const { return mEnd; }
+        size_t size() const { return mEnd - mBeg; }
+        bool empty() const { return mBeg == mEnd; }
+        value_type operator[]( size_t idx ) const { return mBeg[idx]; }
+
+    private:
+        const_iterator mBeg;
+        const_iterator mEnd;
+    };
+
+    ReadPathIndex() : mOffsets(1,0ul) {}
+
+    /// Index the edge ids in each element of paths, which may be a ReadPathVec
+    /// or any other vector of vectors of non-negative integers.  There will be
+    /// at least minSize edges.
+    template <class VV>
+    explicit ReadPathIndex( VV const& paths, size_t minSize = 0 )
+    { build(paths,minSize); }
+
+    ReadPathIndex( ReadPathIndex const& )=delete;
+    ReadPathIndex( ReadPathIndex&& )=default;
+    ReadPathIndex& operator=( ReadPathIndex const& )=delete;
+    ReadPathIndex& operator=( ReadPathIndex&& )=default;
+
+    template <class VV>
+    void build( VV const& paths, size_t minSize = 0 );
+
+    /// Number of edges.
+    size_t size() const { return mOffsets.size()-1; }
+
+    /// Total number of ids.
+    size_t getNIds() const { return mIds.size(); }
+
+    Ids operator[]( size_t edge ) const
+    { return Ids(mIds.data()+mOffsets[edge],mIds.data()+mOffsets[edge+1]); }
+
+    void WriteAll( String const& fileName ) const;
+    void ReadAll( String const& fileName );
+
+    /// Copy into a VecULongVec, as invert() would have made it.
+    void unpack( VecULongVec* pVV ) const;
+
+private:
+    static size_t const BATCH_SIZE = 10000;
+
+    std::vector<size_t> mOffsets;
+    std::vector<value_type> mIds;
+};
+
+template <class VV>
+void ReadPathIndex::build( VV const& paths, size_t minSize )
+{
+    size_t nPaths = paths.size();
+
+    // find the number of edges
+    std::atomic<size_t> nEdges(minSize);
+    parallelForBatch(0ul,nPaths,BATCH_SIZE,
+        [&paths,&nEdges]( size_t idx )
+        { for ( auto val : paths[idx] )
+          { ForceAssertGe(val,decltype(val)(0));
+            size_t sz = nEdges;
+            while ( size_t(val) >= sz &&
+                    !nEdges.compare_exchange_weak(sz,size_t(val)+1) ) {} } });
+
+    // count ids for each edge
+    size_t nnn = nEdges;
+    std::unique_ptr<std::atomic<size_t>[]> next(new std::atomic<size_t>[nnn]());
+    parallelForBatch(0ul,nPaths,BATCH_SIZE,
+        [&paths,&next]( size_t idx )
+        { for ( auto val : paths[idx] )
+            next[val].fetch_add(1,std::memory_order_relaxed); });
+
+    mOffsets.resize(nnn+1);
+    mOffsets[0] = 0;
+    for ( size_t edge = 0; edge != nnn; ++edge )
+    { mOffsets[edge+1] = mOffsets[edge] + next[edge];
+      next[edge] = mOffsets[edge]; }
+
+    // scatter the ids, then sort each edge's ids.  Each batch claims all its
+    // slots before storing any ids: interleaving the stores with the atomic
+    // increments, which fence them, makes this several times slower.
+    mIds.resize(mOffsets[nnn]);
+    value_type* ids = mIds.data();
+    size_t nBatches = (nPaths+BATCH_SIZE-1)/BATCH_SIZE;
+    parallelFor(0ul,nBatches,
+        [&paths,&next,ids,nPaths]( size_t batch )
+        { size_t beg = batch*BATCH_SIZE;
+          size_t end = std::min(nPaths,beg+BATCH_SIZE);
+          std::vector<size_t> slots;
+          for ( size_t idx = beg; idx != end; ++idx )
+            for ( auto val : paths[idx] )
+              slots.push_back(next[val].fetch_add(1,std::memory_order_relaxed));
+          size_t const* pSlot = slots.data();
+          for ( size_t idx = beg; idx != end; ++idx )
+            for ( size_t cnt = paths[idx].size(); cnt; --cnt )
+              ids[*pSlot++] = idx; });
+    next.reset();
+    size_t const* offs = mOffsets.data();
+    parallelForBatch(0ul,nnn,BATCH_SIZE,
+        [offs,ids]( size_t edge )
+        { std::sort(ids+offs[edge],ids+offs[edge+1]); });
+}
+
+#endif /* READPATHINDEX_H_ */
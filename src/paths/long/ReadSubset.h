@@ -0,0 +1,102 @@
+///////////////////////////////////////////////////////////////////////////////
+//                   SOFTWARE COPYRIGHT NOTICE AGREEMENT                     //
+//       This software and its documentation are copyright (2015) by the     //
+//   Broad Institute.  All rights are reserved.  This software is supplied   //
+//   without any warranty or guaranteed support whatsoever. The Broad        //
+//   Institute is not responsible for its use, misuse, or functionality.     //
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * \file ReadSubset.h
+ *
+ * \brief Some of the reads in a global vecbvec and VecPQVec, by id.
+ */
+#ifndef READSUBSET_H_
+#define READSUBSET_H_
+
+#include "Basevector.h"
+#include "Qualvector.h"
+#include "Vec.h"
+#include "feudal/Iterator.h"
+#include "feudal/PQVec.h"
+#include <cstddef>
+#include <iterator>
+
+/// A list of read ids into a global vecbvec and VecPQVec, which stands in for
+/// the vecbvec and vecqvec of just those reads without copying them.  Bases
+/// are returned by reference from the global vecbvec, and quals are unpacked
+/// only when asked for.  The globals must outlive the subset.
+class ReadSubset
+{
+public:
+    class const_iterator
+    : public std::iterator<std::random_access_iterator_tag,bvec const,
+                            std::ptrdiff_t,bvec const*,bvec const&>,
+      public IteratorBase<const_iterator,size_t,std::ptrdiff_t>
+    {
+    public:
+        const_iterator() : mpSubset(nullptr) {}
+        const_iterator( ReadSubset const* pSubset, size_t pos )
+        : IteratorBase<const_iterator,size_t,std::ptrdiff_t>(pos),
+          mpSubset(pSubset) {}
+
+        // compiler-supplied copying and destructor are OK
+
+        bvec const& operator*() const { return (*mpSubset)[this->mPos]; }
+        bvec const* operator->() const { return &(*mpSubset)[this->mPos]; }
+        bvec const& operator[]( std::ptrdiff_t diff ) const
+        { return (*mpSubset)[this->mPos+diff]; }
+
+    private:
+        ReadSubset const* mpSubset;
+    };
+
+    ReadSubset() : mpBases(nullptr), mpQuals(nullptr) {}
+
+    ReadSubset( vecbvec const& bases, VecPQVec const& quals, vec<int64_t> ids )
+    : mpBases(&bases), mpQuals(&quals), mIds(std::move(ids)) {}
+
+    // compiler-supplied copying, moving, and destructor are OK
+
+    /// The reads of some pairs, each pair's reads adjacent, as in a local
+    /// assembly's frag_reads_orig.  Read ids are 2*pid and 2*pid+1.
+    static ReadSubset fromPairIds( vecbvec const& bases, VecPQVec const& quals,
+                                    vec<int64_t> const& pids )
+    { vec<int64_t> ids;
+      ids.reserve(2*pids.size());
+      for ( int64_t pid : pids )
+          ids.push_back(2*pid,2*pid+1);
+      return ReadSubset(bases,quals,std::move(ids)); }
+
+    size_t size() const { return mIds.size(); }
+    bool empty() const { return mIds.empty(); }
+
+    /// The global id of the idx'th read.
+    int64_t getId( size_t idx ) const { return mIds[idx]; }
+
+    bvec const& operator[]( size_t idx ) const
+    { return (*mpBases)[mIds[idx]]; }
+
+    const_iterator begin() const { return const_iterator(this,0); }
+    const_iterator end() const { return const_iterator(this,size()); }
+
+    void unpackQuals( size_t idx, qvec* pQV ) const
+    { (*mpQuals)[mIds[idx]].unpack(pQV); }
+
+    /// Copy the bases into a vecbvec, in a single pre-sized allocation.
+    void copyBases( vecbvec* pBases ) const
+    { pBases->assign(begin(),end()); }
+
+    /// Unpack the quals straight into a vecqvec.
+    void copyQuals( vecqvec* pQuals ) const
+    { pQuals->clear();
+      pQuals->resize(size());
+      for ( size_t idx = 0; idx != size(); ++idx )
+          unpackQuals(idx,&(*pQuals)[idx]); }
+
+private:
+    vecbvec const* mpBases;
+    VecPQVec const* mpQuals;
+    vec<int64_t> mIds;
+};
+
+#endif /* READSUBSET_H_ */
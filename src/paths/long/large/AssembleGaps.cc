@@ -21,6 +21,8 @@
 #include "paths/long/large/AssembleGaps.h"
 #include "paths/long/large/GapToyTools.h"
 #include "paths/long/large/Unsat.h"
+#include "reporting/StageProfiler.h"
+#include "system/MemBudget.h"
 #include "system/SortInPlace.h"
 
 template<int M> void MakeStartStop( const vecbasevector& bell, 
@@ -53,7 +55,8 @@ template <int M> struct MakeStartStopFunctor
 };
 
 void AssembleGaps2( HyperBasevector& hb, vec<int>& inv2, ReadPathVec& paths2, 
-     VecULongVec& paths2_index, vecbasevector& bases, VecPQVec const& quals,
+     const ReadPathIndex& paths2_index, vecbasevector& bases,
+     VecPQVec const& quals,
      const String& work_dir, const Bool EXTEND, const Bool ANNOUNCE, 
      const Bool KEEP_ALL_LOCAL, const Bool CONSERVATIVE_KEEP, const Bool INJECT, 
      const Bool LOCAL_LAYOUT, const String DUMP_LOCAL, int K2_FLOOR, 
@@ -65,7 +68,8 @@ void AssembleGaps2( HyperBasevector& hb, vec<int>& inv2, ReadPathVec& paths2,
      // Find clusters of unsatisfied links.
 
      vec< vec< pair<int,int> > > xs;
-     Unsat( hb, inv2, paths2, xs, work_dir, A2V );
+     {    StageProfile prof( "Unsat" );
+          Unsat( hb, inv2, paths2, xs, work_dir, A2V );    }
 
      // Condense to lists of lefts and rights.
 
@@ -105,15 +109,14 @@ void AssembleGaps2( HyperBasevector& hb, vec<int>& inv2, ReadPathVec& paths2,
 
      // Layout reads.  Expensive, temporary (?).
 
-     vec< vec<int> > layout_pos(nedges);
-     vec< vec<int64_t> > layout_id(nedges);
-     vec< vec<Bool> > layout_or(nedges);
-     LayoutReads( hb, inv2, bases, paths2, layout_pos, layout_id, layout_or );
+     read_layout layout;
+     {    StageProfile prof( "LayoutReads" );
+          LayoutReads( hb, inv2, bases, paths2, layout );    }
 
      // Extend terminal edges.
 
      if (EXTEND) 
-          ExtendTerminalEdges( hb, layout_pos, layout_id, layout_or, bases, quals );
+          ExtendTerminalEdges( hb, layout, bases, quals );
 
      // Make gap assemblies.
 
@@ -132,11 +135,69 @@ void AssembleGaps2( HyperBasevector& hb, vec<int>& inv2, ReadPathVec& paths2,
      int nblobs = LR.size( ), dots_printed = 0, nprocessed = 0;
      int lrc = LR.size( );
      if ( GAP_CAP >= 0 ) lrc = GAP_CAP;
-     #pragma omp parallel for schedule(dynamic, 1)
+
+     // Estimate the cost of each blob from its size and from the number of 
+     // reads placed on its root edges (which is high in repeats, where local 
+     // assemblies tend to be hard), and start the most expensive blobs first, 
+     // so that they don't straggle at the end while other threads sit idle.
+     //
+     // Estimate the memory of each blob from the same reads.  All their 
+     // placements are gathered and sorted, and then up to pair_sample pairs 
+     // are kept and assembled.  Each base of those is held several times over, 
+     // as bases, quals, corrected reads and kmers of the local graphs.  On a 
+     // tight memory budget, fewer blobs are run at once rather than risk being 
+     // killed.
+
+     const int pair_sample = 200;
+     const int64_t nbases = bases.sumSizes( );
+     const double mean_read_len 
+          = ( bases.empty( ) ? 0 : double(nbases) / bases.size( ) );
+     const size_t place_bytes 
+          = sizeof( quad<int64_t,Bool,int,int> ) + sizeof(int64_t);
+     const size_t base_bytes = 64;
+     vec< pair<int64_t,int> > order(lrc);
+     vec<size_t> blob_mem(lrc);
+     #pragma omp parallel for
      for ( int bl = 0; bl < lrc; bl++ )
+     {    int64_t nplaced = 0;
+          for ( int e : LR[bl].first ) nplaced += layout.Count(e);
+          for ( int e : LR[bl].second ) nplaced += layout.Count(e);
+          int64_t cost = nplaced 
+               * ( LR[bl].first.size( ) + LR[bl].second.size( ) );
+          order[bl] = make_pair( -cost, bl );
+          int64_t nkept = Min( nplaced, 2 * (int64_t) pair_sample );
+          blob_mem[bl] = nplaced * place_bytes 
+               + size_t( nkept * mean_read_len * base_bytes );    }
+     Sort(order);
+     MemGate gate( "AssembleGaps2" );
+
+     // Once every blob has been started, a blob can borrow the threads that 
+     // have run out of work, for the parallel loops inside local assembly.
+
+     const int nthreads = omp_get_max_threads( );
+     const int max_levels = omp_get_max_active_levels( );
+     omp_set_max_active_levels(2);
+     int nstarted = 0;
+     auto borrow_threads = [&]( )
+     {    int n = 1;
+          #pragma omp critical
+          {    int nrunning = nstarted - nprocessed;
+               if ( nstarted == lrc && nrunning > 0 ) 
+                    n = nthreads / nrunning;    }
+          n = Max( 1, n );
+          omp_set_num_threads(n);
+          return n;    };
+
+     #pragma omp parallel for schedule(dynamic, 1)
+     for ( int ob = 0; ob < lrc; ob++ )
      {    
           // Get ready.
 
+          const int bl = order[ob].second;
+          MemGate::Ticket ticket( gate, blob_mem[bl] );
+          #pragma omp critical
+          {    nstarted++;    }
+          StageProfile prof( "AssembleGaps2/blob", ToString(bl) );
           double aclock1 = WallClockTime( );
           const vec<int> &lefts = LR[bl].first, &rights = LR[bl].second;
           ostringstream mout;
@@ -159,17 +220,17 @@ void AssembleGaps2( HyperBasevector& hb, vec<int>& inv2, ReadPathVec& paths2,
           if ( A2V == 1 )
           {    const int max_delta = 120;
                for ( int l = 0; l < lefts.isize( ); l++ )
-               for ( int k = layout_pos[ lefts[l] ].isize( ) - 1; k >= 0; k-- )
-               {    int pos = layout_pos[ lefts[l] ][k]; 
-                    int64_t id = layout_id[ lefts[l] ][k];
+               for ( int64_t k = layout.Count( lefts[l] ) - 1; k >= 0; k-- )
+               {    int pos = layout.Place( lefts[l], k ).pos; 
+                    int64_t id = layout.Place( lefts[l], k ).id;
                     if ( pos + bases[id].isize( ) 
                          < hb.EdgeLengthBases( lefts[l] ) - max_delta ) 
                     {    break;    }
                     pids.push_back(id/2);    }
                for ( int l = 0; l < rights.isize( ); l++ )
-               for ( int k = 0; k < layout_pos[ rights[l] ].isize( ); k++ )
-               {    int pos = layout_pos[ rights[l] ][k]; 
-                    int64_t id = layout_id[ rights[l] ][k];
+               for ( int64_t k = 0; k < layout.Count( rights[l] ); k++ )
+               {    int pos = layout.Place( rights[l], k ).pos; 
+                    int64_t id = layout.Place( rights[l], k ).id;
                     if ( pos > max_delta ) break;
                     pids.push_back(id/2);    }    }
           */
@@ -178,7 +239,6 @@ void AssembleGaps2( HyperBasevector& hb, vec<int>& inv2, ReadPathVec& paths2,
           {
                // Heuristics.
 
-               const int pair_sample = 200;
 
                // First find the pairs that bridge from left to right, and mark
                // their endpoints.  Inefficient.
@@ -187,17 +247,15 @@ void AssembleGaps2( HyperBasevector& hb, vec<int>& inv2, ReadPathVec& paths2,
                vec<vec<int>> lstarts( lefts.size( ) ), rstarts( rights.size( ) );
                {    vec< quad<int64_t,Bool,int,int> > marks;
                     for ( int l = 0; l < lefts.isize( ); l++ )
-                    for ( int k = 0; k < layout_pos[ lefts[l] ].isize( ); k++ )
-                    {    if ( !layout_or[ lefts[l] ][k] ) continue;
-                         int pos = layout_pos[ lefts[l] ][k]; 
-                         int64_t id = layout_id[ lefts[l] ][k];
-                         marks.push( id/2, False, pos, l );    }
+                    for ( int64_t k = 0; k < layout.Count( lefts[l] ); k++ )
+                    {    const layout_place& x = layout.Place( lefts[l], k );
+                         if ( !x.fw ) continue;
+                         marks.push( x.id/2, False, x.pos, l );    }
                     for ( int l = 0; l < rights.isize( ); l++ )
-                    for ( int k = 0; k < layout_pos[ rights[l] ].isize( ); k++ )
-                    {    if ( layout_or[ rights[l] ][k] ) continue;
-                         int pos = layout_pos[ rights[l] ][k]; 
-                         int64_t id = layout_id[ rights[l] ][k];
-                         marks.push( id/2, True, pos, l );    }
+                    for ( int64_t k = 0; k < layout.Count( rights[l] ); k++ )
+                    {    const layout_place& x = layout.Place( rights[l], k );
+                         if ( x.fw ) continue;
+                         marks.push( x.id/2, True, x.pos, l );    }
                     Sort(marks);
                     for ( int l = 0; l < marks.isize( ); l++ )
                     {    int m;
@@ -227,10 +285,11 @@ void AssembleGaps2( HyperBasevector& hb, vec<int>& inv2, ReadPathVec& paths2,
 
                vec<int64_t> pids2;
                for ( int l = 0; l < lefts.isize( ); l++ )
-               for ( int k = 0; k < layout_pos[ lefts[l] ].isize( ); k++ )
-               {    int pos = layout_pos[ lefts[l] ][k]; 
-                    int64_t id = layout_id[ lefts[l] ][k];
-                    Bool fw = layout_or[ lefts[l] ][k];
+               for ( int64_t k = 0; k < layout.Count( lefts[l] ); k++ )
+               {    const layout_place& x = layout.Place( lefts[l], k );
+                    int pos = x.pos;
+                    int64_t id = x.id;
+                    Bool fw = x.fw;
                     if ( BinMember( pids1, id/2 ) ) continue;
                     /*
                     if ( lstarts[l].empty( ) ) // XXXXXXXXXXXXXXXXXXXXXXXXXXXXX
@@ -254,10 +313,11 @@ void AssembleGaps2( HyperBasevector& hb, vec<int>& inv2, ReadPathVec& paths2,
                               {    close = True;    }    }    }
                     if (close) pids2.push_back(id/2);    }
                for ( int l = 0; l < rights.isize( ); l++ )
-               for ( int k = 0; k < layout_pos[ rights[l] ].isize( ); k++ )
-               {    int pos = layout_pos[ rights[l] ][k]; 
-                    int64_t id = layout_id[ rights[l] ][k];
-                    Bool fw = layout_or[ rights[l] ][k];
+               for ( int64_t k = 0; k < layout.Count( rights[l] ); k++ )
+               {    const layout_place& x = layout.Place( rights[l], k );
+                    int pos = x.pos;
+                    int64_t id = x.id;
+                    Bool fw = x.fw;
                     if ( BinMember( pids1, id/2 ) ) continue;
                     /*
                     if ( rstarts[l].empty( ) ) // XXXXXXXXXXXXXXXXXXXXXXXXXXXXX
@@ -332,9 +392,10 @@ void AssembleGaps2( HyperBasevector& hb, vec<int>& inv2, ReadPathVec& paths2,
 
           int lroot = lefts[0], rroot = rights[0];
 
+          int nthreads_local = borrow_threads( );
           MakeLocalAssembly1( lroot, rroot, hb, bases, quals, pids, TMP, mout,
                LOCAL_LAYOUT, K2_FLOOR_LOCAL, work_dir, corrected, creads, cpartner, 
-               cid, tmp_mgr );
+               cid, tmp_mgr, nthreads_local );
 
           if (ANNOUNCE)
           {   
@@ -344,6 +405,7 @@ void AssembleGaps2( HyperBasevector& hb, vec<int>& inv2, ReadPathVec& paths2,
                          << endl;    }    }
 
           retry:
+          borrow_threads( );
           MakeLocalAssembly2( corrected, hb, lefts, rights, mout, shb, INJECT, 
                K2_FLOOR_LOCAL, creads, tmp_mgr, cid, cpartner );
 
@@ -538,6 +600,7 @@ void AssembleGaps2( HyperBasevector& hb, vec<int>& inv2, ReadPathVec& paths2,
      
           mreport[bl] += mout.str( );    
           Dot( nblobs, nprocessed, dots_printed, ANNOUNCE, bl );    }
+     omp_set_max_active_levels(max_levels);
 
      cout << TimeSince(clockp1) << " spent in local assemblies, "
           << "memory in use = " << MemUsageGBString( )
@@ -14,10 +14,12 @@
 #include "feudal/PQVec.h"
 #include "paths/HyperBasevector.h"
 #include "paths/long/ReadPath.h"
+#include "paths/long/ReadPathIndex.h"
 #include "paths/long/large/GapToyTools.h"
 
 void AssembleGaps2( HyperBasevector& hb, vec<int>& inv2, ReadPathVec& paths2, 
-     VecULongVec& paths2_index, vecbasevector& bases, VecPQVec const& quals,
+     const ReadPathIndex& paths2_index, vecbasevector& bases,
+     VecPQVec const& quals,
      const String& work_dir, const Bool EXTEND, 
      const Bool ANNOUNCE, const Bool KEEP_ALL_LOCAL, 
      const Bool CONSERVATIVE_KEEP, const Bool INJECT, 
@@ -14,6 +14,7 @@
 #include "Qualvector.h"
 #include "paths/HyperBasevector.h"
 #include "paths/long/ReadPath.h"
+#include "paths/long/ReadPathIndex.h"
 #include "paths/long/large/Clean200.h"
 #include "paths/long/large/GapToyTools.h"
 
@@ -42,8 +43,7 @@ void Clean200( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
      vec<int> to_right;
      hb.ToRight(to_right);
      HyperBasevectorX hbx(hb);
-     VecULongVec paths_index;
-     invert( paths, paths_index, hb.EdgeObjectCount( ) );
+     ReadPathIndex paths_index( paths, hb.EdgeObjectCount( ) );
 
      // Look for weak branches.
 
@@ -224,8 +224,7 @@ void Clean200x( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
      vec<int> to_right;
      hb.ToRight(to_right);
      HyperBasevectorX hbx(hb);
-     VecULongVec paths_index;
-     invert( paths, paths_index, hb.EdgeObjectCount( ) );
+     ReadPathIndex paths_index( paths, hb.EdgeObjectCount( ) );
 
      // Look for weak branches.
 
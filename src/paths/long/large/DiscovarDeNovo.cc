@@ -32,12 +32,15 @@ int main(int argc, char *argv[])
           "use reference sequence REFHEAD.fasta to annotate assembly, and also "
           "REFHEAD.names if it exists");
      CommandArgument_Double_OrDefault_Doc(MAX_MEM_GB, 0,
-          "if specified, maximum allowed RAM use in GB; in some cases may be "
-          "exceeded by our code");
+          "if specified, maximum allowed RAM use in GB; memory-hungry stages "
+          "throttle their parallelism to stay within it; never more than the "
+          "physical memory or any cgroup (container or queue) limit");
      CommandArgument_Bool_OrDefault_Doc(MEMORY_CHECK, False,
-          "if True, attempt to determine actual available memory and cap "
-          "memory usage accordingly; slow and can cause machine to become "
-          "very sluggish, or can result in process being killed");
+          "if True, also cap memory usage at the memory currently free on the "
+          "machine; useful on shared nodes");
+     CommandArgument_Bool_OrDefault_Doc(RESUME, False,
+          "restart an interrupted run from the last completed stage recorded "
+          "in OUT_DIR/stages");
      EndCommandArguments;
 
      GapToyCore(argc,argv);
@@ -13,6 +13,7 @@
 #include "Bitvector.h"
 #include "CoreTools.h"
 #include "FastIfstream.h"
+#include "FastqReader.h"
 #include "FetchReads.h"
 #include "PairsManager.h"
 #include "ParseSet.h"
@@ -26,6 +27,7 @@
 #include "paths/long/large/ExtractReads.h"
 #include "paths/long/large/ReadNameLookup.h"
 #include "random/Shuffle.h"
+#include "reporting/StageProfiler.h"
 
 class rs_meta { // read set meta info
      public:
@@ -48,7 +50,8 @@ void ExtractReads( const String& sample, const String& species, String reads,
      String& SELECT_FRAC, const int READS_TO_USE, const vec<String>& regions, 
      const String& tmp_dir1, const String& work_dir, const Bool all, 
      const Bool USE_PF_ONLY, const Bool KEEP_NAMES, vec<String>& subsam_names, 
-     vec<int64_t>& subsam_starts, vecbvec* pReads, ObjectManager<VecPQVec>& quals )
+     vec<int64_t>& subsam_starts, vecbvec* pReads, ObjectManager<VecPQVec>& quals,
+     ReadKmerCensus* pCensus )
 {
      double lclock = WallClockTime( );
 
@@ -236,10 +239,9 @@ void ExtractReads( const String& sample, const String& species, String reads,
                     for ( auto s : suf )
                          if ( fn.Contains( s, -1 ) ) fq = True;
                     if ( !fq ) continue;
-                    String command = "cat " + fn + " | head -1";
-                    if ( fn.Contains( ".gz", -1 ) ) command = "z" + command;
-                    fast_pipe_ifstream in(command);
-                    getline( in, line );
+                    FastqReader in(fn);
+                    if ( in.nextBatch(1) == 0 ) line = "";
+                    else line = "@" + in[0].name( );
                     if ( !line.Contains( "@", 0 ) || line.size( ) == 1
                          || ( line[1] == ' ' || line[1] == '/' ) )
                     {    cout << "\nSomething is wrong with the first line of your "
@@ -318,6 +320,7 @@ void ExtractReads( const String& sample, const String& species, String reads,
                     subsam_starts[g] = xbases.size( );
                for ( int j = 0; j < infiles[g].isize( ); j++ )
                {    String fn = infiles[g][j];
+                    StageProfile prof( "readFile", fn );
                     int64_t N0 = xbases.size( );
                
                     // Parse bam files.
@@ -328,7 +331,10 @@ void ExtractReads( const String& sample, const String& species, String reads,
                          BAMReader bamReader( USE_PF_ONLY, UNIQUIFY_NAMES,
                               infiles_meta[g].frac, long(READS_TO_USE) );
                               bamReader.readBAM( 
-                                   fn, &xbases, &xquals, pxnames );    }
+                                   fn, &xbases, &xquals, pxnames );
+                         if ( pCensus != 0 )
+                         {    pCensus->addReads( xbases, xquals, 
+                                   N0, xbases.size( ) );    }    }
 
                     // Parse fastb/qualb/qualp files.
 
@@ -366,7 +372,10 @@ void ExtractReads( const String& sample, const String& species, String reads,
                                    {    xbases[pos] = xbases[i];
                                         xquals[pos] = xquals[i];    }
                                    pos++;    }
-                              xbases.resize(pos), xquals.resize(pos);    }    }
+                              xbases.resize(pos), xquals.resize(pos);    }
+                         if ( pCensus != 0 )
+                         {    pCensus->addReads( xbases, xquals, 
+                                   N0, xbases.size( ) );    }    }
 
                     // Parse paired fastq files.
 
@@ -375,99 +384,65 @@ void ExtractReads( const String& sample, const String& species, String reads,
                          && infiles_rn[g][j] == infiles_rn[g][j+1] )
                     {    infiles_pairs[g].push( j, j+1 );
                          const String &fn1 = infiles[g][j], &fn2 = infiles[g][j+1];
-                         String command1 = "cat " + fn1, command2 = "cat " + fn2;
-                         if ( fn1.Contains( ".gz", -1 ) ) command1 = "z" + command1;
-                         if ( fn2.Contains( ".gz", -1 ) ) command2 = "z" + command2;
-                         fast_pipe_ifstream in1(command1), in2(command2);
-                         String line1, line2;
+                         FastqReader in1(fn1), in2(fn2);
                          int64_t total = 0, taken = 0;
                          double frac = infiles_meta[g].frac;
 
                          // Buffer for quality score compression in batches.
                          
-                         const int qbmax = 10000000;
+                         const int batch = 1000000;
                          vec<qvec> qualsbuf;
                          MempoolOwner<char> alloc;
-                         for ( int i = 0; i < qbmax; i++ )
+                         for ( int i = 0; i < 2*batch; i++ )
                               qualsbuf.emplace_back(alloc);
-                         int qbcount = 0;
 
-                         // Go through the input files.
+                         // Go through the input files, a batch of records at a 
+                         // time.  Records are selected serially, then encoded 
+                         // in parallel.
 
-                         basevector b1, b2;
+                         vec<int> keep;
                          while(1)
-                         {    getline(in1,line1), getline(in2,line2);
-                              if ( in1.fail( ) && in2.fail( ) ) break;
-                              if ( ( in1.fail( ) && !in2.fail( ) )
-                                   || ( in2.fail( ) && !in1.fail( ) ) )
+                         {    size_t n1 = in1.nextBatch(batch);
+                              size_t n2 = in2.nextBatch(batch);
+                              if ( n1 != n2 )
                               {    cout << "\nThe files " << fn1 << " and " << fn2 
                                         << " appear to be paired, yet have "
                                         << "different numbers of records.\n" << endl;
                                    Scram(1);    }
-     
-                              // Fetch bases.  Turn Ns into As.
-     
-                              getline( in1, line1 ), getline( in2, line2 );
-                              if ( in1.fail( ) || in2.fail( ) )
-                              {    cout << "\nSee incomplete record in " << fn1
-                                        << " or " << fn2 << ".\n" << endl;
-                                   Scram(1);    }
-                              for ( int i = 0; i < line1.isize( ); i++ )
-                                   if ( line1[i] == 'N' ) line1[i] = 'A';
-                              for ( int i = 0; i < line2.isize( ); i++ )
-                                   if ( line2[i] == 'N' ) line2[i] = 'A';
-                              b1.SetFromString(line1);
-                              b2.SetFromString(line2);
-     
-                              // Skip line.
-
-                              getline( in1, line1 ), getline( in2, line2 );
-                              if ( in1.fail( ) || in2.fail( ) )
-                              {    cout << "\nSee incomplete record in " << fn1
-                                        << " or " << fn2 << ".\n" << endl;
-                                   Scram(1);    }
-     
-                              // Fetch quals.
-     
-                              getline( in1, line1 ), getline( in2, line2 );
-                              if ( in1.fail( ) || in2.fail( ) )
-                              {    cout << "\nSee incomplete record in " << fn1
-                                        << " or " << fn2 << ".\n" << endl;
-                                   Scram(1);    }
-                              if ( b1.size( ) != line1.size( ) 
-                                   || b2.size( ) != line2.size( ) )
-                              {    cout << "\n1: " << b1.size( ) << " bases "
-                                        << ", " << line1.size( ) << " quals" << endl;
-                                   cout << "2: " << b2.size( ) << " bases "
-                                        << ", " << line2.size( ) << " quals" << endl;
-                                   cout << "See inconsistent base/quality lengths "
-                                        << "in " << fn1 << " or " << fn2 << endl;
-                                   Scram(1);    }
+                              if ( n1 == 0 ) break;
 
                               // Check frac.
 
-                              if ( frac < 1 )
-                              {    total++;
-                                   if ( double(taken)/double(total) > frac ) 
-                                        continue;
-                                   taken++;    }
-
-                              // Save.
-
-                              qvec& q1 = qualsbuf[qbcount++];
-                              qvec& q2 = qualsbuf[qbcount++];
-                              q1.resize( line1.size( ) ), q2.resize( line2.size( ) );
-                              if ( qbcount == qbmax )
-                              {    convertAppendParallel( qualsbuf.begin( ), 
-                                        qualsbuf.begin( ) + qbcount, xquals );
-                                   qbcount = 0;     }
-                              for ( int i = 0; i < line1.isize( ); i++ )
-                                   q1[i] = line1[i] - 33;
-                              for ( int i = 0; i < line2.isize( ); i++ )
-                                   q2[i] = line2[i] - 33;
-                              xbases.push_back(b1), xbases.push_back(b2);    }
-                         convertAppendParallel( qualsbuf.begin( ), 
-                              qualsbuf.begin( ) + qbcount, xquals );
+                              keep.clear( );
+                              for ( int i = 0; i < (int) n1; i++ )
+                              {    if ( frac < 1 )
+                                   {    total++;
+                                        if ( double(taken)/double(total) > frac ) 
+                                             continue;
+                                        taken++;    }
+                                   keep.push_back(i);    }
+
+                              // Save, taking the kmer census while the quals
+                              // are still unpacked.
+
+                              const int64_t N0 = xbases.size( );
+                              xbases.resize( N0 + 2 * keep.size( ) );
+                              if ( pCensus != 0 ) pCensus->reserve( xbases.size( ) );
+                              parallelFor( 0, keep.isize( ),
+                                   [&]( int i )
+                                   {    in1[ keep[i] ].encode( 
+                                             xbases[ N0 + 2*i ], qualsbuf[2*i] );
+                                        in2[ keep[i] ].encode( 
+                                             xbases[ N0 + 2*i + 1 ], 
+                                             qualsbuf[ 2*i + 1 ] );
+                                        if ( pCensus == 0 ) return;
+                                        for ( int k = 0; k < 2; k++ )
+                                        {    pCensus->addRead( N0 + 2*i + k, 
+                                                  xbases[ N0 + 2*i + k ], 
+                                                  qualsbuf[ 2*i + k ] );    }    } );
+                              convertAppendParallel( qualsbuf.begin( ), 
+                                   qualsbuf.begin( ) + 2 * keep.size( ), 
+                                   xquals );    }
                          j++;    }
                
                     // Parse unpaired fastq files.
@@ -475,69 +450,45 @@ void ExtractReads( const String& sample, const String& species, String reads,
                     else if ( infiles_rn[g][j] != "" )
                     {    vecqualvector Q;
                          const String& fn = infiles[g][j];
-                         String command = "cat " + fn;
-                         if ( fn.Contains( ".gz", -1 ) ) command = "z" + command;
-                         fast_pipe_ifstream in(command);
+                         FastqReader in(fn);
                          int64_t total = 0, taken = 0;
                          double frac = infiles_meta[g].frac;
                          Bool skip_next = False;
-                         while(1)
-                         {    getline( in, line );
-                              if ( in.fail( ) ) break;
-          
-                              // Fetch bases.  Turn Ns into As.
-          
-                              getline( in, line );
-                              if ( in.fail( ) )
-                              {    cout << "\nSee incomplete record in " << fn 
-                                        << ".\n" << endl;
-                                   Scram(1);    }
-                              for ( int i = 0; i < line.isize( ); i++ )
-                                   if ( line[i] == 'N' ) line[i] = 'A';
-                              basevector b(line);
-     
-                              // Skip line.
-          
-                              getline( in, line );
-                              if ( in.fail( ) )
-                              {    cout << "\nSee incomplete record in " << fn 
-                                        << ".\n" << endl;
-                                   Scram(1);    }
-     
-                              // Fetch quals.
-     
-                              getline( in, line );
-                              if ( in.fail( ) )
-                              {    cout << "\nSee incomplete record in " << fn 
-                                        << ".\n" << endl;
-                                   Scram(1);    }
-                              if ( b.size( ) != line.size( ) )
-                              {    cout << "\nSee " << b.size( ) << " bases "
-                                        << ", " << line.size( ) << " quals" << endl;
-                                   cout << "See inconsistent base/quality lengths "
-                                        << "in " << fn << ".\n" << endl;
-                                   Scram(1);    }
-
+                         const int batch = 1000000;
+                         vec<int> keep;
+                         while ( size_t n = in.nextBatch(batch) )
+                         {    
                               // Check frac.
 
-                              if ( frac < 1 )
-                              {    total++;
-                                   if (skip_next)
-                                   {    skip_next = False;
-                                        continue;    }
-                                   if ( total % 2 == 1 
-                                        && double(taken)/double(total) > frac ) 
-                                   {    skip_next = True;
-                                        continue;    }
-                                   taken++;    }
-
-                              // Save.
-
-                              qualvector q( line.size( ) );
-                              for ( int i = 0; i < line.isize( ); i++ )
-                                   q[i] = line[i] - 33;
-                              xbases.push_back(b);
-                              Q.push_back(q);    }
+                              keep.clear( );
+                              for ( int i = 0; i < (int) n; i++ )
+                              {    if ( frac < 1 )
+                                   {    total++;
+                                        if (skip_next)
+                                        {    skip_next = False;
+                                             continue;    }
+                                        if ( total % 2 == 1 
+                                             && double(taken)/double(total) > frac ) 
+                                        {    skip_next = True;
+                                             continue;    }
+                                        taken++;    }
+                                   keep.push_back(i);    }
+
+                              // Save, taking the kmer census while the quals
+                              // are still unpacked.
+
+                              const int64_t N0 = xbases.size( ), Q0 = Q.size( );
+                              xbases.resize( N0 + keep.size( ) );
+                              Q.resize( Q0 + keep.size( ) );
+                              if ( pCensus != 0 ) pCensus->reserve( xbases.size( ) );
+                              parallelFor( 0, keep.isize( ),
+                                   [&]( int i )
+                                   {    in[ keep[i] ].encode( 
+                                             xbases[ N0 + i ], Q[ Q0 + i ] );
+                                        if ( pCensus != 0 )
+                                        {    pCensus->addRead( N0 + i, 
+                                                  xbases[ N0 + i ], 
+                                                  Q[ Q0 + i ] );    }    } );    }
      
                          // Check sanity and compress.
 
@@ -623,6 +574,7 @@ void ExtractReads( const String& sample, const String& species, String reads,
 
           // Save files.
      
+          StageProfile prof( "write" );
           xbases.WriteAll( work_dir + "/data/frag_reads_orig.fastb" );
           quals.store( );
           if ( xnames.size( ) > 0 )
@@ -772,22 +724,12 @@ void ExtractReads( const String& sample, const String& species, String reads,
           String diri = work_dir + "/data/" + ToString(i);
           Mkdir777(diri);
           for ( int z = 0; z < bams.isize( ); z++ )
-          {    String getsam = "samtools view -h " + bams[z] + " " + reg;
-               SamIAm( z, getsam, diri, false, "", USE_PF_ONLY );
-               PairsManager pairs( diri + "/" + ToString(z) + ".pairs" );
-               int64_t N = bases.size( ), n;
-               {    vecqualvector qualsi( diri + "/" + ToString(z) + ".qualb" );
-                    n = pairs.nPairs( ) * 2;
-                    quals.resize( N + n );
-                    for ( int64_t pid = 0; pid < (int64_t) pairs.nPairs( ); pid++ )
-                    {    quals[N + 2*pid] = qualsi[ pairs.ID1(pid) ];
-                         quals[N + 2*pid+1] 
-                              = qualsi[ pairs.ID2(pid) ];    }    }
-               vecbasevector basesi( diri + "/" + ToString(z) + ".fastb" );
-               bases.resize( N + n );
-               for ( int64_t pid = 0; pid < (int64_t) pairs.nPairs( ); pid++ )
-               {    bases[N + 2*pid] = basesi[ pairs.ID1(pid) ];
-                    bases[N + 2*pid+1] = basesi[ pairs.ID2(pid) ];     }    }
+          {    BAMReader bamReader(USE_PF_ONLY);
+               VecPQVec qualsz;
+               bamReader.readBAMRegion( bams[z], reg, &bases, &qualsz );
+               for ( size_t id = 0; id < qualsz.size( ); id++ )
+               {    quals.push_back( qualvector( ) );
+                    qualsz[id].unpack( &quals.back( ) );    }    }
           bases.WriteAll( diri + "/frag_reads_orig.fastb" );
           quals.WriteAll( diri + "/frag_reads_orig.qualb" );
           int id;
@@ -12,11 +12,13 @@
 #include "Basevector.h"
 #include "CoreTools.h"
 #include "feudal/PQVec.h"
+#include "paths/long/BuildReadQGraph.h"
 
 void ExtractReads( const String& sample, const String& species, String reads,
      String& SELECT_FRAC, const int READS_TO_USE, const vec<String>& regions, 
      const String& tmp_dir1, const String& work_dir, const Bool all, 
      const Bool USE_PF_ONLY, const Bool KEEP_NAMES, vec<String>& subsam_names, 
-     vec<int64_t>& subsam_starts, vecbvec* pReads, ObjectManager<VecPQVec>& quals );
+     vec<int64_t>& subsam_starts, vecbvec* pReads, ObjectManager<VecPQVec>& quals,
+     ReadKmerCensus* pCensus = 0 );
 
 #endif
@@ -12,9 +12,11 @@
 #include "math/Functions.h"
 #include "paths/HyperBasevector.h"
 #include "paths/long/ReadPath.h"
+#include "paths/long/ReadPathIndex.h"
 #include "paths/long/large/DiscoStats.h"
 #include "paths/long/large/FinalFiles.h"
 #include "paths/long/large/GapToyTools.h"
+#include "paths/long/large/GenomeKmerIndex.h"
 #include "paths/long/large/Lines.h"
 #include "random/Random.h"
 
@@ -42,13 +44,15 @@ void FinalFiles( const HyperBasevector& hb, const vec<int>& inv, const
      vec< vec< pair<int,int> > > hitsx;
      if ( ALIGN_TO_GENOME && IsRegularFile( work_dir + "/genome.fastb" ) )
      {    vecbasevector genome( work_dir + "/genome.fastb" );
-          AlignToGenome( hb, inv, genome, hitsx );
+          genome_kmer_index gix( genome, work_dir + "/genome.fastb" );
+          AlignToGenome( hb, inv, gix, hitsx );
           BinaryWriter::writeFile( final_dir + "/a.aligns", hitsx );    }
      else Remove( final_dir + "/a.aligns" );
      if ( ALIGN_TO_GENOME && IsRegularFile( work_dir + "/genome.fastb_alt" ) )
      {    vec< vec< pair<int,int> > > hitsx_alt;
           vecbasevector genome( work_dir + "/genome.fastb_alt" );
-          AlignToGenome( hb, inv, genome, hitsx_alt );
+          genome_kmer_index gix( genome, work_dir + "/genome.fastb_alt" );
+          AlignToGenome( hb, inv, gix, hitsx_alt );
           BinaryWriter::writeFile( final_dir + "/a.aligns_alt", hitsx_alt );    }
      else Remove( final_dir + "/a.aligns_alt" );
 
@@ -59,7 +63,7 @@ void FinalFiles( const HyperBasevector& hb, const vec<int>& inv, const
      //      << ToStringAddCommas( MemUsageBytes( ) ) << endl;
      FindLines( hb, inv, linesx, MAX_CELL_PATHS, MAX_DEPTH );
      SortLines( linesx, hb, inv );
-     BinaryWriter::writeFile( final_dir + "/a.lines", linesx );
+     line_store(linesx).Write( final_dir + "/a.lines" );
      DumpLineFiles( linesx, hb, inv, paths, final_dir );
      {    vec<vec<covcount>> covsx;
           {    ComputeCoverage( hb, inv, paths, linesx, subsam_starts, covsx );
@@ -84,9 +88,8 @@ void FinalFiles( const HyperBasevector& hb, const vec<int>& inv, const
                     afinal.push_back( hb.EdgeObject(e) );
                afinal.WriteAll( final_dir + "/a.fastb" );
                paths.WriteAll( final_dir + "/a.paths" );
-               VecULongVec invPaths;
-               invert( paths, invPaths, hb.E( ) );
-               invPaths.WriteAll( final_dir + "/a.paths.inv" );    }
+               ReadPathIndex( paths, hb.E( ) )
+                    .WriteAll( final_dir + "/a.paths.inv" );    }
 
           // Build genome map.
 
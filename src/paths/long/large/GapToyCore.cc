@@ -41,8 +41,10 @@
 #include "paths/RemodelGapTools.h"
 #include "paths/UnibaseUtils.h"
 #include "paths/long/BuildReadQGraph.h"
+#include "paths/long/PackedReadPathVec.h"
 #include "paths/long/PlaceReads0.h"
 #include "paths/long/ReadPath.h"
+#include "paths/long/ReadPathIndex.h"
 #include "paths/long/SupportedHyperBasevector.h"
 #include "paths/long/large/AssembleGaps.h"
 #include "paths/long/large/Clean200.h"
@@ -51,6 +53,7 @@
 #include "paths/long/large/FinalFiles.h"
 #include "paths/long/large/GapToyCore.h"
 #include "paths/long/large/GapToyTools.h"
+#include "paths/long/large/GenomeKmerIndex.h"
 #include "paths/long/large/ImprovePath.h"
 #include "paths/long/large/Improve60.h"
 #include "paths/long/large/Lines.h"
@@ -59,6 +62,8 @@
 #include "paths/long/large/Repath.h"
 #include "paths/long/large/Samples.h"
 #include "paths/long/large/Simplify.h"
+#include "paths/long/large/StageManifest.h"
+#include "reporting/StageProfiler.h"
 #include "system/HostName.h"
 
 int GapToyCore( int argc, char *argv[] )
@@ -80,12 +85,12 @@ int GapToyCore( int argc, char *argv[] )
           "use reference sequence REFHEAD.fasta to annotate assembly, and also "
           "REFHEAD.names if it exists");
      CommandArgument_Double_OrDefault_Doc(MAX_MEM_GB, 0,
-          "if specified, maximum allowed RAM use in GB; in some cases may be "
-          "exceeded by our code");
+          "if specified, maximum allowed RAM use in GB; memory-hungry stages "
+          "throttle their parallelism to stay within it; never more than the "
+          "physical memory or any cgroup (container or queue) limit");
      CommandArgument_Bool_OrDefault_Doc(MEMORY_CHECK, False,
-          "if True, attempt to determine actual available memory and cap "
-          "memory usage accordingly; slow and can cause machine to become "
-          "very sluggish, or can result in process being killed");
+          "if True, also cap memory usage at the memory currently free on the "
+          "machine; useful on shared nodes");
 
      // OTHER KEY OPTIONS
 
@@ -134,6 +139,16 @@ int GapToyCore( int argc, char *argv[] )
           "start with a.final assembly");
      CommandArgument_Bool_OrDefault_Doc(PERFSTATS, False,
           "record performance statistics");
+     CommandArgument_Bool_OrDefault_Doc(PROFILE, True,
+          "record time, memory and i/o used by each stage in "
+          "OUT_DIR/profile.tsv and OUT_DIR/profile.json");
+     CommandArgument_Bool_OrDefault_Doc(RESUME, False,
+          "restart from the last completed stage recorded in OUT_DIR/stages; "
+          "this overrides CACHE, START_LOADED, START_WITH_PATCHES, "
+          "START_PATCHED and START_FIN");
+     CommandArgument_Bool_OrDefault_Doc(CHECKPOINT, True,
+          "record completed stages in OUT_DIR/stages, and save the patched "
+          "assembly, so that an interrupted run can be restarted with RESUME");
 
      // CONTROL OVER WHAT IS CREATED/KEPT
 
@@ -212,6 +227,9 @@ int GapToyCore( int argc, char *argv[] )
      CommandArgument_Bool_OrDefault_Doc(EXTEND, False, "extend terminal edges");
      CommandArgument_Int_OrDefault_Doc(MIN_FREQ, 3, "passed to ReadQGrapher");
      CommandArgument_Int_OrDefault_Doc(MIN_QUAL, 7, "passed to ReadQGrapher");
+     CommandArgument_Bool_OrDefault_Doc(STREAM_KMERS, True,
+          "take the kmer census needed by ReadQGrapher while reads are being "
+          "extracted, rather than in separate passes afterwards");
      CommandArgument_Bool_OrDefault_Doc(LOCAL_LAYOUT, False, 
           "lay out reads in local assembly, not functional yet");
      CommandArgument_Bool_OrDefault_Doc(CONSERVATIVE_KEEP, False, "use more "
@@ -309,6 +327,7 @@ int GapToyCore( int argc, char *argv[] )
      if ( OUT_DIR != "" ) work_dir = OUT_DIR;
      Mkpath(work_dir);
      if ( PERFSTATS ) PerfStatLogger::init(work_dir);
+     if ( PROFILE ) StageProfiler::init(work_dir);
 
      // Set computational limits, etc.
 
@@ -328,6 +347,30 @@ int GapToyCore( int argc, char *argv[] )
 
      ForceAssertLe(JOIN_PATHS,3u);
 
+     // Implement RESUME, and otherwise start a new stage manifest if we're
+     // starting from scratch.
+
+     stage_manifest manifest(work_dir);
+     if (RESUME)
+     {    int last = manifest.LastValid( );
+          cout << Date( ) << ": last completed stage is "
+               << stage_manifest::Name(last) << endl;
+          if ( last == stage_manifest::DONE )
+          {    cout << "\nThis run has already completed.  To rerun it, "
+                    << "please omit RESUME=True.\n" << endl;
+               Scram(0);    }
+          CACHE = START_LOADED = START_WITH_PATCHES = False;
+          START_PATCHED = START_FIN = False;
+          if ( last == stage_manifest::FIN ) START_FIN = True;
+          else if ( last == stage_manifest::PATCHED ) START_PATCHED = True;
+          else if ( last == stage_manifest::PATCHES ) START_WITH_PATCHES = True;
+          else if ( last == stage_manifest::BUILT200 ) CACHE = True;
+          else if ( last == stage_manifest::LOADED ) START_LOADED = True;    }
+     if ( !CACHE && !START_WITH_PATCHES && !START_PATCHED && !START_FIN 
+          && !START_FINAL && !EVALUATE_ONLY && !ALIGN_ONLY && !SCAFFOLD_ONLY
+          && !START_LOADED )
+     {    manifest.Clear( );    }
+
      // Parse DUMP_LOCAL.
 
      int DUMP_LOCAL_LROOT=-1, DUMP_LOCAL_RROOT=-1;      // -1 can't match edge
@@ -420,7 +463,10 @@ int GapToyCore( int argc, char *argv[] )
           && !START_FINAL && !EVALUATE_ONLY && !ALIGN_ONLY && !SCAFFOLD_ONLY
           && REFHEAD == "" && !START_LOADED )
      {    Remove( work_dir + "/genome.fastb" );
-          Remove( work_dir + "/genome.fastb_alt" );    }
+          Remove( work_dir + "/genome.fastb_alt" );
+          Remove( genome_kmer_index::IndexFile( work_dir + "/genome.fastb" ) );
+          Remove( genome_kmer_index::IndexFile( 
+               work_dir + "/genome.fastb_alt" ) );    }
 
      // Output README.
 
@@ -441,7 +487,7 @@ int GapToyCore( int argc, char *argv[] )
           BinaryReader::readFile( fin_dir + "/a.inv", &inv2 );
           ReadPathVec paths2( fin_dir + "/a.paths" );
           VecULongVec invPaths;
-          invert( paths2, invPaths, hbx.EdgeObjectCount( ) );
+          ReadPathIndex( paths2, hbx.EdgeObjectCount( ) ).unpack( &invPaths );
           MakeGaps( hbx, inv2, paths2, invPaths, MIN_LINE, MIN_LINK_COUNT,
                work_dir, "fin" + FIN, SCAFFOLD_VERBOSE, GAP_CLEANUP );
           BinaryWriter::writeFile( final_dir + "/a.hbv", hbx );
@@ -516,7 +562,8 @@ int GapToyCore( int argc, char *argv[] )
           BinaryReader::readFile( fin_dir + "/a.inv", &inv2 );
           vec< vec< pair<int,int> > > hits, hits_alt;
           vecbasevector genome( work_dir + "/genome.fastb" );
-          AlignToGenome( hb, inv2, genome, hits );
+          genome_kmer_index gix( genome, work_dir + "/genome.fastb" );
+          AlignToGenome( hb, inv2, gix, hits );
           BinaryWriter::writeFile( fin_dir + "/a.aligns", hits );
           vecbasevector genome_alt;
           if ( IsRegularFile( work_dir + "/genome.fastb_alt" ) )
@@ -525,10 +572,12 @@ int GapToyCore( int argc, char *argv[] )
           BinaryReader::readFile( final_dir + "/a.hbv", &hbx );
           BinaryReader::readFile( final_dir + "/a.inv", &inv2 );
           vec< vec< pair<int,int> > > hitsx, hitsx_alt;
-          AlignToGenome( hbx, inv2, genome, hitsx );
+          AlignToGenome( hbx, inv2, gix, hitsx );
           BinaryWriter::writeFile( final_dir + "/a.aligns", hitsx );
           if ( genome_alt.size( ) > 0 )
-          {    AlignToGenome( hbx, inv2, genome_alt, hitsx_alt );
+          {    genome_kmer_index gix_alt( 
+                    genome_alt, work_dir + "/genome.fastb_alt" );
+               AlignToGenome( hbx, inv2, gix_alt, hitsx_alt );
                BinaryWriter::writeFile( 
                     final_dir + "/a.aligns_alt", hitsx_alt );    }
           Scram(0);    }
@@ -537,12 +586,15 @@ int GapToyCore( int argc, char *argv[] )
 
      vecbvec bases;
      ObjectManager<VecPQVec> quals(tmp_dir1 + "/frag_reads_orig.qualp");
+     ReadKmerCensus census( MIN_QUAL, MIN_FREQ );
+     ReadKmerCensus* pCensus = ( STREAM_KMERS ? &census : 0 );
      if ( !CACHE && !START_WITH_PATCHES && !START_PATCHED && !START_FIN )
      {    
           if ( !START_LOADED )
-          {    ExtractReads( SAMPLE, species, READS, SELECT_FRAC, READS_TO_USE, 
+          {    StageProfile prof( "ExtractReads" );
+               ExtractReads( SAMPLE, species, READS, SELECT_FRAC, READS_TO_USE, 
                     regions, tmp_dir1, work_dir, all, PF_ONLY, KEEP_NAMES, 
-                    subsam_names, subsam_starts, &bases, quals );
+                    subsam_names, subsam_starts, &bases, quals, pCensus );
                BinaryWriter::writeFile( work_dir + "/subsam.starts", subsam_starts );
                BinaryWriter::writeFile( 
                     work_dir + "/subsam.names", subsam_names );
@@ -550,11 +602,17 @@ int GapToyCore( int argc, char *argv[] )
                {    cout << "\nUh-oh, internal error, sample name and size files "
                          << "have different record counts." << endl
                          << "Giving up." << endl;
-                         Scram(1);    }    }
+                         Scram(1);    }
+               if (CHECKPOINT)
+               {    manifest.Record( stage_manifest::LOADED, bases.size( ),
+                         { "data/frag_reads_orig.fastb", 
+                         "data/frag_reads_orig.qualp", "subsam.starts",
+                         "subsam.names" } );    }    }
           else
           {    BinaryReader::readFile( work_dir + "/subsam.starts", &subsam_starts );
                BinaryReader::readFile( work_dir + "/subsam.names", &subsam_names );
                bases.ReadAll( work_dir + "/data/frag_reads_orig.fastb" );
+               if (RESUME) manifest.Verify( stage_manifest::LOADED, bases.size( ) );
                quals.load( );    }
 
           disco_stats stats;
@@ -573,15 +631,17 @@ int GapToyCore( int argc, char *argv[] )
           if ( true )
           {    HyperBasevector hbv;
                ReadPathVec paths;
-               buildReadQGraph( bases, quals,
-                    FILL_JOIN, //doFillGaps
-                    FILL_JOIN, //doJoinOverlaps
-                    MIN_QUAL, MIN_FREQ,
-                    .75, //minFreq2Fract
-                    0, //maxGapSize
-                    "", //refFasta
-                    True, // new aligner
- 		    SHORT_KMER_READ_PATHER, &hbv, &paths, RQGRAPHER_VERBOSE );
+               {    StageProfile prof( "ReadQGraph" );
+                    buildReadQGraph( bases, quals,
+                         FILL_JOIN, //doFillGaps
+                         FILL_JOIN, //doJoinOverlaps
+                         MIN_QUAL, MIN_FREQ,
+                         .75, //minFreq2Fract
+                         0, //maxGapSize
+                         "", //refFasta
+                         True, // new aligner
+                         SHORT_KMER_READ_PATHER, &hbv, &paths, 
+                         RQGRAPHER_VERBOSE, pCensus );    }
                cout << Date( ) << ": back from buildReadQGraph" << endl;
                cout << Date( ) << ": memory in use = " << MemUsageGBString( )
                     << ", peak = " << PeakMemUsageGBString( ) << endl;
@@ -614,9 +674,8 @@ int GapToyCore( int argc, char *argv[] )
                FixPaths( hbv, paths );
                if (SAVE_60)
                {    paths.WriteAll( outHead+".paths" );
-                    VecULongVec invPaths;
-                    invert( paths, invPaths, hbv.EdgeObjectCount( ) );
-                    invPaths.WriteAll( outHead+".paths.inv");    }
+                    ReadPathIndex( paths, hbv.EdgeObjectCount( ) )
+                         .WriteAll( outHead+".paths.inv");    }
 
                if (IMPROVE_60)
                {    Improve60( hbv, inv, paths, bases, quals.load( ) );
@@ -629,9 +688,8 @@ int GapToyCore( int argc, char *argv[] )
                     paths.WriteAll( work_dir + "/a.60clean/a.paths" );
                     HyperBasevectorX hbx(hbv);
                     BinaryWriter::writeFile( work_dir + "/a.60clean/a.hbx", hbx );
-                    VecULongVec paths_index;
-                    invert( paths, paths_index, hbv.EdgeObjectCount( ) );
-                    paths_index.WriteAll( work_dir + "/a.60clean/a.paths.inv" );    }
+                    ReadPathIndex( paths, hbv.EdgeObjectCount( ) )
+                         .WriteAll( work_dir + "/a.60clean/a.paths.inv" );    }
                
                // if (PAIRS_60)
                // {    vec< pair<vec<int>,vec<int>> > pairs;
@@ -650,6 +708,7 @@ int GapToyCore( int argc, char *argv[] )
                PRINT(checksum_60);
 
                quals.unload();
+               StageProfile prof( "Repath" );
                Repath( hbv, edges, inv, paths, hbv.K(), 200, 
                     run_head+".200", True, True, EXTEND_PATHS );    }
 
@@ -667,11 +726,13 @@ int GapToyCore( int argc, char *argv[] )
           ReadPathVec paths( work_dir + "/a.200.paths" );
           cout << TimeSince(clock1) << " used reloading assembly" << endl;
           if ( CLEAN_200V <= 2 )
-          {    Clean200( hb, inv, paths, bases, quals.load(), CLEAN_200_VERBOSITY,
+          {    StageProfile prof( "Clean200" );
+               Clean200( hb, inv, paths, bases, quals.load(), CLEAN_200_VERBOSITY,
                     CLEAN_200V, REMOVE_TINY );    }
           else
-          {    Clean200x( hb, inv, paths, bases, quals.load(), CLEAN_200_VERBOSITY,
-                    CLEAN_200V, REMOVE_TINY );    }
+          {    StageProfile prof( "Clean200" );
+               Clean200x( hb, inv, paths, bases, quals.load(), 
+                    CLEAN_200_VERBOSITY, CLEAN_200V, REMOVE_TINY );    }
 
           // Write files.
 
@@ -683,12 +744,8 @@ int GapToyCore( int argc, char *argv[] )
           for ( int e = 0; e < hb.EdgeObjectCount( ); e++ )
                edges[e] = hb.EdgeObject(e);
           edges.WriteAll( work_dir + "/a.200.fastb" );
-          if ( true ) // scope paths_index
-          {
-              VecULongVec paths_index;
-              invert( paths, paths_index, hb.EdgeObjectCount( ) );
-              paths_index.WriteAll( work_dir + "/a.200.paths.inv" );
-          }
+          ReadPathIndex( paths, hb.EdgeObjectCount( ) )
+               .WriteAll( work_dir + "/a.200.paths.inv" );
 
           // Relabel files.
 
@@ -697,6 +754,9 @@ int GapToyCore( int argc, char *argv[] )
           for ( String s : { "fastb", "hbv", "hbx", "inv", "paths" } )
                Mv( work_dir + "/a.200." + s, work_dir + "/a.200/a." + s );
           Mv( work_dir+"/a.200.paths.inv", work_dir+"/a.200/a.paths.inv" );
+          if (CHECKPOINT)
+          {    manifest.Record( stage_manifest::BUILT200, hb.CheckSum( ),
+                    { "a.200/a.hbv", "a.200/a.inv", "a.200/a.paths" } );    }
           cout << TimeSince(rclock) << " used in ReadQGrapher" << endl;    }
      else
      {
@@ -704,6 +764,7 @@ int GapToyCore( int argc, char *argv[] )
          {
              double bqclock = WallClockTime( );
              bases.ReadAll(tmp_dir1 + "/frag_reads_orig.fastb");
+             if (RESUME) manifest.Verify( stage_manifest::LOADED, bases.size( ) );
              cout << TimeSince(bqclock) << " used loading bases" << endl;
          }
          BinaryReader::readFile( work_dir + "/subsam.starts", &subsam_starts );
@@ -718,13 +779,15 @@ int GapToyCore( int argc, char *argv[] )
      {    double clock = WallClockTime( );
           BinaryReader::readFile( work_dir + "/a.patched/a.hbv", &hb );
           BinaryReader::readFile( work_dir + "/a.patched/a.inv", &inv2 );
-          paths2.ReadAll( work_dir + "/a.patched/a.paths" );
+          PackedReadPathVec( work_dir + "/a.patched/a.paths" ).unpack( &paths2 );
+          if (RESUME) manifest.Verify( stage_manifest::PATCHED, hb.CheckSum( ) );
           cout << TimeSince(clock) << " used loading assembly" << endl;    }
      if (START_FIN)
      {    double clock = WallClockTime( );
-          BinaryReader::readFile( work_dir + "/a.fin/a.hbv", &hb );
-          BinaryReader::readFile( work_dir + "/a.fin/a.inv", &inv2 );
-          paths2.ReadAll( work_dir + "/a.fin/a.paths" );
+          BinaryReader::readFile( fin_dir + "/a.hbv", &hb );
+          BinaryReader::readFile( fin_dir + "/a.inv", &inv2 );
+          PackedReadPathVec( fin_dir + "/a.paths" ).unpack( &paths2 );
+          if (RESUME) manifest.Verify( stage_manifest::FIN, hb.CheckSum( ) );
           cout << TimeSince(clock) << " used loading assembly" << endl;    }
 
      if ( !START_PATCHED && !START_FIN )
@@ -740,9 +803,10 @@ int GapToyCore( int argc, char *argv[] )
           BinaryReader::readFile( work_dir + "/a.200/a.hbv", &hb );
           int64_t checksum_200 = hb.CheckSum( );
           PRINT(checksum_200);
+          if (RESUME) manifest.Verify( stage_manifest::BUILT200, checksum_200 );
           int nedges = hb.EdgeObjectCount( );
           BinaryReader::readFile( work_dir + "/a.200/a.inv", &inv2 );
-          paths2.ReadAll( work_dir + "/a.200/a.paths" );
+          PackedReadPathVec( work_dir + "/a.200/a.paths" ).unpack( &paths2 );
           cout << "1 peak mem usage = " << PeakMemUsageGBString( ) << "\n";
           cout << TimeSince(xclock) << " used loading stuff" << endl;
 
@@ -795,10 +859,10 @@ int GapToyCore( int argc, char *argv[] )
                         new_stuff2.ReadAll( work_dir + "/new_stuff.exp" );
                         new_stuff.Append(new_stuff2);    }    }
               else
-              {    VecULongVec paths2_index;
-                   invert( paths2, paths2_index, hb.EdgeObjectCount( ) );
+              {    ReadPathIndex paths2_index( paths2, hb.EdgeObjectCount( ) );
                    cout << "launching gap assemblies, mem usage = "
                         << ToStringAddCommas( MemUsageBytes( ) ) << endl;
+                   StageProfile prof( "AssembleGaps2" );
                    AssembleGaps2( hb, inv2, paths2, paths2_index, bases, quals.load(),
                         work_dir, EXTEND, ANNOUNCE, KEEP_ALL_LOCAL, 
                         CONSERVATIVE_KEEP, INJECT, LOCAL_LAYOUT, DUMP_LOCAL, 
@@ -806,7 +870,10 @@ int GapToyCore( int argc, char *argv[] )
                         CYCLIC_SAVE, A2V, GAP_CAP, MAX_PROX_LEFT, MAX_PROX_RIGHT,
                         MAX_BPATHS );
                    BinaryWriter::writeFile( 
-                        work_dir + "/new_stuff", new_stuff );    }
+                        work_dir + "/new_stuff", new_stuff );
+                   if (CHECKPOINT)
+                   {    manifest.Record( stage_manifest::PATCHES, 
+                             new_stuff.size( ), { "new_stuff" } );    }    }
 
               if ( EXIT == "PATCHES" )
               {    cout << "total time = " << TimeSince( all_clock, 1.0, "hours" )
@@ -818,6 +885,7 @@ int GapToyCore( int argc, char *argv[] )
               // Add in new stuff and rebuild graph.
 
               nclock = WallClockTime( );
+              StageProfile prof( "AddNewStuff" );
               AddNewStuff( new_stuff, hb, inv2, paths2, bases, quals.load(),
                                   MIN_GAIN, TRACE_PATHS, work_dir, EXT_MODE );
           }
@@ -857,17 +925,32 @@ int GapToyCore( int argc, char *argv[] )
                     HyperBasevectorX(hb) );
                BinaryWriter::writeFile( work_dir + "/a.patched/a.inv", inv2 );
                paths2.WriteAll( work_dir + "/a.patched/a.paths" );
-               {    VecULongVec invPaths;
-                    invert( paths2, invPaths, hb.EdgeObjectCount( ) );
-                    invPaths.WriteAll( work_dir + "/a.patched/a.paths.inv" );    }
+               ReadPathIndex( paths2, hb.EdgeObjectCount( ) )
+                    .WriteAll( work_dir + "/a.patched/a.paths.inv" );
                cout << Date( ) << ": a.patched written" << endl;
-               LogTime( tclock, "in tail 1" );    }    }
+               LogTime( tclock, "in tail 1" );    }
+
+          // Save what is needed to restart from the patched assembly.
+
+          if (CHECKPOINT)
+          {    if ( !SAVE_PATCHED )
+               {    double cclock = WallClockTime( );
+                    Mkdir777( work_dir + "/a.patched" );
+                    BinaryWriter::writeFile( work_dir + "/a.patched/a.hbv", hb );
+                    BinaryWriter::writeFile( 
+                         work_dir + "/a.patched/a.inv", inv2 );
+                    paths2.WriteAll( work_dir + "/a.patched/a.paths" );
+                    LogTime( cclock, "writing patched checkpoint" );    }
+               manifest.Record( stage_manifest::PATCHED, hb.CheckSum( ),
+                    { "a.patched/a.hbv", "a.patched/a.inv", 
+                    "a.patched/a.paths" } );    }    }
      Validate( hb, inv2, paths2 );
 
      // Simplify the assembly.
 
      if ( !START_FIN )
-     {    if (CLEAN_200_POST)
+     {    StageProfile prof( "Simplify" );
+          if (CLEAN_200_POST)
           {    Clean200( hb, inv2, paths2, bases, quals.load(), 
                CLEAN_200_VERBOSITY );    }
           Simplify( fin_dir, hb, inv2, paths2, bases, quals.load(), MAX_SUPP_DEL,
@@ -888,7 +971,8 @@ int GapToyCore( int argc, char *argv[] )
      // Write pre-scaffolded final assembly.
 
      if ( !START_FIN )
-     {    double pclock = WallClockTime( );
+     {    StageProfile prof( "WriteFin" );
+          double pclock = WallClockTime( );
           bases.destroy( );
           cout << Date( ) << ": writing a.fin files" << endl;
           BinaryWriter::writeFile( fin_dir + "/a.hbv", hb );
@@ -907,28 +991,34 @@ int GapToyCore( int argc, char *argv[] )
                     if ( paths2[i][j] < 0 ) bad = True;
                if (bad) paths2[i].resize(0);    }
           paths2.WriteAll( fin_dir + "/a.paths" );
-          VecULongVec invPaths;
-          invert( paths2, invPaths, hb.EdgeObjectCount( ) );
-          invPaths.WriteAll( fin_dir + "/a.paths.inv" );
+          ReadPathIndex( paths2, hb.EdgeObjectCount( ) )
+               .WriteAll( fin_dir + "/a.paths.inv" );
           LogTime( pclock, "writing final assembly" );
           BinaryWriter::writeFile( fin_dir + "/a.inv", inv2 );
-          if (SAVE_FASTA) hb.DumpFasta( fin_dir + "/a.fasta", False );    }
+          if (SAVE_FASTA) hb.DumpFasta( fin_dir + "/a.fasta", False );
+          if (CHECKPOINT)
+          {    String fin = "a.fin" + FIN;
+               manifest.Record( stage_manifest::FIN, hb.CheckSum( ),
+                    { fin + "/a.hbv", fin + "/a.inv", fin + "/a.paths" } );    }    }
 
      // Align to genome.
 
      if ( ALIGN_TO_GENOME && IsRegularFile( work_dir + "/genome.fastb" ) )
-     {    vec< vec< pair<int,int> > > hits;
+     {    StageProfile prof( "AlignToGenome" );
+          vec< vec< pair<int,int> > > hits;
           vecbasevector genome( work_dir + "/genome.fastb" );
-          AlignToGenome( hb, inv2, genome, hits );
+          genome_kmer_index gix( genome, work_dir + "/genome.fastb" );
+          AlignToGenome( hb, inv2, gix, hits );
           BinaryWriter::writeFile( fin_dir + "/a.aligns", hits );    }
      else Remove( fin_dir + "/a.aligns" );
 
      // Find lines and write files.
 
      vec<vec<vec<vec<int>>>> lines;
-     FindLines( hb, inv2, lines, MAX_CELL_PATHS, MAX_DEPTH );
-     BinaryWriter::writeFile( fin_dir + "/a.lines", lines );
-     {  
+     {    StageProfile prof( "FindLines" );
+          FindLines( hb, inv2, lines, MAX_CELL_PATHS, MAX_DEPTH );
+          line_store(lines).Write( fin_dir + "/a.lines" );    }
+     {    StageProfile prof( "LineStats" );
 	 vec<int> llens, npairs;
 	 GetLineLengths( hb, lines, llens );
 	 GetLineNpairs( hb, inv2, paths2, lines, npairs );
@@ -950,16 +1040,19 @@ int GapToyCore( int argc, char *argv[] )
 
      // Scaffold.
 
-     {    VecULongVec invPaths;
-          invert( paths2, invPaths, hb.EdgeObjectCount( ) );
+     {    StageProfile prof( "MakeGaps" );
+          VecULongVec invPaths;
+          ReadPathIndex( paths2, hb.EdgeObjectCount( ) ).unpack( &invPaths );
           MakeGaps( hb, inv2, paths2, invPaths, MIN_LINE, MIN_LINK_COUNT, work_dir,
                "fin" + FIN, SCAFFOLD_VERBOSE, GAP_CLEANUP );    }
 
      // Carry out final analyses and write final assembly files.
 
-     FinalFiles( hb, inv2, paths2, subsam_names, subsam_starts, work_dir, final_dir,
-          MAX_CELL_PATHS, MAX_DEPTH, ALIGN_TO_GENOME, EVALUATE, EVALUATE_VERBOSE, 
-          X, res, SAMPLE, species, fosmids, G, SAVE_FASTA );
+     {    StageProfile prof( "FinalFiles" );
+          FinalFiles( hb, inv2, paths2, subsam_names, subsam_starts, work_dir, 
+               final_dir, MAX_CELL_PATHS, MAX_DEPTH, ALIGN_TO_GENOME, EVALUATE, 
+               EVALUATE_VERBOSE, X, res, SAMPLE, species, fosmids, G, 
+               SAVE_FASTA );    }
 
      // Done.
 
@@ -967,10 +1060,13 @@ int GapToyCore( int argc, char *argv[] )
      cout << "peak mem usage = " << PeakMemUsageGBString( ) << ", ";
      cout << "total time = " << TimeSince( all_clock, 1.0, "hours" ) << endl;
      cout << "final checksum = " << hb.CheckSum( ) << endl;
+     if (CHECKPOINT) manifest.Record( stage_manifest::DONE, hb.CheckSum( ),
+          vec<String>( ) );
      cout << "\n" << command.TheCommand( ) << endl << endl;
 
      double hours = double( WallClockTime( ) - all_clock ) / 3600.0;
      PerfStatLogger::log("etime_h", hours, "elapsed time in hours");
+     StageProfiler::finish( );
      cout << Date( ) << ": done" << endl << endl;
 
      // Note funny exit here, probably shouldn't be doing this.
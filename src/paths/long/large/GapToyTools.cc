@@ -35,6 +35,7 @@
 #include "paths/long/LongProtoTools.h"
 #include "paths/long/MakeKmerStuff.h"
 #include "paths/long/ReadPath.h"
+#include "paths/long/ReadSubset.h"
 #include "paths/long/RefTrace.h"
 #include "paths/long/SupportedHyperBasevector.h"
 #include "paths/long/large/GapToyTools.h"
@@ -745,71 +746,15 @@ void Dot( const int nblobs, int& nprocessed, int& dots_printed,
           {    cout << "\n" << Date( ) << ": STOP " << bl << endl;    }    }    }
 
 void FixInversion( const HyperBasevector& hb, vec<int>& inv2 )
-{    double clock1 = WallClockTime( );
+{    double clock = WallClockTime( );
      inv2.resize_and_set( hb.EdgeObjectCount( ), -1 );
-     const int K = 200;
-     ForceAssertEq( K, hb.K( ) );
      vec<Bool> used;
      hb.Used(used);
      vec<int> ids;
      for ( int e = 0; e < hb.EdgeObjectCount( ); e++ )
           if ( used[e] ) ids.push_back(e);
-     vec< triple<kmer<K>,int,int> > uni2( ids.size( ) * 2 );
-     #pragma omp parallel for
-     for ( int i = 0; i < ids.isize( ); i++ )
-     {    int e = ids[i];
-          kmer<K> x;
-          x.SetToSubOf( hb.EdgeObject(e), 0 );
-          uni2[2*i] = make_triple( x, 0, e );
-          basevector b = hb.EdgeObject(e);
-          b.ReverseComplement( );
-          x.SetToSubOf( b, 0 );
-          uni2[2*i+1] = make_triple( x, 1, e );    }
-     cout << TimeSince(clock1) << " used fixing inversion 1" << endl;
-     double clock2 = WallClockTime( );
-     ParallelSort(uni2);
-     cout << TimeSince(clock2) << " used fixing inversion 2" << endl;
-     double clock3 = WallClockTime( );
-     const int blocks = 100;
-     vec<int> starts( blocks + 1 );
-     for ( int j = 0; j <= blocks; j++ )
-          starts[j] = ( j * uni2.jsize( ) ) / blocks;
-     for ( int j = blocks - 1; j >= 1; j-- )
-     {    while( starts[j] > 0 && uni2[ starts[j] ].first
-               == uni2[ starts[j] - 1 ].first )
-          {    starts[j]--;    }    }
-     #pragma omp parallel for
-     for ( int b = 0; b < blocks; b++ )
-     {    for ( int i = starts[b]; i < starts[b+1]; i++ )
-          {    int j;
-               for ( j = i + 1; j < starts[b+1]; j++ )
-                    if ( uni2[j].first != uni2[i].first ) break;
-               if ( j - i == 2 && uni2[i].second != uni2[i+1].second )
-               {    int e1 = uni2[i].third, e2 = uni2[i+1].third;
-                    basevector b1 = hb.EdgeObject(e1);
-                    b1.ReverseComplement( );
-                    if ( b1 == hb.EdgeObject(e2) )
-                    {    inv2[ uni2[i].third ] = uni2[i+1].third;
-                         inv2[ uni2[i+1].third ] = uni2[i].third;    }    }
-                    else if ( j - i > 2 )
-               {    vec< triple<basevector,int,int> > U(j-i);
-                    for ( int k = i; k < j; k++ )
-                    {    int e = uni2[k].third;
-                         U[k-i].first = hb.EdgeObject(e);
-                         if ( uni2[k].second == 1 ) 
-                              U[k-i].first.ReverseComplement( );
-                         U[k-i].second = uni2[k].second, U[k-i].third = e;    }
-                    Sort(U);
-                    for ( int l = 0; l < U.isize( ); l++ )
-                    {    int m;
-                         for ( m = l + 1; m < U.isize( ); m++ )
-                              if ( U[m].first != U[l].first ) break;
-                         if ( m - l == 2 && U[l].second != U[l+1].second )
-                         {    inv2[ U[l].third ] = U[l+1].third;
-                              inv2[ U[l+1].third ] = U[l].third;    }
-                         l = m - 1;    }    }
-               i = j - 1;    }    }
-     cout << TimeSince(clock3) << " used fixing inversion 3" << endl;    }
+     hb.PartialInvolution( ids, inv2, False );
+     cout << TimeSince(clock) << " used fixing inversion" << endl;    }
 
 void InsertPatch( HyperBasevector& hb, vec<int>& to_left, 
      vec<int>& to_right, const HyperBasevector& hbp, 
@@ -1172,7 +1117,8 @@ void MakeLocalAssembly1( const int lroot, const int rroot,
      const VecPQVec& quals, const vec<int64_t>& pids, const String& TMP,
      ostringstream& mout, const Bool LOCAL_LAYOUT, const int K2_FLOOR, 
      const String& work_dir, VecEFasta& corrected, vecbasevector& creads, 
-     vec<pairing_info>& cpartner, vec<int>& cid, LongProtoTmpDirManager& tmp_mgr )
+     vec<pairing_info>& cpartner, vec<int>& cid, LongProtoTmpDirManager& tmp_mgr,
+     const int NUM_THREADS )
 {
      mout << Date( ) << ": begin gap assembly" << endl;
      double clock1 = WallClockTime( );
@@ -1190,24 +1136,12 @@ void MakeLocalAssembly1( const int lroot, const int rroot,
      // Remove(TMP+"/frag_reads_orig.qualb");
      // Remove(TMP+"/frag_reads_orig.pairs");
      const bool bDelOldFile=true;
-     vecbasevector& gbases=tmp_mgr["frag_reads_orig"].reads(bDelOldFile);
-     vecqualvector& gquals=tmp_mgr["frag_reads_orig"].quals(bDelOldFile);
-     qvec qv;
-     for ( int l = 0; l < pids.isize( ); l++ )
-     {    int64_t pid = pids[l];
-          int64_t id1 = 2*pid, id2 = 2*pid + 1;
-          gbases.push_back( bases[id1] ); 
-          gbases.push_back( bases[id2] );
-          quals[id1].unpack(&qv);
-          gquals.push_back( qv );
-          quals[id2].unpack(&qv);
-          gquals.push_back( qv );    }
-     // gbases.WriteAll( TMP + "/frag_reads_orig.fastb" );
-     // gquals.WriteAll( TMP + "/frag_reads_orig.qualb" );
+     tmp_mgr["frag_reads_orig"].setSubset( 
+          ReadSubset::fromPairIds( bases, quals, pids ) );
      const int SEP = 0;
      const int STDEV = 100;
      const String LIB = "woof";
-     const size_t nreads = gbases.size( );
+     const size_t nreads = 2 * pids.size( );
      // PairsManager gpairs(nreads);
      PairsManager& gpairs = tmp_mgr["frag_reads_orig"].pairs(bDelOldFile);
      gpairs = PairsManager(nreads);
@@ -1218,7 +1152,6 @@ void MakeLocalAssembly1( const int lroot, const int rroot,
      // gpairs.Write( TMP + "/frag_reads_orig.pairs" );
      double clock2 = WallClockTime( );
      // tmp_mgr["frag_reads_orig"].write();
-     uint NUM_THREADS = 1;
      CorrectionSuite( tmp_mgr, heur, logc, log_control, creads, corrected,
           cid, cpartner, NUM_THREADS, "", clock, False );
      mout << "total correction time = " << TimeSince(clock2) << endl;
@@ -16,6 +16,7 @@
 #include "feudal/PQVec.h"
 #include "paths/HyperBasevector.h"
 #include "paths/long/ReadPath.h"
+#include "paths/long/ReadPathIndex.h"
 #include "paths/long/SupportedHyperBasevector.h"
 #include "paths/long/large/DiscoStats.h"
 #include "paths/long/large/GapToyTools2.h"
@@ -95,6 +96,10 @@ void ExtractReads( const String& sample, const String& species, const String& ba
      const Bool KEEP_NAMES, vec<int64_t>& subsam_starts, 
      vecbvec* pReads, ObjectManager<VecPQVec>& quals );
 
+// FixInversion: compute the involution of the used edges; unused edges, and
+// edges whose reverse complement is missing, get -1.  So do edges that have an
+// identical copy, or whose reverse complement has one.
+
 void FixInversion( const HyperBasevector& hb, vec<int>& inv2 );
 
 void InsertPatch( HyperBasevector& hb, vec<int>& to_left, vec<int>& to_right, 
@@ -115,7 +120,8 @@ void MakeLocalAssembly1( const int lroot, const int rroot,
      const VecPQVec& quals, const vec<int64_t>& pids, const String& TMP,
      ostringstream& mout, const Bool LOCAL_LAYOUT, const int K2_FLOOR,
      const String& work_dir, VecEFasta& corrected, vecbasevector& creads,
-     vec<pairing_info>& cpartner, vec<int>& cid, LongProtoTmpDirManager& tmp_mgr );
+     vec<pairing_info>& cpartner, vec<int>& cid, LongProtoTmpDirManager& tmp_mgr,
+     const int NUM_THREADS = 1 );
 
 void MakeLocalAssembly2( VecEFasta& corrected, const HyperBasevector& hb,
      const vec<int>& lefts, const vec<int>& rights, ostringstream& mout,
@@ -134,18 +140,58 @@ void AnalyzeBranches( HyperBasevector& hb, vec<int>& to_right, const vec<int>& i
      ReadPathVec& paths2, const Bool ANALYZE_BRANCHES_REV, 
      const int min_ratio2, const Bool ANALYZE_BRANCHES_VERBOSE );
 
-void ExtendTerminalEdges( const HyperBasevector& hb, 
-     const vec< vec<int> >& layout_pos, const vec< vec<int64_t> >& layout_id, 
-     const vec< vec<Bool> >& layout_or, const vecbasevector& bases, 
-     const VecPQVec& quals );
+// A layout_place is a placement of read id on an edge, starting at position pos
+// on the edge (which may be negative), either fw or rc.  Placements are ordered
+// by position, then by read, then fw before rc.
+
+class layout_place {
+
+     public:
+
+     layout_place( ) { }
+     layout_place( const int pos, const Bool fw, const int64_t id )
+          : pos(pos), fw(fw), id(id) { }
+
+     friend bool operator<( const layout_place& x1, const layout_place& x2 )
+     {    if ( x1.pos != x2.pos ) return x1.pos < x2.pos;
+          if ( x1.id != x2.id ) return x1.id < x2.id;
+          return x1.fw > x2.fw;    }
+
+     int pos;
+     Bool fw;
+     int64_t id;
+
+};
+
+// A read_layout holds the read placements on all the edges of a graph, as a
+// single array, in which the placements on edge e are the sorted range
+// [ starts[e], starts[e+1] ).
+
+class read_layout {
+
+     public:
+
+     int64_t Count( const int e ) const { return starts[e+1] - starts[e]; }
+
+     const layout_place& Place( const int e, const int64_t k ) const
+     {    return places[ starts[e] + k ];    }
+
+     vec<int64_t> starts;
+     vec<layout_place> places;
+
+};
+
+void ExtendTerminalEdges( const HyperBasevector& hb, const read_layout& layout,
+     const vecbasevector& bases, const VecPQVec& quals );
 
 void SelectSpecials( const HyperBasevector& hb, vecbasevector& bases,
      VecPQVec const& quals, const ReadPathVec& paths2, const String& work_dir );
 
+// LayoutReads: place each read on the first and last edges of its path, and the
+// first and last edges of the reverse complement of its path.
+
 void LayoutReads( const HyperBasevector& hb, const vec<int>& inv, 
-     const vecbasevector& bases, const ReadPathVec& paths, 
-     vec<vec<int>>& layout_pos, vec<vec<int64_t>>& layout_id, 
-     vec<vec<Bool>>& layout_or );
+     const vecbasevector& bases, const ReadPathVec& paths, read_layout& layout );
 
 void SortBlobs( const HyperBasevector& hb,
      const vec< triple< pair<int,int>, triple<int,vec<int>,vec<int>>, vec<int> > >&
@@ -163,7 +209,7 @@ void Degloop( const int mode, HyperBasevector& hb, vec<int>& inv, ReadPathVec& p
 
 template<class H> void DegloopCore( const int mode, H& hb, vec<int>& inv, 
      ReadPathVec& paths, const vecbasevector& bases, const VecPQVec& quals,
-     const VecULongVec& paths_index, const int v, const int pass,
+     const ReadPathIndex& paths_index, const int v, const int pass,
      const double min_dist, vec<int>& EDELS, const int verbosity,
      const vec<int>* ids = NULL );
 
@@ -312,9 +358,18 @@ void TestInvolution( const HyperBasevector& hb, const vec<int>& inv );
 void DeleteFunkyPathPairs( const HyperBasevector& hb, const vec<int>& inv,
      const vecbasevector& bases, ReadPathVec& paths, const Bool verbose );
 
+// AlignToGenome and AlignToGenomePerf look up genome kmers in a 
+// genome_kmer_index.  The versions that take just the genome build a temporary 
+// index in memory.
+
+class genome_kmer_index;
+
 void AlignToGenome( const HyperBasevector& hb, const vec<int>& inv,
      const vecbasevector& genome, vec< vec< pair<int,int> > >& hits );
 
+void AlignToGenome( const HyperBasevector& hb, const vec<int>& inv,
+     const genome_kmer_index& gix, vec< vec< pair<int,int> > >& hits );
+
 // A perf_place is a perfect match between an assembly (extending across one or
 // more edges) and a genome reference sequence.  The starting position on the
 // genome is (g,start).  The sequence of assembly edges is e.  The start on the
@@ -355,6 +410,10 @@ void AlignToGenomePerf( const HyperBasevector& hb, const vecbasevector& genome,
      vec< triple< pair<int,int>, pair<int,int>, int > >& perfs,
      vec<perf_place>& places );
 
+void AlignToGenomePerf( const HyperBasevector& hb, const genome_kmer_index& gix,
+     vec< triple< pair<int,int>, pair<int,int>, int > >& perfs,
+     vec<perf_place>& places );
+
 void ReroutePaths( const HyperBasevector& hb, const vec<int>& inv,
      ReadPathVec& paths, const vecbasevector& bases, const VecPQVec& quals );
 
@@ -20,7 +20,11 @@
 #include "paths/RemodelGapTools.h"
 #include "paths/long/KmerCount.h"
 #include "paths/long/ReadPath.h"
+#include "paths/long/ReadPathIndex.h"
 #include "paths/long/large/GapToyTools.h"
+#include "system/MemBudget.h"
+#include <atomic>
+#include <memory>
 
 // AnalyzeBranches: note not adjusting to_right.  This is wrong.
 
@@ -300,10 +304,8 @@ void AnalyzeBranches( HyperBasevector& hb, vec<int>& to_right, const vec<int>& i
      if (ANALYZE_BRANCHES_VERBOSE) cout << "\n";
      LogTime( clock2, "analyzing branches 2" );    }
 
-void ExtendTerminalEdges( const HyperBasevector& hb, 
-     const vec< vec<int> >& layout_pos, const vec< vec<int64_t> >& layout_id, 
-     const vec< vec<Bool> >& layout_or, const vecbasevector& bases, 
-     const VecPQVec& quals )
+void ExtendTerminalEdges( const HyperBasevector& hb, const read_layout& layout,
+     const vecbasevector& bases, const VecPQVec& quals )
 {    
      vec<int> to_left, to_right;
      hb.ToLeft(to_left), hb.ToRight(to_right);
@@ -312,16 +314,17 @@ void ExtendTerminalEdges( const HyperBasevector& hb,
      {    if ( !hb.Sink( to_right[e] ) ) continue;
           vec< triple<int,char,uchar> > exts;
           cout << "extensions of edge " << e << endl;
-          for ( int j = 0; j < layout_pos[e].isize( ); j++ )
-          {    int id = layout_id[e][j];
+          for ( int64_t j = 0; j < layout.Count(e); j++ )
+          {    const layout_place& x = layout.Place( e, j );
+               int id = x.id;
                quals[id].unpack(&qv);
-               int stop = layout_pos[e][j] + bases[id].isize( );
-               if ( layout_pos[e][j] > hb.EdgeLengthBases(e) )
+               int stop = x.pos + bases[id].isize( );
+               if ( x.pos > hb.EdgeLengthBases(e) )
                {    cout << "weird" << endl;
                     continue;    }
                int ext = stop - hb.EdgeLengthBases(e);
                if ( ext <= 0 ) continue;
-               if ( layout_or[e][j] )
+               if ( x.fw )
                {    cout << "fw ";
                     for ( int l = 0; l < ext; l++ )
                     {    int pos = bases[id].isize( ) - ext + l;
@@ -542,41 +545,88 @@ void ExtraPaths( const HyperBasevector& hb, const vecbasevector& bases,
           << PERCENT_RATIO( 3, count, npids ) << " of total" << endl;    }
 
 void LayoutReads( const HyperBasevector& hb, const vec<int>& inv,
-     const vecbasevector& bases, const ReadPathVec& paths,
-     vec<vec<int>>& layout_pos, vec<vec<int64_t>>& layout_id, 
-     vec<vec<Bool>>& layout_or )
+     const vecbasevector& bases, const ReadPathVec& paths, read_layout& layout )
 {
-     int nedges = hb.EdgeObjectCount( );
-     layout_pos.resize(nedges), layout_id.resize(nedges), layout_or.resize(nedges);
-     for ( int64_t i = 0; i < (int64_t) paths.size( ); i++ )
-     {    vec<int> x;
-          for ( int j = 0; j < (int) paths[i].size( ); j++ )
-               x.push_back( paths[i][j] );
-          if ( x.empty( ) ) continue;
-          int pos = paths[i].getOffset( );
-          for ( int j = 0; j < x.isize( ); j++ )
-          {    if ( j > 0 && j < x.isize( ) - 1 ) continue;
-               layout_pos[ x[j] ].push_back(pos);
-               layout_id[ x[j] ].push_back(i);
-               layout_or[ x[j] ].push_back(True);
-               pos -= hb.EdgeLengthKmers( x[j] );    }
-          x.ReverseMe( );
-          for ( int j = 0; j < x.isize( ); j++ )
-               x[j] = inv[ x[j] ];
-          pos = paths[i].getOffset( ) + bases[i].isize( );
-          int len = hb.EdgeLength( x[0] );
-          for ( int j = 1; j < x.isize( ); j++ )
-               len += hb.EdgeLengthKmers( x[j] );
-          pos = len - pos;
-          for ( int j = 0; j < x.isize( ); j++ )
-          {    if ( j > 0 && j < x.isize( ) - 1 ) continue;
-               layout_pos[ x[j] ].push_back(pos);
-               layout_id[ x[j] ].push_back(i);
-               layout_or[ x[j] ].push_back(False);
-               pos -= hb.EdgeLengthKmers( x[j] );    }    }
-     #pragma omp parallel for
+     // Find the placements of read i, of which there are at most four.  Note
+     // that the position on the last edge is only adjusted for the first edge.
+
+     auto place = [&]( const int64_t i, int* e, layout_place* x )
+     {    const ReadPath& p = paths[i];
+          const int n = p.size( );
+          if ( n == 0 ) return 0;
+          int m = 0;
+          int pos = p.getOffset( );
+          e[m] = p[0], x[m++] = layout_place( pos, True, i );
+          if ( n > 1 )
+          {    pos -= hb.EdgeLengthKmers( p[0] );
+               e[m] = p[n-1], x[m++] = layout_place( pos, True, i );    }
+          int len = hb.EdgeLength( inv[ p[n-1] ] );
+          for ( int j = n - 2; j >= 0; j-- )
+               len += hb.EdgeLengthKmers( inv[ p[j] ] );
+          pos = len - ( p.getOffset( ) + bases[i].isize( ) );
+          e[m] = inv[ p[n-1] ], x[m++] = layout_place( pos, False, i );
+          if ( n > 1 )
+          {    pos -= hb.EdgeLengthKmers( inv[ p[n-1] ] );
+               e[m] = inv[ p[0] ], x[m++] = layout_place( pos, False, i );    }
+          return m;    };
+
+     // Count the placements on each edge, then store them, by batches of reads.
+     // A batch claims all its slots before storing anything, because the
+     // atomic increments would otherwise stall the stores.
+
+     const int nedges = hb.EdgeObjectCount( );
+     const int64_t nreads = paths.size( ), batch = 10000;
+     const int64_t nbatches = ( nreads + batch - 1 ) / batch;
+     std::unique_ptr< std::atomic<int64_t>[] > 
+          next( new std::atomic<int64_t>[nedges]( ) );
+     #pragma omp parallel for schedule(dynamic, 1)
+     for ( int64_t bi = 0; bi < nbatches; bi++ )
+     {    int e[4];
+          layout_place x[4];
+          const int64_t stop = Min( nreads, ( bi + 1 ) * batch );
+          for ( int64_t i = bi * batch; i < stop; i++ )
+          {    const int m = place( i, e, x );
+               for ( int j = 0; j < m; j++ )
+                    next[ e[j] ].fetch_add( 1, std::memory_order_relaxed );    }    }
+     layout.starts.resize( nedges + 1 );
+     layout.starts[0] = 0;
+     for ( int e = 0; e < nedges; e++ )
+     {    layout.starts[e+1] = layout.starts[e] + next[e];
+          next[e] = layout.starts[e];    }
+
+     // The placements themselves have to be stored, but each thread filling
+     // them also holds a batch of slots and placements, so if memory is short,
+     // fill with only as many threads as the budget covers, or with just one
+     // if the placements alone overrun it.
+
+     const Bool fits = ExpectMemory( "LayoutReads", 
+          layout.starts[nedges] * sizeof(layout_place) );
+     layout.places.resize( layout.starts[nedges] );
+     const int fill_threads = ( !fits ? 1 : MemBoundedThreads( 
+          4 * batch * ( sizeof(int64_t) + sizeof(layout_place) ) ) );
+     #pragma omp parallel for schedule(dynamic, 1) num_threads(fill_threads)
+     for ( int64_t bi = 0; bi < nbatches; bi++ )
+     {    int e[4];
+          vec<int64_t> slots;
+          vec<layout_place> xs;
+          const int64_t stop = Min( nreads, ( bi + 1 ) * batch );
+          for ( int64_t i = bi * batch; i < stop; i++ )
+          {    layout_place x[4];
+               const int m = place( i, e, x );
+               for ( int j = 0; j < m; j++ )
+               {    slots.push_back( next[ e[j] ].fetch_add( 
+                         1, std::memory_order_relaxed ) );
+                    xs.push_back( x[j] );    }    }
+          for ( int j = 0; j < slots.isize( ); j++ )
+               layout.places[ slots[j] ] = xs[j];    }
+     next.reset( );
+
+     // Sort the placements on each edge.
+
+     #pragma omp parallel for schedule(dynamic, 1000)
      for ( int e = 0; e < nedges; e++ )
-          SortSync( layout_pos[e], layout_or[e], layout_id[e] );    }
+     {    std::sort( layout.places.begin( ) + layout.starts[e],
+               layout.places.begin( ) + layout.starts[e+1] );    }    }
 
 void SortBlobs( const HyperBasevector& hb,
      const vec< triple< pair<int,int>, triple<int,vec<int>,vec<int>>, vec<int> > >&
@@ -717,8 +767,7 @@ void Clean200( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
 
      vec<int> to_right;
      hb.ToRight(to_right);
-     VecULongVec paths_index;
-     invert( paths, paths_index, hb.EdgeObjectCount( ) );
+     ReadPathIndex paths_index( paths, hb.EdgeObjectCount( ) );
 
      // Look for weak branches.
 
@@ -917,7 +966,7 @@ void Clean200( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
 
 template<class H> void DegloopCore( const int mode, H& hb, vec<int>& inv, 
      ReadPathVec& paths, const vecbasevector& bases, const VecPQVec& quals,
-     const VecULongVec& paths_index, const int v, const int pass,
+     const ReadPathIndex& paths_index, const int v, const int pass,
      const double min_dist, vec<int>& EDELS, const int verbosity,
      const vec<int>* ids )
 {
@@ -1083,13 +1132,13 @@ template<class H> void DegloopCore( const int mode, H& hb, vec<int>& inv,
 
 template void DegloopCore( const int mode, HyperBasevector& hb, vec<int>& inv, 
      ReadPathVec& paths, const vecbasevector& bases, const VecPQVec& quals,
-     const VecULongVec& paths_index, const int v, const int pass,
+     const ReadPathIndex& paths_index, const int v, const int pass,
      const double min_dist, vec<int>& EDELS, const int verbosity,
      const vec<int>* ids );
 
 template void DegloopCore( const int mode, HyperBasevectorX& hb, vec<int>& inv, 
      ReadPathVec& paths, const vecbasevector& bases, const VecPQVec& quals,
-     const VecULongVec& paths_index, const int v, const int pass,
+     const ReadPathIndex& paths_index, const int v, const int pass,
      const double min_dist, vec<int>& EDELS, const int verbosity,
      const vec<int>* ids );
 
@@ -1103,8 +1152,7 @@ void Degloop( const int mode, HyperBasevector& hb, vec<int>& inv, ReadPathVec& p
      const int verbosity )
 {    cout << Date( ) << ": start degloop" << endl;
      cout << Date( ) << ": creating path index" << endl;
-     VecULongVec paths_index;
-     invert( paths, paths_index );
+     ReadPathIndex paths_index( paths, hb.EdgeObjectCount( ) );
 
      // Main loop.
 
@@ -24,6 +24,7 @@
 #include "paths/long/HBVFromEdges.h"
 #include "paths/long/LongReadsToPaths.h"
 #include "paths/long/ReadPath.h"
+#include "paths/long/ReadPathIndex.h"
 #include "paths/long/ReadPathTools.h"
 #include "paths/long/ReadStack.h"
 #include "paths/long/large/GapToyTools.h"
@@ -812,8 +813,7 @@ void RemoveUnneededVerticesGeneralizedLoops( HyperBasevector& hb, vec<int>& inv,
 {    double clock1 = WallClockTime( );
      vec<int> to_left, to_right;
      hb.ToLeft(to_left), hb.ToRight(to_right);
-     VecULongVec paths_index;
-     invert( paths, paths_index, hb.EdgeObjectCount( ) );
+     ReadPathIndex paths_index( paths, hb.EdgeObjectCount( ) );
      vec<Bool> processed( hb.N( ), False );
      vec<int> dels;
      for ( int i = 0; i < hb.N( ); i++ )
@@ -1021,12 +1021,11 @@ void TestInvolution( const HyperBasevector& hb, const vec<int>& inv )
                PRINT3( e, inv[e], hb.EdgeObjectCount( ) );
                cout << "Illegal involution value.\n" << "Abort." << endl;
                TracebackThisProcess( );    }
-          basevector b = hb.EdgeObject(e);
-          b.ReverseComplement( );
-          if ( b != hb.EdgeObject( inv[e] ) )
+          if ( !IsReverseComplement( hb.EdgeObject(e), hb.EdgeObject( inv[e] ) ) )
           {    cout << "\n";
                int re = inv[e];
-               PRINT4( e, re, b.size( ), hb.EdgeObject(re).size( ) );
+               PRINT4( e, re, hb.EdgeObject(e).size( ), 
+                    hb.EdgeObject(re).size( ) );
                cout << "Involution value not rc.\n" << "Abort." << endl;
                TracebackThisProcess( );    }
           if ( inv[inv[e]] != e )
@@ -1177,8 +1176,7 @@ void UnwindThreeEdgePlasmids(HyperBasevector& hb, vec<int>& inv, ReadPathVec& pa
 
      // Set up indices.
 
-     VecULongVec paths_index;
-     invert( paths, paths_index, hb.EdgeObjectCount( ) );
+     ReadPathIndex paths_index( paths, hb.EdgeObjectCount( ) );
      vec<int> to_right;
      hb.ToRight(to_right);
 
@@ -158,42 +158,359 @@ void BuildAll( vecbasevector& allx, const HyperBasevector& hb, const int64_t ext
                     tmp.assign(x1.end()-K,x1.end()).push_back(x2[K-1]);
                     allx.push_back(tmp);    }    }    }    }
 
-// Note that this truncates to length 1.
+// Translate a path to hb3.  Note that this truncates to length 1.
+
+void TranslatePath( ReadPath& p, const HyperBasevector& hb3,
+     const vec<vec<int>>& to3, const vec<int>& left3 )
+{    if ( p.size( ) == 0 ) return;
+     int start = p.getOffset( ) + left3[ p[0] ];
+
+     if ( to3[p[0]].empty( ) )
+     {    p.clear( );
+          return;    }
+
+     if ( start < hb3.Bases( to3[ p[0] ][0] ) )
+     {    p.resize(1);
+          p[0] = to3[ p[0] ][0];
+          p.setOffset(start);
+          return;    }
+
+     SerfVec<int> q;
+     for ( int j = 0; j < (int) p.size( ); j++ )
+     {    if ( to3[ p[j] ].empty( ) ) break;
+          OverlapAppend( q, to3[p[j]] );    }
+     int trim = 0;
+     while( start >= hb3.EdgeLengthBases( q[trim] ) )
+     {    start -= hb3.EdgeLengthKmers( q[trim] );
+          trim++;
+          if ( trim == (int) q.size( ) ) break;    }
+
+     if ( trim == (int) q.size( ) )
+     {    p.clear( );
+          return;    }
+     p.resize(1);
+     p[0] = q[trim];
+     p.setOffset(start);    }
 
 void TranslatePaths( ReadPathVec& paths2, const HyperBasevector& hb3,
      const vec<vec<int>>& to3, const vec<int>& left3 )
 {
      #pragma omp parallel for
      for ( int64_t i = 0; i < (int64_t) paths2.size( ); i++ )
-     {    if ( paths2[i].size( ) == 0 ) continue;
-          int start = paths2[i].getOffset( ) + left3[ paths2[i][0] ];
+          TranslatePath( paths2[i], hb3, to3, left3 );    }
 
-          if ( to3[paths2[i][0]].empty( ) )
-          {    paths2[i].clear( );
-               continue;    }
-     
-          if ( start < hb3.Bases( to3[ paths2[i][0] ][0] ) )
-          {    paths2[i].resize(1);
-               paths2[i][0] = to3[ paths2[i][0] ][0];
-               paths2[i].setOffset(start);
-               continue;    }
+namespace {
 
-          SerfVec<int> p;
-          for ( int j = 0; j < (int) paths2[i].size( ); j++ )
-          {    if ( to3[ paths2[i][j] ].empty( ) ) break;
-               OverlapAppend( p, to3[paths2[i][j]] );    }
-          int trim = 0;
-          while( start >= hb3.EdgeLengthBases( p[trim] ) )
-          {    start -= hb3.EdgeLengthKmers( p[trim] );
-               trim++;
-               if ( trim == (int) p.size( ) ) break;    }
-
-          if ( trim == (int) p.size( ) )
-          {    paths2[i].clear( );
-               continue;    }
-          paths2[i].resize(1);
-          paths2[i][0] = p[trim];
-          paths2[i].setOffset(start);    }    }
+// Polynomial hashes of the windows of n bases in a sequence.
+
+class window_hash {
+
+     public:
+
+     window_hash( const int n ) : n_(n), pow_(1)
+     {    for ( int j = 0; j < n; j++ )
+               pow_ *= Mult;    }
+
+     // Hash of b[start,start+n).
+
+     uint64_t operator()( const bvec& b, const int start ) const
+     {    uint64_t h = 0;
+          for ( int j = start; j < start + n_; j++ )
+               h = h * Mult + b[j] + 1;
+          return h;    }
+
+     // Given the hash h of b[start,start+n), return the hash of 
+     // b[start+1,start+n+1).
+
+     uint64_t Next( const bvec& b, const int start, const uint64_t h ) const
+     {    return h * Mult + b[ start + n_ ] + 1 - pow_ * ( b[start] + 1 );    }
+
+     private:
+
+     static const uint64_t Mult = 0x9e3779b97f4a7c15ul;
+     int n_;
+     uint64_t pow_;
+};
+
+// SpliceNewStuff: add new_stuff to hb by rebuilding only the part of the graph
+// that it touches, which is usually a small fraction of it.
+//
+// The edges that share a (K-1)-mer with new_stuff are the affected edges.  No
+// other edge can change, except by being joined at a vertex, so we build a 
+// local graph from the affected edges, the vertex crossings at their ends (as 
+// in BuildAll), and new_stuff, and splice it into hb in place of the affected 
+// edges.  At a boundary vertex, where affected and unaffected edges meet, the 
+// local graph is cut, and the kmers it has of the unaffected edges, which come 
+// from the crossings, are discarded.
+//
+// Paths are translated, and flagged for extension, only if they touch an 
+// affected edge or end at a boundary vertex; other paths are just renumbered.
+// Returns False, without changing anything, if too much of the graph would
+// have to be rebuilt, or if the graph isn't as expected, in which case the 
+// caller should rebuild the whole graph.
+
+Bool SpliceNewStuff( const vecbvec& new_stuff, HyperBasevector& hb, 
+     vec<int>& inv2, ReadPathVec& paths2, vec<Bool>& extend )
+{    double clock = WallClockTime( );
+     const int K = hb.K( );
+     const int nedges = hb.EdgeObjectCount( );
+     window_hash wh(K-1);
+
+     // Hash the (K-1)-mers of new_stuff, in both orientations, and make a bit 
+     // filter for them.
+
+     vec<uint64_t> nh;
+     for ( size_t i = 0; i < new_stuff.size( ); i++ )
+     {    if ( new_stuff[i].isize( ) < K - 1 ) continue;
+          for ( int pass = 1; pass <= 2; pass++ )
+          {    bvec b( new_stuff[i] );
+               if ( pass == 2 ) b.ReverseComplement( );
+               uint64_t h = wh( b, 0 );
+               nh.push_back(h);
+               for ( int j = 0; j + K - 1 < b.isize( ); j++ )
+               {    h = wh.Next( b, j, h );
+                    nh.push_back(h);    }    }    }
+     ParallelUniqueSort(nh);
+     int lbits = 20;
+     while ( ( 1ul << lbits ) < 16 * nh.size( ) ) lbits++;
+     vec<uint64_t> filter( ( 1ul << lbits ) / 64, 0 );
+     for ( uint64_t h : nh )
+     {    uint64_t x = h >> (64-lbits);
+          filter[x/64] |= 1ul << (x%64);    }
+
+     // Find the affected edges.  Hash collisions only cause a little extra to
+     // be rebuilt.  Edge objects that are no longer in the graph are never
+     // affected; they're dropped when the graph is compacted below.
+
+     vec<Bool> used, affected( nedges, False );
+     hb.Used(used);
+     #pragma omp parallel for schedule(dynamic, 1000)
+     for ( int e = 0; e < nedges; e++ )
+     {    if ( !used[e] ) continue;
+          const bvec& b = hb.EdgeObject(e);
+          uint64_t h = wh( b, 0 );
+          for ( int j = 0; ; j++ )
+          {    uint64_t x = h >> (64-lbits);
+               if ( ( filter[x/64] & ( 1ul << (x%64) ) ) && BinMember( nh, h ) )
+               {    affected[e] = True;
+                    break;    }
+               if ( j + K - 1 == b.isize( ) ) break;
+               h = wh.Next( b, j, h );    }    }
+     Destroy(nh), Destroy(filter);
+     vec<int> aff;
+     int64_t total_kmers = 0, aff_kmers = 0;
+     for ( int e = 0; e < nedges; e++ )
+     {    if ( !used[e] ) continue;
+          total_kmers += hb.Kmers(e);
+          if ( !affected[e] ) continue;
+          if ( !affected[ inv2[e] ] ) return False;
+          aff.push_back(e);
+          aff_kmers += hb.Kmers(e);    }
+     cout << Date( ) << ": " << aff.size( ) << " of " << nedges 
+          << " edges touched by new stuff" << endl;
+     const int max_rebuild_frac = 4;
+     if ( aff_kmers * max_rebuild_frac > total_kmers ) return False;
+
+     // Gather the local sequences.  The first aff.size( ) are the affected 
+     // edges, then come the crossings, then new_stuff.
+
+     vec<int> to_left, to_right;
+     hb.ToLeft(to_left), hb.ToRight(to_right);
+     vecbvec local;
+     for ( int e : aff )
+          local.push_back( hb.EdgeObject(e) );
+     vec<int> verts;
+     for ( int e : aff )
+          verts.push_back( to_left[e], to_right[e] );
+     UniqueSort(verts);
+     vec<int> bverts;
+     vec<bvec> bkmers, stubs;
+     bvec tmp(K+1);
+     for ( int v : verts )
+     {    Bool boundary = False;
+          for ( int e : hb.ToEdgeObj(v) )
+               if ( !affected[e] ) boundary = True;
+          for ( int e : hb.FromEdgeObj(v) )
+               if ( !affected[e] ) boundary = True;
+          for ( int e1 : hb.ToEdgeObj(v) )
+          for ( int e2 : hb.FromEdgeObj(v) )
+          {    if ( !affected[e1] && !affected[e2] ) continue;
+               const bvec &x1 = hb.EdgeObject(e1), &x2 = hb.EdgeObject(e2);
+               tmp.assign( x1.end( ) - K, x1.end( ) ).push_back( x2[K-1] );
+               local.push_back(tmp);
+               if ( !affected[e1] ) 
+                    stubs.push_back( bvec( x1, x1.size( ) - K, K ) );
+               if ( !affected[e2] ) stubs.push_back( bvec( x2, 0, K ) );    }
+          if ( !boundary ) continue;
+          bverts.push_back(v);
+          if ( hb.To(v).nonempty( ) )
+          {    const bvec& x = hb.EdgeObject( hb.ITo(v,0) );
+               bkmers.push_back( bvec( x, x.size( ) - (K-1), K-1 ) );    }
+          else
+          {    const bvec& x = hb.EdgeObject( hb.IFrom(v,0) );
+               bkmers.push_back( bvec( x, 0, K-1 ) );    }    }
+     SortSync( bkmers, bverts );
+     UniqueSort(stubs);
+     local.append( new_stuff.begin( ), new_stuff.end( ) );
+
+     HyperBasevector hbl;
+     ReadPathVec lpaths;
+     const int coverage = 4;
+     buildBigKHBVFromReads( K, local, coverage, &hbl, &lpaths );
+     Destroy(local);
+
+     // Cut the local edges at boundary (K-1)-mers, into pieces.  Piece 
+     // boundaries are given as kmer positions on the local edge.  A piece 
+     // consisting of a single unaffected kmer is a stub, and is dropped 
+     // (marked -1).
+
+     vec<uint64_t> bh;
+     for ( const bvec& x : bkmers )
+          bh.push_back( wh( x, 0 ) );
+     Sort(bh);
+     const int nl = hbl.EdgeObjectCount( );
+     vec<vec<int>> cuts(nl), piece_id(nl);
+     vecbvec pieces;
+     for ( int x = 0; x < nl; x++ )
+     {    const bvec& b = hbl.EdgeObject(x);
+          const int nk = b.isize( ) - K + 1;
+          cuts[x].push_back(0);
+          uint64_t h = wh( b, 0 );
+          for ( int j = 1; j < nk; j++ )
+          {    h = wh.Next( b, j - 1, h );
+               if ( !BinMember( bh, h ) ) continue;
+               if ( BinMember( bkmers, bvec( b, j, K-1 ) ) ) 
+                    cuts[x].push_back(j);    }
+          cuts[x].push_back(nk);
+          for ( int l = 0; l < cuts[x].isize( ) - 1; l++ )
+          {    bvec p( b, cuts[x][l], cuts[x][l+1] - cuts[x][l] + K - 1 );
+               if ( p.isize( ) == K && BinMember( stubs, p ) ) 
+                    piece_id[x].push_back(-1);
+               else
+               {    piece_id[x].push_back( pieces.size( ) );
+                    pieces.push_back(p);    }    }    }
+     const int np = pieces.size( );
+
+     // Find the vertices of the pieces.  Boundary (K-1)-mers are existing 
+     // vertices, others are new.
+
+     vec<bvec> vkmers;
+     for ( int p = 0; p < np; p++ )
+     {    const bvec& x = pieces[p];
+          vkmers.push_back( bvec( x, 0, K-1 ) );
+          vkmers.push_back( bvec( x, x.size( ) - (K-1), K-1 ) );    }
+     UniqueSort(vkmers);
+     vec<int> vid( vkmers.size( ) );
+     int nnew = 0;
+     for ( int j = 0; j < vkmers.isize( ); j++ )
+     {    int b = BinPosition( bkmers, vkmers[j] );
+          vid[j] = ( b >= 0 ? bverts[b] : hb.N( ) + nnew++ );    }
+     vec<pair<int,int>> ends(np);
+     for ( int p = 0; p < np; p++ )
+     {    const bvec& x = pieces[p];
+          ends[p].first = vid[ BinPosition( vkmers, bvec( x, 0, K-1 ) ) ];
+          ends[p].second = 
+               vid[ BinPosition( vkmers, bvec( x, x.size( ) - (K-1), K-1 ) ) ];    }
+
+     // The splice must not change the degree of a boundary vertex.
+
+     vec<int> nto( bverts.size( ), 0 ), nfrom( bverts.size( ), 0 );
+     for ( int j = 0; j < bverts.isize( ); j++ )
+     {    int v = bverts[j];
+          for ( int e : hb.ToEdgeObj(v) )
+               if ( !affected[e] ) nto[j]++;
+          for ( int e : hb.FromEdgeObj(v) )
+               if ( !affected[e] ) nfrom[j]++;    }
+     vec<int> bpos( hb.N( ) + nnew, -1 );
+     for ( int j = 0; j < bverts.isize( ); j++ )
+          bpos[ bverts[j] ] = j;
+     for ( int p = 0; p < np; p++ )
+     {    int j1 = bpos[ ends[p].first ], j2 = bpos[ ends[p].second ];
+          if ( j1 >= 0 ) nfrom[j1]++;
+          if ( j2 >= 0 ) nto[j2]++;    }
+     for ( int j = 0; j < bverts.isize( ); j++ )
+     {    if ( nto[j] != hb.To( bverts[j] ).isize( ) ) return False;
+          if ( nfrom[j] != hb.From( bverts[j] ).isize( ) ) return False;    }
+
+     // Pair each piece with its reverse complement.
+
+     vec<int> pinv( np, -1 );
+     {    vec<bvec> sorted_pieces( pieces.begin( ), pieces.end( ) );
+          vec<int> ids( np, vec<int>::IDENTITY );
+          SortSync( sorted_pieces, ids );
+          for ( int p = 0; p < np; p++ )
+          {    bvec rc( pieces[p] );
+               rc.ReverseComplement( );
+               int j = BinPosition( sorted_pieces, rc );
+               if ( j < 0 ) return False;
+               pinv[p] = ids[j];    }    }
+
+     // Find the pieces traversed by each affected edge, and where it starts on
+     // the first of them.
+
+     vec<vec<int>> to3( nedges );
+     vec<int> left3( nedges, 0 );
+     for ( int i = 0; i < aff.isize( ); i++ )
+     {    const ReadPath& lp = lpaths[i];
+          int remaining = hb.Kmers( aff[i] );
+          for ( int j = 0; j < (int) lp.size( ); j++ )
+          {    const int x = lp[j];
+               const int s = ( j == 0 ? lp.getFirstSkip( ) : 0 );
+               const int take = Min( remaining, hbl.Kmers(x) - s );
+               for ( int l = 0; l < piece_id[x].isize( ); l++ )
+               {    if ( cuts[x][l+1] <= s || cuts[x][l] >= s + take ) continue;
+                    if ( piece_id[x][l] < 0 ) return False;
+                    vec<int>& t = to3[ aff[i] ];
+                    if ( t.empty( ) ) left3[ aff[i] ] = s - cuts[x][l];
+                    t.push_back( nedges + piece_id[x][l] );    }
+               remaining -= take;    }
+          if ( remaining != 0 || to3[ aff[i] ].empty( ) ) return False;    }
+
+     // Splice the pieces into hb, in place of the affected edges.
+
+     vec<Bool> bvert( hb.N( ), False );
+     for ( int v : bverts )
+          bvert[v] = True;
+     hb.DeleteEdges(aff);
+     hb.AddVertices(nnew);
+     for ( int p = 0; p < np; p++ )
+          hb.AddEdge( ends[p].first, ends[p].second, pieces[p] );
+     vec<int> tr = hb.RemoveDeadEdgeObjects( );
+     vec<int> inv( hb.EdgeObjectCount( ) );
+     for ( int e = 0; e < nedges; e++ )
+     {    if ( !affected[e] ) 
+          {    if ( tr[e] < 0 ) continue; // unused before the splice
+               to3[e].push_back( tr[e] );
+               inv[ tr[e] ] = tr[ inv2[e] ];    }
+          else
+          {    for ( int& x : to3[e] )
+                    x = tr[x];    }    }
+     for ( int p = 0; p < np; p++ )
+          inv[ tr[ nedges + p ] ] = tr[ nedges + pinv[p] ];
+     inv2 = inv;
+
+     // Update the paths.
+
+     extend.resize_and_set( paths2.size( ), False );
+     #pragma omp parallel for
+     for ( int64_t i = 0; i < (int64_t) paths2.size( ); i++ )
+     {    ReadPath& p = paths2[i];
+          if ( p.size( ) == 0 ) continue;
+          Bool touched = False;
+          for ( int j = 0; j < (int) p.size( ); j++ )
+               if ( affected[ p[j] ] ) touched = True;
+          if (touched) TranslatePath( p, hb, to3, left3 );
+          else
+          {    if ( bvert[ to_right[ p.back( ) ] ] ) extend[i] = True;
+               for ( int j = 0; j < (int) p.size( ); j++ )
+                    p[j] = tr[ p[j] ];    }
+          if (touched) extend[i] = True;    }
+     hb.RemoveEdgelessVertices( );
+     cout << Date( ) << ": spliced " << np << " edges into graph, replacing "
+          << aff.size( ) << ", in " << TimeSince(clock) << endl;
+     return True;    }
+
+}
 
 void AddNewStuff( vecbvec& new_stuff, HyperBasevector& hb, vec<int>& inv2, 
      ReadPathVec& paths2, const vecbasevector& bases, const VecPQVec& quals, 
@@ -214,47 +531,54 @@ void AddNewStuff( vecbvec& new_stuff, HyperBasevector& hb, vec<int>& inv2,
      Validate( hb, inv2, paths2 );
      const int K = 200;
      ForceAssertEq( K, hb.K( ) );
-     vec<Bool> used;
-     hb.Used(used);
 
-     HyperBasevector hb3;
-     vec<vec<int>> to3( hb.EdgeObjectCount( ) );
-     vec<int> left3( hb.EdgeObjectCount( ) );
-     {
-          ReadPathVec allx_paths;
-          vecbasevector allx;
-          BuildAll( allx, hb, new_stuff.size( ) );
-          // add in "new_stuff" to allx
-          allx.append(new_stuff.begin(),new_stuff.end());
-
-          cout << Date( ) << ": building hb2" << endl;
-          cout << TimeSince(clock1) << " used in new stuff 1 test" << endl;
-          cout << "memory in use now = " << ToStringAddCommas( MemUsageBytes( ) )
-               << endl;
-          double clock2 = WallClockTime( );
-          const int coverage = 4;
-          buildBigKHBVFromReads( K, allx, coverage, &hb3, &allx_paths);
-          cout << Date( ) << ": back from buildBigKHBVFromReads" << endl;
-
-          // build to3 and left3 from allx_paths
-
-          for ( int i = 0; i < hb.EdgeObjectCount(); ++i ) 
-          {    for ( auto const& p : allx_paths[i] )
-                    to3[i].push_back( p );
-               left3[i] = allx_paths[i].getFirstSkip();    }
-
-          cout << TimeSince(clock2) << " used in new stuff 2 test" << endl;
-
-          if ( trace_edges.size() ) 
-          {    cout << "BigKHBV EDGE-PATHS:" << endl;
-               for ( auto const& edge : trace_edges )
-                    cout << edge << ": " << allx_paths[edge] << endl;    }    }
-
-     cout << "peak mem usage = " << PeakMemUsageGBString( ) << endl;
-     double clock3 = WallClockTime( );
-     TranslatePaths( paths2, hb3, to3, left3 );
-     hb = hb3;
-     hb.Involution(inv2);
+     // Splice the new stuff into the graph, extending only the paths that 
+     // might have changed, or if that can't be done, rebuild the graph and
+     // extend all paths.
+
+     vec<Bool> extend;
+     if ( trace_edges.empty( ) 
+          && SpliceNewStuff( new_stuff, hb, inv2, paths2, extend ) )
+     {    cout << TimeSince(clock1) << " used in new stuff 1 test" << endl;    }
+     else
+     {    HyperBasevector hb3;
+          vec<vec<int>> to3( hb.EdgeObjectCount( ) );
+          vec<int> left3( hb.EdgeObjectCount( ) );
+          {
+               ReadPathVec allx_paths;
+               vecbasevector allx;
+               BuildAll( allx, hb, new_stuff.size( ) );
+               // add in "new_stuff" to allx
+               allx.append(new_stuff.begin(),new_stuff.end());
+
+               cout << Date( ) << ": building hb2" << endl;
+               cout << TimeSince(clock1) << " used in new stuff 1 test" << endl;
+               cout << "memory in use now = " 
+                    << ToStringAddCommas( MemUsageBytes( ) ) << endl;
+               double clock2 = WallClockTime( );
+               const int coverage = 4;
+               buildBigKHBVFromReads( K, allx, coverage, &hb3, &allx_paths);
+               cout << Date( ) << ": back from buildBigKHBVFromReads" << endl;
+
+               // build to3 and left3 from allx_paths
+
+               for ( int i = 0; i < hb.EdgeObjectCount(); ++i ) 
+               {    for ( auto const& p : allx_paths[i] )
+                         to3[i].push_back( p );
+                    left3[i] = allx_paths[i].getFirstSkip();    }
+
+               cout << TimeSince(clock2) << " used in new stuff 2 test" << endl;
+
+               if ( trace_edges.size() ) 
+               {    cout << "BigKHBV EDGE-PATHS:" << endl;
+                    for ( auto const& edge : trace_edges )
+                         cout << edge << ": " << allx_paths[edge] << endl;    }    }
+
+          cout << "peak mem usage = " << PeakMemUsageGBString( ) << endl;
+          TranslatePaths( paths2, hb3, to3, left3 );
+          hb = hb3;
+          hb.Involution(inv2);
+          extend.resize_and_set( paths2.size( ), True );    }
 
      // Extend paths.
 
@@ -266,7 +590,7 @@ void AddNewStuff( vecbvec& new_stuff, HyperBasevector& hb, vec<int>& inv2,
      hb.ToRight(to_right);
      #pragma omp parallel for
      for ( int64_t i = 0; i < (int64_t) paths2.size( ); i++ )
-     {    if ( paths2[i].size( ) > 0 ) paths2[i].resize(1);
+     {    if ( !extend[i] ) continue;
           ExtendPath( paths2[i], i, hb, to_right, bases[i], quals.begin()[i],
                   MIN_GAIN, extend_paths_verbose, EXT_MODE );    }
      Validate( hb, inv2, paths2 );
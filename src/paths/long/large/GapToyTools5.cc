@@ -24,11 +24,15 @@
 #include "paths/HyperBasevector.h"
 #include "paths/RemodelGapTools.h"
 #include "paths/long/ReadPath.h"
+#include "paths/long/ReadPathIndex.h"
 #include "paths/long/large/GapToyTools.h"
+#include "paths/long/large/GenomeKmerIndex.h"
 #include "system/RunTime.h"
 #include "system/SpinLockedData.h"
 #include "system/WorklistN.h"
 #include <algorithm>
+#include <atomic>
+#include <memory>
 
 // AlignToGenome.  Find alignments of assembly edges to the genome.  Currently this
 // maps edges to pairs (g,p) consisting of a genome contig g and an inferred start
@@ -37,129 +41,111 @@
 // First we find 60-mer matches between the assembly and the genome.  We require
 // that the 60-mer occur exactly once in the assembly and once in the genome.  Each
 // such match is required to exactly perfectly to a total length of 500 bases.
+//
+// The genome 60-mers are looked up in a genome_kmer_index, so only the assembly
+// side is kmerized here.  Copies of an assembly 60-mer find the same first genome
+// entry, so marking those entries tells us which 60-mers are unique in the
+// assembly.
 
 void AlignToGenome( const HyperBasevector& hb, const vec<int>& inv,
      const vecbasevector& genome, vec< vec< pair<int,int> > >& hits )
+{    genome_kmer_index gix(genome);
+     AlignToGenome( hb, inv, gix, hits );    }
+
+void AlignToGenome( const HyperBasevector& hb, const vec<int>& inv,
+     const genome_kmer_index& gix, vec< vec< pair<int,int> > >& hits )
 {
      // Heuristics.
 
-     const int K = 60;
+     const int K = genome_kmer_index::K;
      const int K2 = 500;
-     const int max_gap = 20000;
      const int max_gmult = 4;
+     ForceAssertGe( K2, genome_kmer_index::MinTail );
 
-     // Computational performance heuristics.
-
-     const int64_t batches = 100;
-
-     // Go through four passes.
+     // Go through four passes, by first base, to limit memory use.
 
      double clock = WallClockTime( );
-     int nobj = hb.EdgeObjectCount( ), ngenome = genome.size( );
+     const vecbasevector& genome = gix.Genome( );
+     int nobj = hb.EdgeObjectCount( );
      hits.clear( );
      hits.resize(nobj);
      for ( int pi = 0; pi < 4; pi++ )
      {    
-          // Build lookup table.
+          // Find the edge kmers that occur at least once and at most max_gmult 
+          // times in the genome.  For each, record the first genome entry, the
+          // start on the edge, and the end of the genome entries.
 
-          double clock2 = WallClockTime( );
-          vec< triple<kmer<K>,int,int> > kmers_plus;
-          vec<int64_t> starts;
-          starts.reserve( ngenome + nobj );
-          starts.push_back(0);
-          {    vec<int> counts( ngenome + nobj, 0 );
-               #pragma omp parallel for
-               for ( int i = 0; i < ngenome; i++ )
-               {    const basevector& u = genome[i];
-                    counts[i] = 0;
-                    for ( int j = 0; j <= u.isize( ) - K2; j++ )
-                         if ( u[j] == pi ) counts[i]++;    }
-               #pragma omp parallel for
-               for ( int i = 0; i < nobj; i++ )
-               {    const basevector& u = hb.EdgeObject(i);
-                    counts[ genome.size( ) + i ] = 0;
-                    for ( int j = 0; j <= u.isize( ) - K2; j++ )
-                         if ( u[j] == pi ) counts[ ngenome + i ]++;    }
-               for ( int i = 0; i < ngenome + nobj; i++ )
-                    starts.push_back( starts.back( ) + counts[i] );    }
-          kmers_plus.resize( starts.back( ) );
-          #pragma omp parallel for
-          for ( int i = 0; i < ngenome; i++ )
-          {    const basevector& u = genome[i];
-               int count = 0;
-               kmer<K> x;
-               for ( int j = 0; j <= u.isize( ) - K2; j++ )
-               {    if ( u[j] == pi )
-                    {    int64_t r = starts[i] + count;
-                         x.SetToSubOf( u, j ); 
-                         kmers_plus[r].first = x;
-                         kmers_plus[r].second = i, kmers_plus[r].third = j;    
-                         count++;    }    }    }
-          #pragma omp parallel for
-          for ( int i = 0; i < nobj; i++ )
-          {    const basevector& u = hb.EdgeObject(i);
-               int count = 0;
-               kmer<K> x;
+          vec< vec< triple<int64_t,int,int64_t> > > cands(nobj);
+          #pragma omp parallel for schedule(dynamic, 1)
+          for ( int e = 0; e < nobj; e++ )
+          {    const basevector& u = hb.EdgeObject(e);
+               if ( u.isize( ) < K2 ) continue;
+               genome_kmer_index::key x( u, 0 );
                for ( int j = 0; j <= u.isize( ) - K2; j++ )
-               {    if ( u[j] == pi )
-                    {    int64_t r = starts[ngenome+i] + count;
-                         x.SetToSubOf( u, j ); 
-                         kmers_plus[r].first = x;
-                         kmers_plus[r].second = ngenome + i, kmers_plus[r].third = j;
-                         count++;    }    }    }
-          // cout << TimeSince(clock2) << " used building kmers" << endl;
-          double clock2b = WallClockTime( );
-          ParallelSort(kmers_plus);
-          // cout << TimeSince(clock2b) << " used sorting kmers" << endl;
-
-          // Traverse the kmers.
-
-          double clock3a = WallClockTime( );
-          vec<int64_t> bstart(batches+1);
-          for ( int64_t i = 0; i <= batches; i++ )
-               bstart[i] = ( (int64_t) kmers_plus.size( ) * i ) / batches;
+               {    if ( j > 0 ) x.Push( u[j+K-1] );
+                    if ( u[j] != pi ) continue;
+                    pair<int64_t,int64_t> r = gix.Find(x);
+                    int64_t first = -1;
+                    int mult = 0;
+                    for ( int64_t m = r.first; m < r.second; m++ )
+                    {    const genome_kmer_index::entry& y = gix[m];
+                         if ( (int) y.pos > genome[y.g].isize( ) - K2 ) continue;
+                         if ( first < 0 ) first = m;
+                         if ( ++mult > max_gmult ) break;    }
+                    if ( mult >= 1 && mult <= max_gmult ) 
+                         cands[e].push( first, j, r.second );    }    }
+
+          // Find the kmers that occur once in the assembly, by marking their
+          // first genome entries as seen, and as seen twice.
+
+          int64_t flo = gix.size( ), fhi = 0;
+          for ( int e = 0; e < nobj; e++ )
+          for ( int j = 0; j < cands[e].isize( ); j++ )
+          {    flo = Min( flo, cands[e][j].first );
+               fhi = Max( fhi, cands[e][j].first + 1 );    }
+          const int64_t nwords = ( Max( fhi - flo, int64_t(0) ) + 63 ) / 64;
+          std::unique_ptr< std::atomic<uint64_t>[] >
+               seen( new std::atomic<uint64_t>[nwords]( ) ),
+               dup( new std::atomic<uint64_t>[nwords]( ) );
           #pragma omp parallel for schedule(dynamic, 1)
-          for ( int64_t i = 1; i < batches; i++ )
-          {    int64_t& s = bstart[i];
-               while( s > 0 && kmers_plus[s].first == kmers_plus[s-1].first )
-               {    s--;    }    }
-          // cout << TimeSince(clock3a) << " used setting up traversal" << endl;
-          double clock3 = WallClockTime( );
+          for ( int e = 0; e < nobj; e++ )
+          for ( int j = 0; j < cands[e].isize( ); j++ )
+          {    int64_t f = cands[e][j].first - flo;
+               uint64_t bit = uint64_t(1) << ( f % 64 );
+               if ( seen[f/64].fetch_or( bit, std::memory_order_relaxed ) & bit )
+                    dup[f/64].fetch_or( bit, std::memory_order_relaxed );    }
+
+          // Extend the unique matches.
+
           #pragma omp parallel for schedule(dynamic, 1)
-          for ( int64_t bi = 0; bi < batches; bi++ )
-          for ( int64_t i = bstart[bi]; i < bstart[bi+1]; i++ )
-          {    int64_t j, k;
-               for ( j = i + 1; j < bstart[bi+1]; j++ )
-                    if ( kmers_plus[j].first != kmers_plus[i].first ) break;
-               for ( k = i; k < j; k++ )
-                    if ( kmers_plus[k].second >= ngenome ) break;
-               if ( k > i && j - k == 1 && k - i <= max_gmult )
-               {    for ( int64_t m = i; m < k; m++ )
-                    {    int e = kmers_plus[k].second - ngenome;
-                         int g = kmers_plus[m].second;
-                         int estart = kmers_plus[k].third; 
-                         int gstart = kmers_plus[m].third;
+          for ( int e = 0; e < nobj; e++ )
+          {    const basevector& u = hb.EdgeObject(e);
+               for ( int c = 0; c < cands[e].isize( ); c++ )
+               {    int64_t first = cands[e][c].first, f = first - flo;
+                    if ( dup[f/64] & ( uint64_t(1) << ( f % 64 ) ) ) continue;
+                    int estart = cands[e][c].second;
+                    for ( int64_t m = first; m < cands[e][c].third; m++ )
+                    {    int g = gix[m].g, gstart = gix[m].pos;
+                         if ( gstart > genome[g].isize( ) - K2 ) continue;
                          int offset = gstart - estart;
-                         if ( !Member( hits[e], make_pair( g, offset ) ) )
-                         {     Bool mismatch = False;
-                              for ( int l = K2 - 1; l >= K; l-- )
-                              {    if ( hb.EdgeObject(e)[estart+l] 
-                                             != genome[g][gstart+l] )
-                                   {    mismatch = True;
-                                        break;    }    }
-                              if ( !mismatch ) 
-                              {
-                                   #pragma omp critical
-                                   {    hits[e].push( 
-                                             g, offset );    }    }    }    }    }
-               i = j - 1;    }
-          // cout << TimeSince(clock3) << " used traversing kmers" << endl;    
-          }    
+                         if ( Member( hits[e], make_pair( g, offset ) ) ) continue;
+                         Bool mismatch = False;
+                         for ( int l = K2 - 1; l >= K; l-- )
+                         {    if ( u[estart+l] != genome[g][gstart+l] )
+                              {    mismatch = True;
+                                   break;    }    }
+                         if ( !mismatch ) hits[e].push( g, offset );    }    }    }    }
      LogTime( clock, "aligning to genome" );    }
 
 void AlignToGenomePerf( const HyperBasevector& hb, const vecbasevector& genome, 
      vec< triple< pair<int,int>, pair<int,int>, int > >& perfs,
      vec<perf_place>& places )
+{    genome_kmer_index gix(genome);
+     AlignToGenomePerf( hb, gix, perfs, places );    }
+
+void AlignToGenomePerf( const HyperBasevector& hb, const genome_kmer_index& gix,
+     vec< triple< pair<int,int>, pair<int,int>, int > >& perfs,
+     vec<perf_place>& places )
 {
      // perfs: { (g,gstart), (e,estart), len ) }
 
@@ -168,115 +154,44 @@ void AlignToGenomePerf( const HyperBasevector& hb, const vecbasevector& genome,
      // try K = 399.
 
      const int K2 = 200;
+     const int K = genome_kmer_index::K; // must be no larger than K2
+     ForceAssertGe( K2, genome_kmer_index::MinTail );
 
-     // Computational performance heuristics.
-
-     const int64_t batches = 100;
-     const int K = 60; // must be no larger than K2
-
-     // Go through four passes.
+     // Look up each edge kmer in the genome, and extend the matches that can't
+     // be extended to the left.
 
      double clock = WallClockTime( );
-     int nobj = hb.EdgeObjectCount( ), ngenome = genome.size( );
+     const vecbasevector& genome = gix.Genome( );
+     int nobj = hb.EdgeObjectCount( );
      vec< vec< quad<int,int,int,int> > > hits; // (estart,g,gstart,len)
      hits.clear( );
      hits.resize(nobj);
-     for ( int pi = 0; pi < 4; pi++ )
-     {    
-          // Build lookup table.
-
-          double clock2 = WallClockTime( );
-          vec< triple<kmer<K>,int,int> > kmers_plus;
-          vec<int64_t> starts;
-          starts.reserve( ngenome + nobj );
-          starts.push_back(0);
-          {    vec<int> counts( ngenome + nobj, 0 );
-               #pragma omp parallel for
-               for ( int i = 0; i < ngenome; i++ )
-               {    const basevector& u = genome[i];
-                    counts[i] = 0;
-                    for ( int j = 0; j <= u.isize( ) - K2; j++ )
-                         if ( u[j] == pi ) counts[i]++;    }
-               #pragma omp parallel for
-               for ( int i = 0; i < nobj; i++ )
-               {    const basevector& u = hb.EdgeObject(i);
-                    counts[ genome.size( ) + i ] = 0;
-                    for ( int j = 0; j <= u.isize( ) - K2; j++ )
-                         if ( u[j] == pi ) counts[ ngenome + i ]++;    }
-               for ( int i = 0; i < ngenome + nobj; i++ )
-                    starts.push_back( starts.back( ) + counts[i] );    }
-          kmers_plus.resize( starts.back( ) );
-          #pragma omp parallel for
-          for ( int i = 0; i < ngenome; i++ )
-          {    const basevector& u = genome[i];
-               int count = 0;
-               kmer<K> x;
-               for ( int j = 0; j <= u.isize( ) - K2; j++ )
-               {    if ( u[j] == pi )
-                    {    int64_t r = starts[i] + count;
-                         x.SetToSubOf( u, j ); 
-                         kmers_plus[r].first = x;
-                         kmers_plus[r].second = i, kmers_plus[r].third = j;    
-                         count++;    }    }    }
-          #pragma omp parallel for
-          for ( int i = 0; i < nobj; i++ )
-          {    const basevector& u = hb.EdgeObject(i);
-               int count = 0;
-               kmer<K> x;
-               for ( int j = 0; j <= u.isize( ) - K2; j++ )
-               {    if ( u[j] == pi )
-                    {    int64_t r = starts[ngenome+i] + count;
-                         x.SetToSubOf( u, j ); 
-                         kmers_plus[r].first = x;
-                         kmers_plus[r].second = ngenome + i, kmers_plus[r].third = j;
-                         count++;    }    }    }
-          double clock2b = WallClockTime( );
-          ParallelSort(kmers_plus);
-
-          // Traverse the kmers.
-
-          double clock3a = WallClockTime( );
-          vec<int64_t> bstart(batches+1);
-          for ( int64_t i = 0; i <= batches; i++ )
-               bstart[i] = ( (int64_t) kmers_plus.size( ) * i ) / batches;
-          #pragma omp parallel for schedule(dynamic, 1)
-          for ( int64_t i = 1; i < batches; i++ )
-          {    int64_t& s = bstart[i];
-               while( s > 0 && kmers_plus[s].first == kmers_plus[s-1].first )
-               {    s--;    }    }
-          double clock3 = WallClockTime( );
-          #pragma omp parallel for schedule(dynamic, 1)
-          for ( int64_t bi = 0; bi < batches; bi++ )
-          for ( int64_t i = bstart[bi]; i < bstart[bi+1]; i++ )
-          {    int64_t j, k;
-               for ( j = i + 1; j < bstart[bi+1]; j++ )
-                    if ( kmers_plus[j].first != kmers_plus[i].first ) break;
-               for ( k = i; k < j; k++ )
-                    if ( kmers_plus[k].second >= ngenome ) break;
-               for ( int64_t m = i; m < k; m++ )
-               for ( int64_t x = k; x < j; x++ )
-               {    int e = kmers_plus[x].second - ngenome;
-                    int g = kmers_plus[m].second;
-                    int estart = kmers_plus[x].third, gstart = kmers_plus[m].third;
+     #pragma omp parallel for schedule(dynamic, 1)
+     for ( int e = 0; e < nobj; e++ )
+     {    const basevector& u = hb.EdgeObject(e);
+          if ( u.isize( ) < K2 ) continue;
+          genome_kmer_index::key x( u, 0 );
+          for ( int estart = 0; estart <= u.isize( ) - K2; estart++ )
+          {    if ( estart > 0 ) x.Push( u[estart+K-1] );
+               pair<int64_t,int64_t> r = gix.Find(x);
+               for ( int64_t m = r.first; m < r.second; m++ )
+               {    int g = gix[m].g, gstart = gix[m].pos;
+                    if ( gstart > genome[g].isize( ) - K2 ) continue;
                     if ( estart-1 >= 0 && gstart-1 >= 0
-                         && hb.EdgeObject(e)[estart-1] == genome[g][gstart-1] )
+                         && u[estart-1] == genome[g][gstart-1] )
                     {    continue;    }
                     Bool mismatch = False;
                     for ( int l = K2 - 1; l >= K; l-- )
-                    {    if ( hb.EdgeObject(e)[estart+l] != genome[g][gstart+l] )
+                    {    if ( u[estart+l] != genome[g][gstart+l] )
                          {    mismatch = True;
                               break;    }    }
                     if ( !mismatch ) 
                     {    int len;
-                         for ( len = K; 
-                              estart + len < hb.EdgeObject(e).isize( ); len++ )
+                         for ( len = K; estart + len < u.isize( ); len++ )
                          {    if ( gstart+len == genome[g].isize( )
-                                   || hb.EdgeObject(e)[estart+len] 
-                                        != genome[g][gstart+len] )
+                                   || u[estart+len] != genome[g][gstart+len] )
                               {    break;    }    }
-                         #pragma omp critical
-                         {    hits[e].push( estart, g, gstart, len );    }    }    }
-               i = j - 1;    }    }    
+                         hits[e].push( estart, g, gstart, len );    }    }    }    }
      perfs.clear( );
      for ( int e = 0; e < hb.E( ); e++ )
      for ( int j = 0; j < hits[e].isize( ); j++ )
@@ -591,8 +506,7 @@ void Tamp( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
      // module, and have it update the index.
 
      double clock = WallClockTime( );
-     VecULongVec paths_index;
-     invert( paths, paths_index, hb.EdgeObjectCount( ) );
+     ReadPathIndex paths_index( paths, hb.EdgeObjectCount( ) );
      int K = hb.K( );
      vec<int> to_left, to_right;
      hb.ToLeft(to_left), hb.ToRight(to_right);
@@ -10,7 +10,6 @@
 // MakeDepend: cflags OMP_FLAGS
 
 #include <sys/utsname.h>
-#include <sys/wait.h>
 
 #include "CoreTools.h"
 #include "FastIfstream.h"
@@ -98,58 +97,27 @@ void PrintSysInfo( )
 
 void MemoryCheck( const Bool MEMORY_CHECK, const String& work_dir )
 {    if (MEMORY_CHECK)
-     {    cout << "MEMORY CHECK (typically takes several minutes; could cause "
-               << "\nmachine to become sluggish or result in this job being killed)" 
-               << endl;
-          Remove( work_dir + "/available_mem" );
-          pid_t pid = fork( );
-          vec<char*> ptr(100);
-          if ( pid == -1 )
-          {    cout << "- Warning: tried to fork process to test available memory, "
-                    << "but the fork failed." << endl;    }
-          else if ( pid == 0 )
-          {    int64_t P = GetMaxMemory( ), d;
-               int64_t M = P/100;
-               for ( d = 1; d <= 100; d++ )
-               {    // probably OK if executed before RunTime( ):
-                    // ptr[d-1] = new (std::nothrow) char[M];
-                    ptr[d-1] = (char*) malloc(M);
-                    if ( ptr[d-1] == NULL )
-                    {    d--;
-                         cout << "- Apparently able to allocate " << d << "% of "
-                              << "nominally available memory (and not more)." 
-                              << endl;
-                         cout << "- Can access " << (d*M) / (1024*1024*1024) 
-                              << " GB." << endl;
-                         if ( d < 90 )
-                         {   cout << "- WARNING: you may have less available memory "
-                                  << "than you think!" << endl;    }
-                         else 
-                         {    cout << "- But you're pretty close, so things should "
-                                   << "be OK." << endl;    }
-                         Ofstream( out, work_dir + "/available_mem" );
-                         out << d*M << endl;
-                         break;    }
-                    #pragma omp parallel for
-                    for ( int64_t i = 0; i < M/1024; i++ )
-                         ptr[d-1][1024*i] = 0;    }
-               if ( d > 100 )
-               {    cout << "- Apparently able to allocate 100% of nominally "
-                         << "available memory." << endl;
-                    cout << "- Can access at least " << P / (1024*1024*1024) 
-                         << " GB." << endl;    }
-               _exit(0);    }
-          else 
-          {    int status;
-               waitpid( pid, &status, 0 );    }
-          if ( IsRegularFile( work_dir + "/available_mem" ) )
-          {    Ifstream( memin, work_dir + "/available_mem" );
-               int64_t mema;
-               memin >> mema;
-               SetMaxMemory(mema);
-               cout << "- Lowering max memory to " << ToStringAddCommas(mema)
+     {    cout << "MEMORY CHECK" << endl;
+          const double GB = 1024.0 * 1024.0 * 1024.0;
+          int64_t limit = memoryLimit( ), budget = GetMaxMemory( );
+          int64_t usable = memoryFree( ) + MemUsageBytes( );
+          cout << setiosflags(ios::fixed) << setprecision(2);
+          if ( limit < (int64_t) physicalMemory( ) )
+          {    cout << "- This process is limited to " << limit/GB 
+                    << " GB of memory." << endl;    }
+          cout << "- Memory currently free or in use by us: " << usable/GB 
+               << " GB." << endl;
+          if ( usable < budget )
+          {    SetMaxMemory(usable);
+               if ( usable < 0.9 * budget )
+               {   cout << "- WARNING: you may have less available memory "
+                         << "than you think!" << endl;    }
+               cout << "- Lowering max memory to " << ToStringAddCommas(usable)
                     << " bytes." << endl;    }
-          cout << endl;    }
+          else
+          {    cout << "- Can use the full budget of " << budget/GB 
+                    << " GB." << endl;    }
+          cout << resetiosflags(ios::fixed) << endl;    }
      else
      {    cout << "Omitting memory check.  If you run into problems with memory,\n"
                << "you might try rerunning with MEMORY_CHECK=True." 
@@ -0,0 +1,272 @@
+///////////////////////////////////////////////////////////////////////////////
+//                   SOFTWARE COPYRIGHT NOTICE AGREEMENT                     //
+//       This software and its documentation are copyright (2015) by the     //
+//   Broad Institute.  All rights are reserved.  This software is supplied   //
+//   without any warranty or guaranteed support whatsoever. The Broad        //
+//   Institute is not responsible for its use, misuse, or functionality.     //
+///////////////////////////////////////////////////////////////////////////////
+
+// MakeDepend: library OMP
+// MakeDepend: cflags OMP_FLAGS
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <atomic>
+#include <memory>
+
+#include "CoreTools.h"
+#include "paths/long/large/GenomeKmerIndex.h"
+#include "system/SortInPlace.h"
+#include "system/file/FileReader.h"
+#include "system/file/FileWriter.h"
+
+// File layout: a header, then 4^prefix_len + 1 bucket starts, then the entries.
+
+struct genome_kmer_index::header {
+     uint64_t magic, version;
+     int64_t k, min_tail, prefix_len;
+     int64_t ncontigs, nbases, sample_hash;
+     int64_t nentries;
+};
+
+namespace {
+
+const uint64_t IndexMagic = 0x58444930364b4547ul;
+const uint64_t IndexVersion = 2;
+
+// Buckets holding more positions than this (e.g. from long runs of Ns, which
+// are stored as As) are sorted by a team of threads, rather than by one.
+
+const int64_t BigBucket = 1000000;
+
+struct keyed_entry {
+     genome_kmer_index::key k;
+     genome_kmer_index::entry e;
+     friend bool operator<( const keyed_entry& x1, const keyed_entry& x2 )
+     {    if ( x1.k < x2.k ) return true;
+          if ( x2.k < x1.k ) return false;
+          if ( x1.e.g != x2.e.g ) return x1.e.g < x2.e.g;
+          return x1.e.pos < x2.e.pos;    }
+};
+
+}
+
+genome_kmer_index::genome_kmer_index( const vecbasevector& genome )
+     : genome_(genome), mapped_(0), mapped_len_(0)
+{    Build( "" );    }
+
+genome_kmer_index::genome_kmer_index( const vecbasevector& genome,
+     const String& genome_file ) : genome_(genome), mapped_(0), mapped_len_(0)
+{    String fn = IndexFile(genome_file);
+     if ( Load(fn) ) return;
+     double clock = WallClockTime( );
+     Build(fn);
+     if ( !Load(fn) ) FatalErr( "Can't reload genome kmer index " << fn << "." );
+     cout << Date( ) << ": built genome kmer index " << fn << " in "
+          << TimeSince(clock) << endl;    }
+
+genome_kmer_index::~genome_kmer_index( )
+{    if ( mapped_ ) munmap( mapped_, mapped_len_ );    }
+
+// About one bucket for every 64 positions, but at most 4^12 buckets.
+
+int genome_kmer_index::PrefixLen( const vecbasevector& genome )
+{    int64_t npos = 0;
+     for ( size_t g = 0; g < genome.size( ); g++ )
+          npos += NPositions( genome[g] );
+     int p = 1;
+     while ( p < 12 && ( int64_t(1) << ( 2 * (p+1) ) ) * 64 <= npos ) p++;
+     return p;    }
+
+// Describe the index that genome_ calls for.  The hash covers the contig sizes
+// and every 997th base, which is enough to notice a different reference.
+
+void genome_kmer_index::Describe( header& h ) const
+{    h.magic = IndexMagic, h.version = IndexVersion;
+     h.k = K, h.min_tail = MinTail;
+     h.prefix_len = PrefixLen(genome_);
+     h.ncontigs = genome_.size( );
+     h.nbases = 0;
+     uint64_t hash = 0;
+     for ( size_t g = 0; g < genome_.size( ); g++ )
+     {    const basevector& b = genome_[g];
+          h.nbases += b.size( );
+          hash = hash * 1000003 + b.size( );
+          for ( size_t j = 0; j < b.size( ); j += 997 )
+               hash = hash * 31 + b[j];    }
+     h.sample_hash = hash;
+     h.nentries = 0;    }
+
+Bool genome_kmer_index::Load( const String& fn )
+{    if ( !IsRegularFile(fn) ) return False;
+     FileReader fr(fn);
+     size_t len = fr.getSize( );
+     header h, want;
+     if ( len < sizeof(h) ) return False;
+     fr.read( &h, sizeof(h) );
+     Describe(want);
+     if ( h.magic != want.magic || h.version != want.version || h.k != want.k
+          || h.min_tail != want.min_tail || h.prefix_len != want.prefix_len
+          || h.ncontigs != want.ncontigs || h.nbases != want.nbases
+          || h.sample_hash != want.sample_hash )
+     {    return False;    }
+     int64_t nbuckets = int64_t(1) << ( 2 * h.prefix_len );
+     if ( len != sizeof(h) + (nbuckets+1) * sizeof(int64_t)
+          + h.nentries * sizeof(entry) )
+     {    return False;    }
+     mapped_len_ = len;
+     mapped_ = fr.map( 0, len, true );
+     prefix_len_ = h.prefix_len;
+     nentries_ = h.nentries;
+     bucket_starts_ = reinterpret_cast<const int64_t*>(
+          static_cast<const char*>(mapped_) + sizeof(h) );
+     entries_ = reinterpret_cast<const entry*>( bucket_starts_ + nbuckets + 1 );
+     return True;    }
+
+// Build the index, writing it to fn, or keeping it in memory if fn is empty.
+// The entries are generated in four passes, one for each first base, to limit
+// the memory needed.
+
+void genome_kmer_index::Build( const String& fn )
+{    header h;
+     Describe(h);
+     const int p = h.prefix_len;
+     const int64_t nbuckets = int64_t(1) << (2*p);
+     const uint64_t mask = nbuckets - 1;
+     const int ngenome = genome_.size( );
+
+     // Count the positions in each bucket.
+
+     std::unique_ptr< std::atomic<int64_t>[] >
+          counts( new std::atomic<int64_t>[nbuckets]( ) );
+     #pragma omp parallel for schedule(dynamic, 1)
+     for ( int g = 0; g < ngenome; g++ )
+     {    const basevector& b = genome_[g];
+          int64_t npos = NPositions(b);
+          if ( npos == 0 ) continue;
+          uint64_t pre = 0;
+          for ( int j = 0; j < p; j++ )
+               pre = ( pre << 2 ) | b[j];
+          for ( int64_t j = 0; j < npos; j++ )
+          {    counts[pre].fetch_add( 1, std::memory_order_relaxed );
+               pre = ( ( pre << 2 ) | b[j+p] ) & mask;    }    }
+     vec<int64_t> starts( nbuckets + 1 );
+     starts[0] = 0;
+     for ( int64_t i = 0; i < nbuckets; i++ )
+          starts[i+1] = starts[i] + counts[i];
+     h.nentries = starts[nbuckets];
+     counts.reset( );
+
+     std::unique_ptr<FileWriter> out;
+     String tmp_fn = fn + ".tmp." + ToString( getpid( ) );
+     if ( fn == "" ) own_entries_.reserve( h.nentries );
+     else
+     {    out.reset( new FileWriter(tmp_fn) );
+          out->write( &h, sizeof(h) );
+          out->write( &starts[0], ( nbuckets + 1 ) * sizeof(int64_t) );    }
+
+     // Fill and sort the buckets for each first base in turn.
+
+     const int64_t pass_buckets = nbuckets / 4;
+     for ( int pi = 0; pi < 4; pi++ )
+     {    const int64_t blo = pi * pass_buckets, bhi = blo + pass_buckets;
+          const int64_t elo = starts[blo], ehi = starts[bhi];
+          vec<entry> pass( ehi - elo );
+          std::unique_ptr< std::atomic<int64_t>[] >
+               next( new std::atomic<int64_t>[pass_buckets] );
+          for ( int64_t i = 0; i < pass_buckets; i++ )
+               next[i] = starts[blo+i] - elo;
+          #pragma omp parallel for schedule(dynamic, 1)
+          for ( int g = 0; g < ngenome; g++ )
+          {    const basevector& b = genome_[g];
+               int64_t npos = NPositions(b);
+               if ( npos == 0 ) continue;
+               uint64_t pre = 0;
+               uint32_t sig = 0;
+               for ( int j = 0; j < p; j++ )
+                    pre = ( pre << 2 ) | b[j];
+               for ( int j = 0; j < SigLen; j++ )
+                    sig = ( sig << 2 ) | b[p+j];
+               for ( int64_t j = 0; j < npos; j++ )
+               {    if ( int64_t(pre) >= blo && int64_t(pre) < bhi )
+                    {    int64_t r = next[pre-blo].fetch_add(
+                              1, std::memory_order_relaxed );
+                         pass[r].g = g, pass[r].pos = j, pass[r].sig = sig;    }
+                    pre = ( ( pre << 2 ) | b[j+p] ) & mask;
+                    sig = ( sig << 2 ) | b[j+p+SigLen];    }    }
+          next.reset( );
+
+          // Sort each bucket by kmer, then by position.
+
+          vec<int64_t> big;
+          #pragma omp parallel for schedule(dynamic, 1000)
+          for ( int64_t i = blo; i < bhi; i++ )
+          {    int64_t n = starts[i+1] - starts[i];
+               if ( n <= 1 ) continue;
+               if ( n > BigBucket )
+               {
+                    #pragma omp critical
+                    {    big.push_back(i);    }
+                    continue;    }
+               vec<keyed_entry> x(n);
+               for ( int64_t j = 0; j < n; j++ )
+               {    x[j].e = pass[ starts[i] - elo + j ];
+                    x[j].k = Key( x[j].e );    }
+               std::sort( x.begin( ), x.end( ) );
+               for ( int64_t j = 0; j < n; j++ )
+                    pass[ starts[i] - elo + j ] = x[j].e;    }
+          for ( int64_t i : big )
+          {    int64_t n = starts[i+1] - starts[i];
+               vec<keyed_entry> x(n);
+               #pragma omp parallel for
+               for ( int64_t j = 0; j < n; j++ )
+               {    x[j].e = pass[ starts[i] - elo + j ];
+                    x[j].k = Key( x[j].e );    }
+               sortInPlaceParallel( 
+                    x.begin( ), x.end( ), std::less<keyed_entry>( ) );
+               for ( int64_t j = 0; j < n; j++ )
+                    pass[ starts[i] - elo + j ] = x[j].e;    }
+
+          if ( fn == "" ) own_entries_.append(pass);
+          else out->write( pass.data( ), pass.size( ) * sizeof(entry) );    }
+
+     // Install the result.  A file is written under a temporary name and then
+     // renamed, so that simultaneous runs can't see a partial index.
+
+     if ( fn == "" )
+     {    own_bucket_starts_.swap(starts);
+          prefix_len_ = p;
+          nentries_ = h.nentries;
+          bucket_starts_ = own_bucket_starts_.data( );
+          entries_ = own_entries_.data( );    }
+     else
+     {    out.reset( );
+          Rename( tmp_fn, fn );    }    }
+
+// Compare the 60-mer of an entry to x, knowing that the first prefix_len_ bases
+// agree.  Most comparisons are settled by the signatures.
+
+int genome_kmer_index::Compare( const entry& y, const key& x ) const
+{    uint32_t xsig = x.Sig(prefix_len_);
+     if ( y.sig != xsig ) return ( y.sig < xsig ? -1 : 1 );
+     const basevector& b = genome_[y.g];
+     for ( int j = prefix_len_ + SigLen; j < K; j++ )
+     {    unsigned yb = b[ y.pos + j ], xb = x.Base(j);
+          if ( yb != xb ) return ( yb < xb ? -1 : 1 );    }
+     return 0;    }
+
+pair<int64_t,int64_t> genome_kmer_index::Find( const key& x ) const
+{    unsigned b = x.Prefix(prefix_len_);
+     int64_t lo = bucket_starts_[b], hi = bucket_starts_[b+1];
+
+     // Find the first entry not less than x, then step past the entries equal
+     // to x, of which there are usually few.
+
+     int64_t n = hi - lo;
+     while ( n > 0 )
+     {    int64_t half = n / 2, mid = lo + half;
+          if ( Compare( entries_[mid], x ) < 0 ) lo = mid + 1, n -= half + 1;
+          else n = half;    }
+     int64_t last = lo;
+     while ( last < hi && Compare( entries_[last], x ) == 0 ) last++;
+     return make_pair( lo, last );    }
@@ -0,0 +1,137 @@
+///////////////////////////////////////////////////////////////////////////////
+//                   SOFTWARE COPYRIGHT NOTICE AGREEMENT                     //
+//       This software and its documentation are copyright (2015) by the     //
+//   Broad Institute.  All rights are reserved.  This software is supplied   //
+//   without any warranty or guaranteed support whatsoever. The Broad        //
+//   Institute is not responsible for its use, misuse, or functionality.     //
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef GENOME_KMER_INDEX_H
+#define GENOME_KMER_INDEX_H
+
+// A genome_kmer_index lists the positions of the forward 60-mers of a reference,
+// sorted by sequence, so that the genome positions of any 60-mer can be found by
+// binary search.  Only positions followed by at least MinTail bases (counting
+// the 60-mer itself) are indexed, as AlignToGenome and AlignToGenomePerf ignore
+// the others.
+//
+// Positions are bucketed by the first few bases of their 60-mer; within a bucket
+// they are sorted by the 60-mer, then by contig and position.  Each entry carries
+// the 16 bases following the bucket prefix, which settles nearly all comparisons
+// during lookup.  The rest of the 60-mer is read from the genome as needed, so
+// the genome must stay in memory while the index is used.
+//
+// The index for genome file X is stored in X.k60idx.  It is built the first
+// time it is needed and memory-mapped read-only thereafter, so that evaluating
+// several assemblies against one reference does not sort the reference kmers
+// again each time.  A stored index that doesn't match the genome (by contig
+// sizes and a sample of bases) is rebuilt.
+
+#include "Basevector.h"
+#include "CoreTools.h"
+
+class genome_kmer_index {
+
+     public:
+
+     static const int K = 60;
+     static const int MinTail = 200;
+
+     // A 60-mer, packed two bits per base, first base highest, so that
+     // comparison of (hi,lo) is lexicographic comparison of the bases.  Bases
+     // 0-31 are in hi, bases 32-59 are in the top 56 bits of lo.
+
+     class key {
+
+          public:
+
+          key( ) : hi(0), lo(0) { }
+          key( const basevector& b, const int pos ) : hi(0), lo(0)
+          {    for ( int j = 0; j < K; j++ )
+                    Push( b[pos+j] );    }
+
+          // Drop the first base and append another.
+
+          void Push( const unsigned base )
+          {    hi = ( hi << 2 ) | ( lo >> 62 );
+               lo = ( lo << 2 ) | ( uint64_t(base) << 8 );    }
+
+          unsigned Prefix( const int n ) const { return hi >> ( 64 - 2*n ); }
+
+          // Return bases n through n+15, for n <= 16.
+
+          uint32_t Sig( const int n ) const { return hi >> ( 32 - 2*n ); }
+          unsigned Base( const int j ) const
+          {    return ( j < 32 ? hi >> ( 62 - 2*j ) 
+                    : lo >> ( 126 - 2*j ) ) & 3;    }
+
+          friend bool operator<( const key& k1, const key& k2 )
+          {    return k1.hi < k2.hi || ( k1.hi == k2.hi && k1.lo < k2.lo );    }
+          friend bool operator==( const key& k1, const key& k2 )
+          {    return k1.hi == k2.hi && k1.lo == k2.lo;    }
+
+          private:
+
+          uint64_t hi, lo;
+
+     };
+
+     struct entry {
+          uint32_t g;
+          uint32_t pos;
+          uint32_t sig;
+     };
+
+     // Build an index held in memory.
+
+     explicit genome_kmer_index( const vecbasevector& genome );
+
+     // Map the index stored for genome_file, building and storing it first if
+     // need be.
+
+     genome_kmer_index( const vecbasevector& genome, const String& genome_file );
+
+     ~genome_kmer_index( );
+
+     genome_kmer_index( const genome_kmer_index& ) = delete;
+     genome_kmer_index& operator=( const genome_kmer_index& ) = delete;
+
+     static String IndexFile( const String& genome_file )
+     {    return genome_file + ".k60idx";    }
+
+     int64_t size( ) const { return nentries_; }
+     const entry& operator[]( const int64_t i ) const { return entries_[i]; }
+
+     // Return the range [first,second) of entries whose 60-mer is x.
+
+     pair<int64_t,int64_t> Find( const key& x ) const;
+
+     const vecbasevector& Genome( ) const { return genome_; }
+
+     private:
+
+     struct header;
+
+     static int PrefixLen( const vecbasevector& genome );
+     static const int SigLen = 16;
+     static int64_t NPositions( const basevector& g )
+     {    return Max( 0, g.isize( ) - MinTail + 1 );    }
+     void Describe( header& h ) const;
+     key Key( const entry& x ) const { return key( genome_[x.g], x.pos ); }
+     int Compare( const entry& y, const key& x ) const;
+     Bool Load( const String& fn );
+     void Build( const String& fn );
+
+     const vecbasevector& genome_;
+     int prefix_len_;
+     int64_t nentries_;
+     const int64_t* bucket_starts_;
+     const entry* entries_;
+     vec<int64_t> own_bucket_starts_;
+     vec<entry> own_entries_;
+     void* mapped_;
+     size_t mapped_len_;
+
+};
+
+#endif
@@ -15,6 +15,7 @@
 #include "feudal/PQVec.h"
 #include "paths/HyperBasevector.h"
 #include "paths/long/ReadPath.h"
+#include "paths/long/ReadPathIndex.h"
 #include "paths/long/large/GapToyTools.h"
 #include "paths/long/large/Improve60.h"
 
@@ -31,8 +32,7 @@ void Improve60( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
 
      vec<int> to_left, to_right;
      hb.ToLeft(to_left), hb.ToRight(to_right);
-     VecULongVec paths_index;
-     invert( paths, paths_index, hb.EdgeObjectCount( ) );
+     ReadPathIndex paths_index( paths, hb.EdgeObjectCount( ) );
 
      // Find an edge e: v --> w that looks like junk, and for which w is a dead
      // end with only e entering.  Find an alternative path f = f1,...,fn 
@@ -0,0 +1,156 @@
+///////////////////////////////////////////////////////////////////////////////
+//                   SOFTWARE COPYRIGHT NOTICE AGREEMENT                     //
+//       This software and its documentation are copyright (2015) by the     //
+//   Broad Institute.  All rights are reserved.  This software is supplied   //
+//   without any warranty or guaranteed support whatsoever. The Broad        //
+//   Institute is not responsible for its use, misuse, or functionality.     //
+///////////////////////////////////////////////////////////////////////////////
+
+// MakeDepend: library OMP
+// MakeDepend: cflags OMP_FLAGS
+
+#include <sys/mman.h>
+
+#include "CoreTools.h"
+#include "feudal/BinaryStream.h"
+#include "paths/long/large/LineStore.h"
+#include "system/file/FileReader.h"
+#include "system/file/FileWriter.h"
+
+// File layout: a header, then the line, cell and path starts, then the edges.
+
+struct line_store::header {
+     uint64_t magic, version;
+     int64_t nlines, ncells, npaths, nedges;
+};
+
+namespace {
+
+const uint64_t LinesMagic = 0x53454e494c5a4147ul;
+const uint64_t LinesVersion = 1;
+
+// Replace counts held in x[1..n] by starts.
+
+void CountsToStarts( vec<int64_t>& x )
+{    x[0] = 0;
+     for ( int64_t i = 1; i < x.jsize( ); i++ )
+          x[i] += x[i-1];    }
+
+}
+
+line_store::line_store( ) : mapped_(0), mapped_len_(0)
+{    Clear( );    }
+
+line_store::line_store( const vec<vec<vec<vec<int>>>>& lines )
+     : mapped_(0), mapped_len_(0)
+{    Build(lines);    }
+
+line_store::~line_store( )
+{    if ( mapped_ ) munmap( mapped_, mapped_len_ );    }
+
+void line_store::Clear( )
+{    if ( mapped_ ) munmap( mapped_, mapped_len_ );
+     mapped_ = 0, mapped_len_ = 0;
+     own_line_starts_.assign( 1, 0 ), own_cell_starts_.assign( 1, 0 );
+     own_path_starts_.assign( 1, 0 );
+     own_edges_.clear( );
+     Install( );    }
+
+void line_store::Install( )
+{    nlines_ = own_line_starts_.jsize( ) - 1;
+     ncells_ = own_cell_starts_.jsize( ) - 1;
+     npaths_ = own_path_starts_.jsize( ) - 1;
+     nedges_ = own_edges_.jsize( );
+     line_starts_ = own_line_starts_.data( );
+     cell_starts_ = own_cell_starts_.data( );
+     path_starts_ = own_path_starts_.data( );
+     edges_ = own_edges_.data( );    }
+
+// Each level is sized by counting in parallel over lines, then turning the
+// counts into starts, so that every line knows where its cells, paths and edges
+// go before any are copied.
+
+void line_store::Build( const vec<vec<vec<vec<int>>>>& lines )
+{    Clear( );
+     const int64_t nlines = lines.size( );
+     vec<int64_t>& ls = own_line_starts_;
+     vec<int64_t>& cs = own_cell_starts_;
+     vec<int64_t>& ps = own_path_starts_;
+     ls.resize( nlines + 1 );
+     for ( int64_t i = 0; i < nlines; i++ )
+          ls[i+1] = lines[i].size( );
+     CountsToStarts(ls);
+     cs.resize( ls[nlines] + 1 );
+     #pragma omp parallel for schedule(dynamic, 1000)
+     for ( int64_t i = 0; i < nlines; i++ )
+     for ( int j = 0; j < lines[i].isize( ); j++ )
+          cs[ ls[i] + j + 1 ] = lines[i][j].size( );
+     CountsToStarts(cs);
+     ps.resize( cs.back( ) + 1 );
+     #pragma omp parallel for schedule(dynamic, 1000)
+     for ( int64_t i = 0; i < nlines; i++ )
+     for ( int j = 0; j < lines[i].isize( ); j++ )
+     for ( int k = 0; k < lines[i][j].isize( ); k++ )
+          ps[ cs[ ls[i] + j ] + k + 1 ] = lines[i][j][k].size( );
+     CountsToStarts(ps);
+     own_edges_.resize( ps.back( ) );
+     #pragma omp parallel for schedule(dynamic, 1000)
+     for ( int64_t i = 0; i < nlines; i++ )
+     for ( int j = 0; j < lines[i].isize( ); j++ )
+     for ( int k = 0; k < lines[i][j].isize( ); k++ )
+     {    const vec<int>& p = lines[i][j][k];
+          std::copy( p.begin( ), p.end( ),
+               own_edges_.begin( ) + ps[ cs[ ls[i] + j ] + k ] );    }
+     Install( );    }
+
+void line_store::Unpack( vec<vec<vec<vec<int>>>>& lines ) const
+{    lines.clear( );
+     lines.resize(nlines_);
+     #pragma omp parallel for schedule(dynamic, 1000)
+     for ( int64_t i = 0; i < nlines_; i++ )
+     {    line_ref L = (*this)[i];
+          lines[i].resize( L.size( ) );
+          for ( int j = 0; j < L.isize( ); j++ )
+          {    lines[i][j].resize( L[j].size( ) );
+               for ( int k = 0; k < L[j].isize( ); k++ )
+                    lines[i][j][k] = L[j][k].Vec( );    }    }    }
+
+void line_store::Write( const String& fn ) const
+{    header h;
+     h.magic = LinesMagic, h.version = LinesVersion;
+     h.nlines = nlines_, h.ncells = ncells_, h.npaths = npaths_;
+     h.nedges = nedges_;
+     FileWriter out(fn);
+     out.write( &h, sizeof(h) );
+     out.write( line_starts_, ( nlines_ + 1 ) * sizeof(int64_t) );
+     out.write( cell_starts_, ( ncells_ + 1 ) * sizeof(int64_t) );
+     out.write( path_starts_, ( npaths_ + 1 ) * sizeof(int64_t) );
+     out.write( edges_, nedges_ * sizeof(int) );    }
+
+void line_store::Read( const String& fn )
+{    Clear( );
+     header h;
+     size_t len;
+     {    FileReader fr(fn);
+          len = fr.getSize( );
+          if ( len >= sizeof(h) ) fr.read( &h, sizeof(h) );    }
+     if ( len < sizeof(h) || h.magic != LinesMagic )
+     {    vec<vec<vec<vec<int>>>> lines;
+          BinaryReader::readFile( fn, &lines );
+          Build(lines);
+          return;    }
+     if ( h.version != LinesVersion )
+          FatalErr( fn << " has lines format version " << h.version << "." );
+     if ( len != sizeof(h) + ( h.nlines + h.ncells + h.npaths + 3 )
+          * sizeof(int64_t) + h.nedges * sizeof(int) )
+     {    FatalErr( fn << " appears to be truncated." );    }
+     FileReader fr(fn);
+     mapped_len_ = len;
+     mapped_ = fr.map( 0, len, true );
+     nlines_ = h.nlines, ncells_ = h.ncells, npaths_ = h.npaths;
+     nedges_ = h.nedges;
+     line_starts_ = reinterpret_cast<const int64_t*>(
+          static_cast<const char*>(mapped_) + sizeof(h) );
+     cell_starts_ = line_starts_ + nlines_ + 1;
+     path_starts_ = cell_starts_ + ncells_ + 1;
+     edges_ = reinterpret_cast<const int*>( path_starts_ + npaths_ + 1 );    }
@@ -0,0 +1,160 @@
+///////////////////////////////////////////////////////////////////////////////
+//                   SOFTWARE COPYRIGHT NOTICE AGREEMENT                     //
+//       This software and its documentation are copyright (2015) by the     //
+//   Broad Institute.  All rights are reserved.  This software is supplied   //
+//   without any warranty or guaranteed support whatsoever. The Broad        //
+//   Institute is not responsible for its use, misuse, or functionality.     //
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef GAPTOY_LINE_STORE_H
+#define GAPTOY_LINE_STORE_H
+
+// A line_store holds the same data as a vec<vec<vec<vec<int>>>> of lines (see
+// Lines.h), but flattened: all the edge ids are in one array, and there is an
+// array of starts for each level, so that line i consists of cells
+// line_starts[i] through line_starts[i+1]-1, cell c consists of paths
+// cell_starts[c] through cell_starts[c+1]-1, and path p consists of edges
+// path_starts[p] through path_starts[p+1]-1.  Thus the edges of a line are
+// contiguous, as are its paths and cells.
+//
+// The a.lines file is a header followed by the four arrays, so it can be
+// memory-mapped and used in place.  Read also accepts an old a.lines file, which
+// was a vec^4 written by BinaryWriter, and packs it.
+//
+// Lines, cells and paths are accessed through small proxy objects that support
+// the operations used on the nested form: size, isize, solo, operator[], front
+// and back.
+
+#include "CoreTools.h"
+
+class line_store {
+
+     public:
+
+     class path_ref {
+
+          public:
+
+          typedef const int* const_iterator;
+
+          path_ref( const int* b, const int* e ) : b_(b), e_(e) { }
+
+          const_iterator begin( ) const { return b_; }
+          const_iterator end( ) const { return e_; }
+          size_t size( ) const { return e_ - b_; }
+          int isize( ) const { return e_ - b_; }
+          Bool empty( ) const { return b_ == e_; }
+          Bool nonempty( ) const { return b_ != e_; }
+          Bool solo( ) const { return e_ - b_ == 1; }
+          int operator[]( const int k ) const { return b_[k]; }
+          int front( ) const { return *b_; }
+          int back( ) const { return e_[-1]; }
+          vec<int> Vec( ) const { return vec<int>( b_, e_ ); }
+
+          private:
+
+          const int *b_, *e_;
+
+     };
+
+     class cell_ref {
+
+          public:
+
+          cell_ref( const line_store& s, const int64_t b, const int64_t e )
+               : s_(&s), b_(b), e_(e) { }
+
+          size_t size( ) const { return e_ - b_; }
+          int isize( ) const { return e_ - b_; }
+          Bool empty( ) const { return b_ == e_; }
+          Bool solo( ) const { return e_ - b_ == 1; }
+          path_ref operator[]( const int j ) const { return s_->Path( b_ + j ); }
+          path_ref front( ) const { return s_->Path(b_); }
+          path_ref back( ) const { return s_->Path( e_ - 1 ); }
+
+          private:
+
+          const line_store* s_;
+          int64_t b_, e_;
+
+     };
+
+     class line_ref {
+
+          public:
+
+          line_ref( const line_store& s, const int64_t b, const int64_t e )
+               : s_(&s), b_(b), e_(e) { }
+
+          size_t size( ) const { return e_ - b_; }
+          int isize( ) const { return e_ - b_; }
+          Bool empty( ) const { return b_ == e_; }
+          Bool solo( ) const { return e_ - b_ == 1; }
+          cell_ref operator[]( const int j ) const { return s_->Cell( b_ + j ); }
+          cell_ref front( ) const { return s_->Cell(b_); }
+          cell_ref back( ) const { return s_->Cell( e_ - 1 ); }
+
+          private:
+
+          const line_store* s_;
+          int64_t b_, e_;
+
+     };
+
+     line_store( );
+     explicit line_store( const vec<vec<vec<vec<int>>>>& lines );
+     ~line_store( );
+
+     line_store( const line_store& ) = delete;
+     line_store& operator=( const line_store& ) = delete;
+
+     // Pack nested lines, in parallel.
+
+     void Build( const vec<vec<vec<vec<int>>>>& lines );
+
+     // Rebuild the nested form.
+
+     void Unpack( vec<vec<vec<vec<int>>>>& lines ) const;
+
+     // Write an a.lines file, or map one (packing it if it has the old format).
+
+     void Write( const String& fn ) const;
+     void Read( const String& fn );
+
+     size_t size( ) const { return nlines_; }
+     int isize( ) const { return nlines_; }
+     Bool empty( ) const { return nlines_ == 0; }
+     Bool nonempty( ) const { return nlines_ > 0; }
+
+     line_ref operator[]( const int64_t i ) const
+     {    return line_ref( *this, line_starts_[i], line_starts_[i+1] );    }
+     cell_ref Cell( const int64_t c ) const
+     {    return cell_ref( *this, cell_starts_[c], cell_starts_[c+1] );    }
+     path_ref Path( const int64_t p ) const
+     {    return path_ref(
+               edges_ + path_starts_[p], edges_ + path_starts_[p+1] );    }
+
+     // The edges of line i, in order, as a single run.
+
+     path_ref Edges( const int64_t i ) const
+     {    return path_ref( edges_ + path_starts_[ cell_starts_[ line_starts_[i] ] ],
+               edges_ + path_starts_[ cell_starts_[ line_starts_[i+1] ] ] );    }
+
+     private:
+
+     struct header;
+
+     void Clear( );
+     void Install( );
+
+     int64_t nlines_, ncells_, npaths_, nedges_;
+     const int64_t *line_starts_, *cell_starts_, *path_starts_;
+     const int* edges_;
+     vec<int64_t> own_line_starts_, own_cell_starts_, own_path_starts_;
+     vec<int> own_edges_;
+     void* mapped_;
+     size_t mapped_len_;
+
+};
+
+#endif
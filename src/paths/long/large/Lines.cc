@@ -15,6 +15,7 @@
 #include "graph/FindCells.h"
 #include "paths/HyperBasevector.h"
 #include "paths/long/ReadPath.h"
+#include "paths/long/ReadPathIndex.h"
 #include "paths/long/large/GapToyTools.h"
 #include "paths/long/large/Lines.h"
 #include "paths/long/large/CN1PeakFinder.h"
@@ -336,6 +337,18 @@ void GetTol( const HyperBasevectorX& hb,
      for ( int l = 0; l < lines[i][j][k].isize( ); l++ )
           tol[ lines[i][j][k][l] ] = i;    }
 
+void GetTol( const HyperBasevector& hb, const line_store& lines, vec<int>& tol )
+{
+     tol.resize_and_set( hb.EdgeObjectCount( ), -1 );
+     for ( int i = 0; i < lines.isize( ); i++ )
+          for ( int e : lines.Edges(i) ) tol[e] = i;    }
+
+void GetTol( const HyperBasevectorX& hb, const line_store& lines, vec<int>& tol )
+{
+     tol.resize_and_set( hb.E( ), -1 );
+     for ( int i = 0; i < lines.isize( ); i++ )
+          for ( int e : lines.Edges(i) ) tol[e] = i;    }
+
 void GetLineNpairs( const HyperBasevector& hb, const vec<int>& inv,
      const ReadPathVec& paths, const vec<vec<vec<vec<int>>>>& lines, 
      vec<int>& npairs )
@@ -388,7 +401,8 @@ int64_t LineN50( const HyperBasevector& hb,
      return N50(lens);    }
 
 vec<int64_t> Pids( const int e, const int ss, const HyperBasevector& hb, 
-     const vec<int>& inv, const ReadPathVec& paths, const VecULongVec& paths_index,
+     const vec<int>& inv, const ReadPathVec& paths,
+     const ReadPathIndex& paths_index,
      const vec<int64_t>& subsam_starts )
 {    vec<int64_t> pids;
      int ns = subsam_starts.size( );
@@ -404,7 +418,8 @@ vec<int64_t> Pids( const int e, const int ss, const HyperBasevector& hb,
      return pids;    }
 
 vec<int64_t> Pids( const int e, const HyperBasevector& hb, 
-     const vec<int>& inv, const ReadPathVec& paths, const VecULongVec& paths_index )
+     const vec<int>& inv, const ReadPathVec& paths,
+     const ReadPathIndex& paths_index )
 {    vec<int64_t> pids;
      for ( int pass = 1; pass <= 2; pass++ )
      {    int d = ( pass == 1 ? e : inv[e] );
@@ -415,7 +430,8 @@ vec<int64_t> Pids( const int e, const HyperBasevector& hb,
      return pids;    }
 
 vec<int64_t> LinePids( const vec<vec<vec<int>>>& L, const HyperBasevector& hb, 
-     const vec<int>& inv, const ReadPathVec& paths, const VecULongVec& paths_index )
+     const vec<int>& inv, const ReadPathVec& paths,
+     const ReadPathIndex& paths_index )
 {    vec<int64_t> pids;
      vec<int> e;
      for ( int i1 = 0; i1 < L.isize( ); i1++ )
@@ -429,13 +445,15 @@ vec<int64_t> LinePids( const vec<vec<vec<int>>>& L, const HyperBasevector& hb,
      return pids;    }
 
 double RawCoverage( const int e, const int ss, const HyperBasevector& hb, 
-     const vec<int>& inv, const ReadPathVec& paths, const VecULongVec& paths_index,
+     const vec<int>& inv, const ReadPathVec& paths,
+     const ReadPathIndex& paths_index,
      const vec<int64_t>& subsam_starts )
 {    vec<int64_t> pids = Pids( e, ss, hb, inv, paths, paths_index, subsam_starts );
      return pids.size( ) / double( hb.Kmers(e) );    }
 
 double RawCoverage( const int e, const HyperBasevector& hb, 
-     const vec<int>& inv, const ReadPathVec& paths, const VecULongVec& paths_index )
+     const vec<int>& inv, const ReadPathVec& paths,
+     const ReadPathIndex& paths_index )
 {    vec<int64_t> pids = Pids( e, hb, inv, paths, paths_index );
      return pids.size( ) / double( hb.Kmers(e) );    }
 
@@ -450,8 +468,7 @@ void ComputeCoverage( const HyperBasevector& hb, const vec<int>& inv,
 
      // Index paths (better done outside this program).
 
-     VecULongVec paths_index;
-     invert( paths, paths_index, hb.EdgeObjectCount( ) );
+     ReadPathIndex paths_index( paths, hb.EdgeObjectCount( ) );
 
      // Compute pairs touching each line.
 
@@ -685,8 +702,7 @@ void DumpLineFiles( const vec<vec<vec<vec<int>>>>& lines, const HyperBasevector&
 
      vec<int> to_left, to_right;
      hb.ToLeft(to_left), hb.ToRight(to_right);
-     VecULongVec paths_index;
-     invert( paths, paths_index, hb.E( ) );
+     ReadPathIndex paths_index( paths, hb.E( ) );
      Ofstream( out1, dir + "/a.lines.efasta" );
      Ofstream( out2, dir + "/a.lines.fasta" );
      for ( int i = 0; i < lines.isize( ); i++ )
@@ -12,6 +12,8 @@
 #include "CoreTools.h"
 #include "paths/HyperBasevector.h"
 #include "paths/long/ReadPath.h"
+#include "paths/long/ReadPathIndex.h"
+#include "paths/long/large/LineStore.h"
 
 // Description of lines data structure:
 //
@@ -35,6 +37,9 @@
 // more edges (e.g. three, with two in a bubble), then the line has the same
 // starting and ending edges (i.e. the same edge appears twice).  The fasta/efasta
 // representation of lines in DumpLineFiles takes account of this.
+//
+// The same data may be held flat, in a line_store (see LineStore.h), which is
+// how a.lines is written and read.
 
 typedef vec<int> LinePath; // elements are edgeIds
 typedef vec<LinePath> LineSegment; // aka, a Cell
@@ -71,8 +76,10 @@ void FindLines( const HyperBasevector& hb, const vec<int>& inv,
 int64_t LineN50( const HyperBasevector& hb, 
      const vec<vec<vec<vec<int>>>>& lines, const int min_len );
 
-template <class EdgeRuler> // given an edge ID, returns its length
-int GetPathLength( LinePath const& path, EdgeRuler ruler, int upTo = -1 ) {
+// These accept nested lines or a line_store.
+
+template <class PathT, class EdgeRuler> // given an edge ID, returns its length
+int GetPathLength( PathT const& path, EdgeRuler ruler, int upTo = -1 ) {
     int sum = 0;
     for ( int edgeId : path ) {
         if ( upTo != -1 && edgeId == upTo ) break;
@@ -81,31 +88,32 @@ int GetPathLength( LinePath const& path, EdgeRuler ruler, int upTo = -1 ) {
     return sum;
 }
 
-template <class EdgeRuler>
-int GetSegmentLength( LineSegment const& seg, EdgeRuler ruler )
+template <class SegmentT, class EdgeRuler>
+int GetSegmentLength( SegmentT const& seg, EdgeRuler ruler )
 { size_t nPaths = seg.size(); ForceAssertGt(nPaths,0ul);
   if ( nPaths == 1ul ) return GetPathLength(seg.front(),ruler);
   if ( nPaths == 2ul )
     return (GetPathLength(seg.front(),ruler)+GetPathLength(seg.back(),ruler))/2;
-  vec<int> pathLens; pathLens.reserve(seg.size());
-  std::transform(seg.begin(),seg.end(),std::back_inserter(pathLens),
-          [ruler]( LinePath const& path ){ return GetPathLength(path,ruler); });
+  vec<int> pathLens; pathLens.reserve(nPaths);
+  for ( size_t idx = 0; idx != nPaths; ++idx )
+    pathLens.push_back(GetPathLength(seg[idx],ruler));
   // return the median segment path length
   std::sort(pathLens.begin(),pathLens.end());
   if ( nPaths&1ul ) return pathLens[nPaths/2];
   return (pathLens[nPaths/2]+pathLens[nPaths/2-1])/2; }
 
-template <class EdgeRuler>
-int GetLineLength( Line const& line, EdgeRuler ruler )
+template <class LineT, class EdgeRuler>
+int GetLineLength( LineT const& line, EdgeRuler ruler )
 { int sum = 0;
-  for ( LineSegment const& seg : line ) sum += GetSegmentLength(seg,ruler);
+  for ( size_t idx = 0; idx != line.size(); ++idx )
+    sum += GetSegmentLength(line[idx],ruler);
   return sum; }
 
-template <class EdgeRuler>
-void GetLineLengths( LineVec const& lines, vec<int>& llens, EdgeRuler ruler )
+template <class LineVecT, class EdgeRuler>
+void GetLineLengths( LineVecT const& lines, vec<int>& llens, EdgeRuler ruler )
 { llens.clear(); llens.reserve(lines.size());
-  std::transform(lines.begin(),lines.end(),std::back_inserter(llens),
-          [ruler]( Line const& line ){ return GetLineLength(line,ruler); }); }
+  for ( size_t idx = 0; idx != lines.size(); ++idx )
+    llens.push_back(GetLineLength(lines[idx],ruler)); }
 
 struct HBVKmerRuler
 { HBVKmerRuler(HyperBasevector const& hbv) : mHBV(hbv) {}
@@ -116,6 +124,10 @@ inline void GetLineLengths( HyperBasevector const& hb, LineVec const& lines,
                                 vec<int>& llens )
 { GetLineLengths(lines,llens,HBVKmerRuler(hb)); }
 
+inline void GetLineLengths( HyperBasevector const& hb, line_store const& lines,
+                                vec<int>& llens )
+{ GetLineLengths(lines,llens,HBVKmerRuler(hb)); }
+
 struct HBVXKmerRuler
 { HBVXKmerRuler(HyperBasevectorX const& hbvx ) : mHBVX(hbvx) {}
   int operator()( int edgeId ) { return mHBVX.Kmers(edgeId); }
@@ -125,12 +137,20 @@ inline void GetLineLengths( HyperBasevectorX const& hb, LineVec const& lines,
                                 vec<int>& llens )
 { GetLineLengths(lines,llens,HBVXKmerRuler(hb)); }
 
+inline void GetLineLengths( HyperBasevectorX const& hb, line_store const& lines,
+                                vec<int>& llens )
+{ GetLineLengths(lines,llens,HBVXKmerRuler(hb)); }
+
 void GetTol( const HyperBasevector& hb,
      const vec<vec<vec<vec<int>>>>& lines, vec<int>& tol );
 
 void GetTol( const HyperBasevectorX& hb,
      const vec<vec<vec<vec<int>>>>& lines, vec<int>& tol );
 
+void GetTol( const HyperBasevector& hb, const line_store& lines, vec<int>& tol );
+
+void GetTol( const HyperBasevectorX& hb, const line_store& lines, vec<int>& tol );
+
 void GetLineNpairs( const HyperBasevector& hb, const vec<int>& inv,
      const ReadPathVec& paths, const vec<vec<vec<vec<int>>>>& lines, 
      vec<int>& npairs );
@@ -143,21 +163,26 @@ void WriteLineStats( const String& head, const vec<vec<vec<vec<int>>>>& lines,
 void DisplayLine(const vec<vec<vec<int>>>& line);
 
 vec<int64_t> Pids( const int e, const int ss, const HyperBasevector& hb,
-     const vec<int>& inv, const ReadPathVec& paths, const VecULongVec& paths_index,
+     const vec<int>& inv, const ReadPathVec& paths,
+     const ReadPathIndex& paths_index,
      const vec<int64_t>& subsam_starts );
 
 vec<int64_t> Pids( const int e, const HyperBasevector& hb,
-     const vec<int>& inv, const ReadPathVec& paths, const VecULongVec& paths_index );
+     const vec<int>& inv, const ReadPathVec& paths,
+     const ReadPathIndex& paths_index );
 
 vec<int64_t> LinePids( const vec<vec<vec<int>>>& L, const HyperBasevector& hb,
-     const vec<int>& inv, const ReadPathVec& paths, const VecULongVec& paths_index );
+     const vec<int>& inv, const ReadPathVec& paths,
+     const ReadPathIndex& paths_index );
 
 double RawCoverage( const int e, const int ss, const HyperBasevector& hb,
-     const vec<int>& inv, const ReadPathVec& paths, const VecULongVec& paths_index,
+     const vec<int>& inv, const ReadPathVec& paths,
+     const ReadPathIndex& paths_index,
      const vec<int64_t>& subsam_starts );
 
 double RawCoverage( const int e, const HyperBasevector& hb,
-     const vec<int>& inv, const ReadPathVec& paths, const VecULongVec& paths_index );
+     const vec<int>& inv, const ReadPathVec& paths,
+     const ReadPathIndex& paths_index );
 
 void ComputeCoverage( const HyperBasevector& hb, const vec<int>& inv, 
      const ReadPathVec& paths, const vec<vec<vec<vec<int>>>>& lines,
@@ -27,8 +27,8 @@ void MakeGaps( HyperBasevector& hb, vec<int>& inv, ReadPathVec& paths,
      double clock = WallClockTime( );
      vec<int> to_left, to_right;
      hb.ToLeft(to_left), hb.ToRight(to_right);
-     vec<vec<vec<vec<int>>>> lines;
-     BinaryReader::readFile( work_dir + "/a." + FIN + "/a.lines", &lines );
+     line_store lines;
+     lines.Read( work_dir + "/a." + FIN + "/a.lines" );
      vec<int> llens, npairs;
      GetLineLengths( hb, lines, llens );
      BinaryReader::readFile( work_dir + "/a." + FIN + "/a.lines.npairs", &npairs );
@@ -170,10 +170,8 @@ void Preclose( vecbvec const& bases, VecPQVec const& quals,
      // Add to pids.  This does not necessarily help.
 
      int nedges = hb.EdgeObjectCount( );
-     vec< vec<int> > layout_pos(nedges); 
-     vec< vec<int64_t> > layout_id(nedges);
-     vec< vec<Bool> > layout_or(nedges);
-     LayoutReads( hb, inv, bases, paths, layout_pos, layout_id, layout_or );
+     read_layout layout;
+     LayoutReads( hb, inv, bases, paths, layout );
      {
      vec< pair<vec<int>,vec<int>> > pairs;
      vec<int64_t> pairs_pid;
@@ -195,16 +193,16 @@ void Preclose( vecbvec const& bases, VecPQVec const& quals,
      {    const int lroot = edge_pairs[ei].first, rroot = edge_pairs[ei].second;
           const int max_delta = 120;
           vec<int> pids1, pids2;
-          for ( int k = layout_pos[lroot].isize( ) - 1; k >= 0; k-- )
-          {    int pos = layout_pos[lroot][k]; 
-               int id = layout_id[lroot][k];
+          for ( int64_t k = layout.Count(lroot) - 1; k >= 0; k-- )
+          {    int pos = layout.Place( lroot, k ).pos; 
+               int id = layout.Place( lroot, k ).id;
                if ( pos + bases[id].isize( ) 
                     < hb.EdgeLengthBases(lroot) - max_delta ) 
                {    break;    }
                pids1.push_back(id/2);    }
-          for ( int k = 0; k < layout_pos[rroot].isize( ); k++ )
-          {    int pos = layout_pos[rroot][k]; 
-               int id = layout_id[rroot][k];
+          for ( int64_t k = 0; k < layout.Count(rroot); k++ )
+          {    int pos = layout.Place( rroot, k ).pos; 
+               int id = layout.Place( rroot, k ).id;
                if ( pos > max_delta ) break;
                pids1.push_back(id/2);    }
           UniqueSort(pids1);
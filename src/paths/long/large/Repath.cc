@@ -18,6 +18,7 @@
 #include "paths/long/LongReadsToPaths.h"
 #include "paths/long/LongProtoTools.h"
 #include "paths/long/ReadPath.h"
+#include "paths/long/ReadPathIndex.h"
 #include "system/SortInPlace.h"
 
 void Repath( const HyperBasevector& hb, const vecbasevector& edges, 
@@ -250,6 +251,5 @@ void Repath( const HyperBasevector& hb, const vecbasevector& edges,
           paths2.WriteAll( BIGKHBV0 + ".paths" );
           if ( INVERT_PATHS )
           {
-              VecULongVec invPaths;
-              invert( paths2, invPaths, hb2.EdgeObjectCount( ) );
+              ReadPathIndex invPaths( paths2, hb2.EdgeObjectCount( ) );
               invPaths.WriteAll( BIGKHBV0+".paths.inv" );   }    }    }
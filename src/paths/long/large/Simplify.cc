@@ -13,6 +13,7 @@
 #include "Qualvector.h"
 #include "paths/HyperBasevector.h"
 #include "paths/long/ReadPath.h"
+#include "paths/long/ReadPathIndex.h"
 #include "paths/long/large/GapToyTools.h"
 #include "paths/long/large/ImprovePath.h"
 #include "paths/long/large/PullAparter.h"
@@ -149,7 +150,7 @@ void Simplify( const String& fin_dir, HyperBasevector& hb, vec<int>& inv,
 
      {    cout << Date() << ": making paths index for pull apart" << endl;
           VecULongVec invPaths;
-          invert( paths, invPaths, hb.EdgeObjectCount( ) );
+          ReadPathIndex( paths, hb.EdgeObjectCount( ) ).unpack( &invPaths );
           cout << Date() << ": pulling apart repeats" << endl;
           PullAparter pa(hb,inv,paths,invPaths,PULL_APART_TRACE,
                   PULL_APART_VERBOSE,5,5.0, true, true, true, true);
@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////////
+//                   SOFTWARE COPYRIGHT NOTICE AGREEMENT                     //
+//       This software and its documentation are copyright (2015) by the     //
+//   Broad Institute.  All rights are reserved.  This software is supplied   //
+//   without any warranty or guaranteed support whatsoever. The Broad        //
+//   Institute is not responsible for its use, misuse, or functionality.     //
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+
+#include "CoreTools.h"
+#include "paths/long/large/StageManifest.h"
+
+// Manifest format: one line per completed stage, of the form
+//      stage_name checksum nfiles file1 size1 ... filen sizen
+
+String stage_manifest::Name( const int s )
+{    static const char* names[NSTAGES]
+          = { "LOADED", "BUILT200", "PATCHES", "PATCHED", "FIN", "DONE" };
+     return ( s >= 0 && s < NSTAGES ? names[s] : "NONE" );    }
+
+stage_manifest::stage_manifest( const String& work_dir ) : work_dir_(work_dir)
+{    recorded_.resize( NSTAGES, False );
+     checksum_.resize( NSTAGES, 0 );
+     files_.resize(NSTAGES);
+     Read( );    }
+
+void stage_manifest::Clear( )
+{    for ( int s = 0; s < NSTAGES; s++ )
+     {    recorded_[s] = False;
+          checksum_[s] = 0;
+          files_[s].clear( );    }
+     Remove( work_dir_ + "/stages" );    }
+
+void stage_manifest::Record( const stage s, const int64_t checksum,
+     const vec<String>& files )
+{    for ( int t = s; t < NSTAGES; t++ )
+     {    recorded_[t] = False;
+          files_[t].clear( );    }
+     recorded_[s] = True;
+     checksum_[s] = checksum;
+     for ( int j = 0; j < files.isize( ); j++ )
+     {    String fn = work_dir_ + "/" + files[j];
+          ForceAssert( IsRegularFile(fn) );
+          files_[s].push( files[j], FileSize(fn) );    }
+     Write( );
+     cout << Date( ) << ": recorded completion of stage " << Name(s) << endl;    }
+
+int stage_manifest::LastValid( ) const
+{    int last = -1;
+     for ( int s = 0; s < NSTAGES; s++ )
+     {    if ( !recorded_[s] ) continue;
+          for ( int j = 0; j < files_[s].isize( ); j++ )
+          {    String fn = work_dir_ + "/" + files_[s][j].first;
+               if ( !IsRegularFile(fn) || FileSize(fn) != files_[s][j].second )
+               {    cout << "Checkpoint file " << fn << " for stage " << Name(s)
+                         << " is missing or has the wrong size." << endl;
+                    return last;    }    }
+          last = s;    }
+     return last;    }
+
+void stage_manifest::Verify( const stage s, const int64_t checksum ) const
+{    if ( !recorded_[s] || checksum == checksum_[s] ) return;
+     cout << "\nThe checksum " << checksum << " for the reloaded stage " << Name(s)
+          << " does not match\nthe checksum " << checksum_[s] << " recorded in "
+          << work_dir_ << "/stages.\nPlease rerun without RESUME=True." << endl;
+     Scram(1);    }
+
+void stage_manifest::Read( )
+{    String fn = work_dir_ + "/stages";
+     if ( !IsRegularFile(fn) ) return;
+     Ifstream( in, fn );
+     String name;
+     while( in >> name )
+     {    int64_t checksum;
+          int nfiles;
+          in >> checksum >> nfiles;
+          if ( in.fail( ) ) break;
+          int s;
+          for ( s = 0; s < NSTAGES; s++ )
+               if ( Name(s) == name ) break;
+          vec< pair<String,int64_t> > files(nfiles);
+          for ( int j = 0; j < nfiles; j++ )
+               in >> files[j].first >> files[j].second;
+          if ( in.fail( ) || s == NSTAGES ) break;
+          recorded_[s] = True;
+          checksum_[s] = checksum;
+          files_[s] = files;    }    }
+
+void stage_manifest::Write( ) const
+{    String fn = work_dir_ + "/stages", tmp = fn + ".tmp";
+     {    Ofstream( out, tmp );
+          for ( int s = 0; s < NSTAGES; s++ )
+          {    if ( !recorded_[s] ) continue;
+               out << Name(s) << " " << checksum_[s] << " " << files_[s].size( );
+               for ( int j = 0; j < files_[s].isize( ); j++ )
+               {    out << " " << files_[s][j].first
+                         << " " << files_[s][j].second;    }
+               out << "\n";    }    }
+     if ( std::rename( tmp.c_str( ), fn.c_str( ) ) != 0 )
+          FatalErr( "Unable to rename " << tmp << " to " << fn << "." );    }
@@ -0,0 +1,70 @@
+///////////////////////////////////////////////////////////////////////////////
+//                   SOFTWARE COPYRIGHT NOTICE AGREEMENT                     //
+//       This software and its documentation are copyright (2015) by the     //
+//   Broad Institute.  All rights are reserved.  This software is supplied   //
+//   without any warranty or guaranteed support whatsoever. The Broad        //
+//   Institute is not responsible for its use, misuse, or functionality.     //
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef STAGE_MANIFEST_H
+#define STAGE_MANIFEST_H
+
+// A stage_manifest records in work_dir/stages which major stages of a
+// DiscovarDeNovo run have completed.  For each stage we keep a checksum (e.g.
+// hb.CheckSum( ) for the assembly written by that stage) and the names and sizes
+// of the files that a restart from that stage needs.  This allows RESUME=True to
+// pick up an interrupted run from the last intact stage.
+//
+// The manifest is a small text file, rewritten in full (via rename) each time a
+// stage is recorded, so that a crash while writing it cannot leave it corrupt.
+
+#include "CoreTools.h"
+
+class stage_manifest {
+
+     public:
+
+     // Stages, in pipeline order.  A later stage implies the earlier ones.
+
+     enum stage { LOADED, BUILT200, PATCHES, PATCHED, FIN, DONE, NSTAGES };
+
+     static String Name( const int s );
+
+     explicit stage_manifest( const String& work_dir );
+
+     // Forget all stages, as appropriate for a fresh run.
+
+     void Clear( );
+
+     // Mark stage s as complete.  File names are relative to work_dir.  Any
+     // stages after s are forgotten, since they were derived from older data.
+
+     void Record( const stage s, const int64_t checksum, const vec<String>& files );
+
+     Bool Recorded( const stage s ) const { return recorded_[s]; }
+     int64_t Checksum( const stage s ) const { return checksum_[s]; }
+
+     // Return the last stage such that it and all recorded stages before it have
+     // their files intact, or -1 if there is no such stage.  Problems are
+     // reported to cout.
+
+     int LastValid( ) const;
+
+     // Verify that the checksum computed after reloading stage s matches the
+     // recorded one, and exit if not.
+
+     void Verify( const stage s, const int64_t checksum ) const;
+
+     private:
+
+     void Read( );
+     void Write( ) const;
+
+     String work_dir_;
+     vec<Bool> recorded_;
+     vec<int64_t> checksum_;
+     vec< vec< pair<String,int64_t> > > files_;
+
+};
+
+#endif
@@ -14,6 +14,7 @@
 #include "Qualvector.h"
 #include "VecUtilities.h"
 #include "feudal/PQVec.h"
+#include "paths/long/PackedReadPathVec.h"
 #include "paths/long/ReadPath.h"
 
 int main(int argc, char *argv[])
@@ -108,9 +109,8 @@ int main(int argc, char *argv[])
      vec<int64_t> ids;
      for ( int i = 0; i < npids; i++ )
           ids.push_back( 2*pids[i], 2*pids[i] + 1 );
-     ReadPathVec p;
-
-     int64_t nreads = MastervecFileObjectCount( DIR + "/a.paths" );
+     PackedReadPathVec paths( DIR + "/a.paths" );
+     int64_t nreads = paths.size( );
      for ( int i = 0; i < ids.isize( ); i++ )
      {    if ( ids[i] < 0 )
           {    cout << "\nRead id " << ids[i] << " is negative." << endl;
@@ -119,7 +119,6 @@ int main(int argc, char *argv[])
           {    cout << "\nRead id " << ids[i] << " is >= nreads = " << nreads
                     << "." << endl;
                Scram(1);    }    }
-     p.Read( DIR + "/a.paths", ids );
 
      // Display results.
 
@@ -127,7 +126,8 @@ int main(int argc, char *argv[])
      vec< quad< vec<int>, vec<int>, int, Bool > > stuff;
      int bads = 0;
      for ( int i = 0; i < npids; i++ )
-     {    const ReadPath &p1 = p[2*i], &p2 = p[2*i+1];
+     {    PackedReadPathVec::Path p1 = paths[ 2*pids[i] ];
+          PackedReadPathVec::Path p2 = paths[ 2*pids[i] + 1 ];
           Bool bad = False;
           for ( int i = 0; i < (int) p1.size( ); i++ )
                if ( p1[i] >= inv.isize( ) ) bad = True;
@@ -224,13 +224,15 @@ int main(int argc, char *argv[])
                if (OUT_ORIENT)
                {    for ( int i = 0; i < ids.isize( ); i += 2 )
                     {    int id1 = ids[i], id2 = ids[i] + 1;
+                         PackedReadPathVec::Path p1 = paths[id1];
+                         PackedReadPathVec::Path p2 = paths[id2];
                          Bool fw1 = False, fw2 = False;
-                         for ( int j = 0; j < (int) p[i].size( ); j++ )
-                         {    if ( Member( e, p[i][j] ) ) fw1 = True;
-                              if ( Member( e, inv[p[i][j]] ) ) fw2 = True;    }
-                         for ( int j = 0; j < (int) p[i+1].size( ); j++ )
-                         {    if ( Member( e, p[i+1][j] ) ) fw2 = True;
-                              if ( Member( e, inv[p[i+1][j]] ) ) fw1 = True;    }
+                         for ( int j = 0; j < (int) p1.size( ); j++ )
+                         {    if ( Member( e, p1[j] ) ) fw1 = True;
+                              if ( Member( e, inv[p1[j]] ) ) fw2 = True;    }
+                         for ( int j = 0; j < (int) p2.size( ); j++ )
+                         {    if ( Member( e, p2[j] ) ) fw2 = True;
+                              if ( Member( e, inv[p2[j]] ) ) fw1 = True;    }
                          if ( fw2 && !fw1 )
                          {    swap( nid[i], nid[i+1] );
                               swap( qualsx[i], qualsx[i+1] );    }    }    }
@@ -251,7 +253,8 @@ int main(int argc, char *argv[])
           vecbasevector edges;
           edges.Read( DIR + "/a.fastb", eplus );
           for ( int i = 0; i < npids; i++ )
-          {    const ReadPath &p1 = p[2*i], &p2 = p[2*i+1];
+          {    PackedReadPathVec::Path p1 = paths[ 2*pids[i] ];
+               PackedReadPathVec::Path p2 = paths[ 2*pids[i] + 1 ];
                int pid = pids[i];
                Bool problems = False;
                ostringstream out;
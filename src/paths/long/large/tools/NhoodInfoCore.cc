@@ -174,7 +174,7 @@ void NhoodInfoEngine::Initialize(const String& DIR_IN, const bool SEQ_LOOKUP,
      // Load lines if available.
 
      if ( IsRegularFile( DIR_IN + "/a.lines" ) )
-	 {    BinaryReader::readFile( head + ".lines", &lines );
+	 {    lines.Read( head + ".lines" );
 	     GetTol( hb, lines, tol );
 	     GetLineLengths( hb, lines, llens );    }
      else if (EXT)
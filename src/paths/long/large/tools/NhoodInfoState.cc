@@ -11,6 +11,7 @@
 #include "TokenizeString.h"
 #include "pairwise_aligners/SmithWatAffine.h"
 #include "paths/HyperBasevector.h"
+#include "paths/long/PackedReadPathVec.h"
 #include "paths/long/ReadPath.h"
 #include "paths/long/large/tools/NhoodInfoState.h"
 
@@ -116,19 +117,19 @@ Bool nhood_info_state::SetState( const String & line, ostream& out,
           {    out << "I can't run this command without having the file a.paths."
                     << endl;
                return False;    }
-          int64_t N = MastervecFileObjectCount(paths);
+          PackedReadPathVec pv(paths);
+          int64_t N = pv.size( );
           if ( rid < 0 || rid >= N )
           {    out << "That read id doesn't make sense." << endl;
                return False;    }
-          ReadPathVec p;
-          p.ReadOne( paths, rid );
-          if ( p[0].size( ) == 0 ) out << "unplaced" << endl;
+          PackedReadPathVec::Path p = pv[rid];
+          if ( p.size( ) == 0 ) out << "unplaced" << endl;
           else
-          {    int offset = p[0].getOffset( );
+          {    int offset = p.getOffset( );
                out << "placed fw starting at position " << offset
-                    << " on edge " << p[0][0] << " (len=" << hb.Bases(p[0][0]) 
+                    << " on edge " << p[0] << " (len=" << hb.Bases(p[0]) 
                     << ")" << endl;
-               out << "full path = " << printSeq( p[0] ) << endl;    }
+               out << "full path = " << printSeq(p) << endl;    }
           return False;    }
 
      // Process BASES.
@@ -57,7 +57,7 @@ class NhoodInfoEngine {
     HyperBasevectorX hb;
     vec<int> inv;
     vec< triple<kmer<L>,int,int> > kmers_plus;
-    vec<vec<vec<vec<int>>>> lines;
+    line_store lines;
     vec<int> tol, npairs, llens;
     vec<String> genome_names, genome_names_alt;
     vec< pair<int,ho_interval> > ambint, ambint_alt;
@@ -41,7 +41,7 @@ void TestDot( )
           Scram(1);    }    }
 
 void CreateEdgeLabels( const HyperBasevectorX& hb, const vec<int>& inv,
-     const vec<vec<vec<vec<int>>>>& lines, const vec<int>& tol,
+     const line_store& lines, const vec<int>& tol,
      const vec<int>& llens, const vec<covcount>& cov, const vec<vec<covcount>>& covs,
      vec< vec< pair<int,int> > >& hits, const vec<String>& subsam_names,
      const vec<vec<int>>& count, const vec<String>& genome_names,
@@ -126,7 +126,7 @@ void ColorEdges( const HyperBasevectorX& hb, const vec<vec<int>>& count,
 
 Bool DefineSeeds( const HyperBasevectorX& hb, const vec<int>& inv,
      const vec< triple<kmer<20>,int,int> >& kmers_plus,
-     const vec<vec<vec<vec<int>>>>& lines,
+     const line_store& lines,
      const vec<int>& tol, const vec<String>& genome_names, 
      const vec< pair<int,ho_interval> >& ambint, Bool& ambflag,
      const vec< vec< pair<int,int> > >& hits, const nhood_info_state& state, 
@@ -142,7 +142,7 @@ Bool DefineSeeds( const HyperBasevectorX& hb, const vec<int>& inv,
      if (state.EXT)
      {    vec<int> seeds2;
           for ( int s = 0; s < seeds.isize( ); s++ )
-          {    const vec<vec<vec<int>>>& L = lines[ tol[ seeds[s] ] ];
+          {    line_store::line_ref L = lines[ tol[ seeds[s] ] ];
                for ( int i = 0; i < L.isize( ); i++ )
                for ( int j = 0; j < L[i].isize( ); j++ )
                for ( int k = 0; k < L[i][j].isize( ); k++ )
@@ -152,7 +152,7 @@ Bool DefineSeeds( const HyperBasevectorX& hb, const vec<int>& inv,
      return True;    }
 
 void MakeDot( const HyperBasevectorX& hb, const vec<int>& inv,
-     const vec<vec<vec<vec<int>>>>& lines, const vec<int>& tol,
+     const line_store& lines, const vec<int>& tol,
      const vec<int>& llens, const vec<covcount>& cov, const vec<vec<covcount>>& covs,
      vec< vec< pair<int,int> > >& hits, const vec<String>& genome_names,
      const vec<int>& used, const nhood_info_state& state, const vec<int>& seeds, 
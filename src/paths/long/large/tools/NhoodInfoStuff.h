@@ -17,7 +17,7 @@
 void TestDot( );
 
 void CreateEdgeLabels( const HyperBasevectorX& hb, const vec<int>& inv,
-     const vec<vec<vec<vec<int>>>>& lines, const vec<int>& tol,
+     const line_store& lines, const vec<int>& tol,
      const vec<int>& llens, const vec<covcount>& cov, const vec<vec<covcount>>& covs,
      vec< vec< pair<int,int> > >& hits, const vec<String>& subsam_names,
      const vec<vec<int>>& count, const vec<String>& genome_names,
@@ -30,7 +30,7 @@ void ColorEdges( const HyperBasevectorX& hb, const vec<vec<int>>& count,
 
 Bool DefineSeeds( const HyperBasevectorX& hb, const vec<int>& inv,
      const vec< triple<kmer<20>,int,int> >& kmers_plus,
-     const vec<vec<vec<vec<int>>>>& lines,
+     const line_store& lines,
      const vec<int>& tol, const vec<String>& genome_names, 
      const vec< pair<int,ho_interval> >& ambint, Bool& ambflag,
      const vec< vec< pair<int,int> > >& hits, const nhood_info_state& state, 
@@ -38,7 +38,7 @@ Bool DefineSeeds( const HyperBasevectorX& hb, const vec<int>& inv,
      const int max_seeds, ostream& tout );
 
 void MakeDot( const HyperBasevectorX& hb, const vec<int>& inv,
-     const vec<vec<vec<vec<int>>>>& lines, const vec<int>& tol,
+     const line_store& lines, const vec<int>& tol,
      const vec<int>& llens, const vec<covcount>& cov, const vec<vec<covcount>>& covs,
      vec< vec< pair<int,int> > >& hits, const vec<String>& genome_names,
      const vec<int>& used, const nhood_info_state& state, const vec<int>& seeds, 
@@ -0,0 +1,205 @@
+///////////////////////////////////////////////////////////////////////////////
+//                   SOFTWARE COPYRIGHT NOTICE AGREEMENT                     //
+//       This software and its documentation are copyright (2015) by the     //
+//   Broad Institute.  All rights are reserved.  This software is supplied   //
+//   without any warranty or guaranteed support whatsoever. The Broad        //
+//   Institute is not responsible for its use, misuse, or functionality.     //
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * \file StageProfiler.cc
+ *
+ * \brief
+ */
+
+// MakeDepend: library OMP
+
+#include "reporting/StageProfiler.h"
+#include "system/TaskPool.h"
+#include "system/SysConf.h"
+#include "system/System.h"
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <omp.h>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+
+struct Record
+{
+    std::string name;
+    std::string detail;
+    int depth;
+    double start;
+    double wall;
+    double cpu;
+    int threads;
+    int64_t rssPeak;
+    int64_t bytesRead;
+    int64_t bytesWritten;
+};
+
+std::string gDir;
+double gInitTime;
+std::mutex gMutex;
+std::vector<Record> gRecords;
+std::ofstream* gpTSV = nullptr;
+
+thread_local std::vector<std::string> gStack;
+
+double secs( timeval const& tv )
+{ return tv.tv_sec + tv.tv_usec/1000000.; }
+
+// Returns the value for the given key from a /proc file made of lines of the
+// form "key: value", or 0 if the key is not present.
+int64_t procValue( std::string const& file, std::string const& key )
+{
+    std::ifstream in(file);
+    std::string line;
+    while ( std::getline(in,line) )
+    {
+        if ( line.compare(0,key.size(),key) || line.size() == key.size() ||
+                line[key.size()] != ':' )
+            continue;
+        return std::strtoll(line.c_str()+key.size()+1,nullptr,10);
+    }
+    return 0;
+}
+
+std::string jsonEscape( std::string const& str )
+{
+    std::string result;
+    for ( char c : str )
+    {
+        if ( c == '"' || c == '\\' ) result += '\\';
+        result += c;
+    }
+    return result;
+}
+
+void writeTSVHeader( std::ostream& os )
+{ os << "stage\tdetail\tdepth\tstart_s\twall_s\tcpu_s\tthreads\tutilization"
+        "\tpeak_rss_bytes\tbytes_read\tbytes_written" << std::endl; }
+
+void writeTSV( std::ostream& os, Record const& rec )
+{
+    double util = rec.wall > 0. ? rec.cpu/(rec.wall*rec.threads) : 0.;
+    os << rec.name << '\t' << (rec.detail.empty() ? "-" : rec.detail) << '\t'
+        << rec.depth << '\t' << rec.start << '\t' << rec.wall << '\t'
+        << rec.cpu << '\t' << rec.threads << '\t' << util << '\t'
+        << rec.rssPeak << '\t' << rec.bytesRead << '\t' << rec.bytesWritten
+        << std::endl;
+}
+
+}
+
+void StageProfiler::init( std::string const& dir )
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    gDir = dir;
+    gInitTime = WallClockTime();
+    gRecords.clear();
+    delete gpTSV;
+    gpTSV = new std::ofstream(dir+"/profile.tsv");
+    writeTSVHeader(*gpTSV);
+}
+
+bool StageProfiler::enabled()
+{ return gpTSV; }
+
+void StageProfiler::finish()
+{
+    std::lock_guard<std::mutex> lock(gMutex);
+    if ( !gpTSV ) return;
+    std::ofstream out(gDir+"/profile.json");
+    out << "{\n  \"stages\": [";
+    for ( auto itr=gRecords.begin(),end=gRecords.end(); itr != end; ++itr )
+    {
+        double util = itr->wall > 0. ? itr->cpu/(itr->wall*itr->threads) : 0.;
+        out << (itr == gRecords.begin() ? "\n" : ",\n")
+            << "    { \"stage\": \"" << jsonEscape(itr->name) << "\""
+            << ", \"detail\": \"" << jsonEscape(itr->detail) << "\""
+            << ", \"depth\": " << itr->depth
+            << ", \"start_s\": " << itr->start
+            << ", \"wall_s\": " << itr->wall
+            << ", \"cpu_s\": " << itr->cpu
+            << ", \"threads\": " << itr->threads
+            << ", \"utilization\": " << util
+            << ", \"peak_rss_bytes\": " << itr->rssPeak
+            << ", \"bytes_read\": " << itr->bytesRead
+            << ", \"bytes_written\": " << itr->bytesWritten << " }";
+    }
+    out << "\n  ],\n  \"peak_rss_bytes\": " << PeakMemUsageBytes()
+        << ",\n  \"wall_s\": " << WallClockTime()-gInitTime << "\n}\n";
+    delete gpTSV;
+    gpTSV = nullptr;
+}
+
+StageProfiler::Sample StageProfiler::Sample::now( bool thisThreadOnly )
+{
+    Sample result;
+    result.wall = WallClockTime();
+    rusage ru;
+    getrusage(thisThreadOnly ? RUSAGE_THREAD : RUSAGE_SELF, &ru);
+    result.cpu = secs(ru.ru_utime) + secs(ru.ru_stime);
+    result.rss = procValue("/proc/self/status","VmHWM")*1024;
+    std::string ioFile = "/proc/self/io";
+    if ( thisThreadOnly )
+        ioFile = "/proc/self/task/" + std::to_string(syscall(SYS_gettid)) + "/io";
+    result.bytesRead = procValue(ioFile,"rchar");
+    result.bytesWritten = procValue(ioFile,"wchar");
+    return result;
+}
+
+void StageProfiler::record( std::string const& name, std::string const& detail,
+                            int depth, bool perThread, Sample const& start )
+{
+    Sample end = Sample::now(perThread);
+    Record rec;
+    rec.name = name;
+    rec.detail = detail;
+    rec.depth = depth;
+    rec.start = start.wall - gInitTime;
+    rec.wall = end.wall - start.wall;
+    rec.cpu = end.cpu - start.cpu;
+    rec.threads = perThread ? 1 : getConfiguredNumThreads();
+    rec.rssPeak = end.rss;
+    rec.bytesRead = end.bytesRead - start.bytesRead;
+    rec.bytesWritten = end.bytesWritten - start.bytesWritten;
+    std::lock_guard<std::mutex> lock(gMutex);
+    if ( !gpTSV ) return;
+    writeTSV(*gpTSV,rec);
+    gRecords.push_back(rec);
+}
+
+// Inside a parallel region or loop the name is taken as given, since the
+// enclosing stages are only known to the thread that started it.
+StageProfile::StageProfile( std::string const& name, std::string const& detail )
+: mActive(StageProfiler::enabled()),
+  mPerThread(omp_in_parallel() || TaskPool::inParallel()), mDepth(0)
+{
+    if ( !mActive ) return;
+    mName = name;
+    mDetail = detail;
+    if ( !mPerThread )
+    {
+        if ( !gStack.empty() ) mName = gStack.back() + "/" + name;
+        else ResetPeakMemUsage();
+        gStack.push_back(mName);
+    }
+    mDepth = std::count(mName.begin(),mName.end(),'/');
+    mStart = StageProfiler::Sample::now(mPerThread);
+}
+
+StageProfile::~StageProfile()
+{
+    if ( !mActive ) return;
+    StageProfiler::record(mName,mDetail,mDepth,mPerThread,mStart);
+    if ( !mPerThread ) gStack.pop_back();
+}
@@ -0,0 +1,86 @@
+///////////////////////////////////////////////////////////////////////////////
+//                   SOFTWARE COPYRIGHT NOTICE AGREEMENT                     //
+//       This software and its documentation are copyright (2015) by the     //
+//   Broad Institute.  All rights are reserved.  This software is supplied   //
+//   without any warranty or guaranteed support whatsoever. The Broad        //
+//   Institute is not responsible for its use, misuse, or functionality.     //
+///////////////////////////////////////////////////////////////////////////////
+
+/*
+ * \file StageProfiler.h
+ *
+ * \brief Machine-readable per-stage performance telemetry.
+ */
+#ifndef REPORTING_STAGEPROFILER_H_
+#define REPORTING_STAGEPROFILER_H_
+
+#include <cstdint>
+#include <string>
+
+/// Records the cost of each stage of a program: wall time, CPU time, thread
+/// utilization, peak RSS, and bytes read and written.
+///
+/// Use it like this:
+/// StageProfiler::init(workDir);     // once, otherwise nothing is recorded
+/// { StageProfile prof("Repath"); Repath(...); }
+/// StageProfiler::finish();          // writes workDir/profile.json
+///
+/// Stages may be nested:  a StageProfile created while another one is alive
+/// in the same thread is recorded as a sub-stage, e.g. "ReadQGraph/createDict".
+/// Each stage is appended to workDir/profile.tsv as soon as it completes, so
+/// the record survives a crash.
+///
+/// A StageProfile created inside an OpenMP parallel region or a parallelFor
+/// workitem (e.g. one per local assembly) measures only the calling thread's
+/// CPU time and I/O, and should be given its full name, e.g.
+/// "AssembleGaps2/blob".  Any stage may carry a detail string (e.g. a blob id)
+/// to tell repeated instances apart.
+///
+/// The peak RSS of an outermost serial stage is measured by resetting the
+/// kernel's high-water mark when the stage starts; for other stages it is the
+/// high-water mark since the enclosing outermost stage started.
+class StageProfiler
+{
+public:
+    static void init( std::string const& dir );
+    static bool enabled();
+    static void finish();
+
+    struct Sample
+    {
+        double wall; // WallClockTime() when sampled
+        double cpu; // seconds
+        int64_t rss; // bytes
+        int64_t bytesRead;
+        int64_t bytesWritten;
+
+        static Sample now( bool thisThreadOnly );
+    };
+
+    static void record( std::string const& name, std::string const& detail,
+                        int depth, bool perThread, Sample const& start );
+
+private:
+    StageProfiler() = delete;
+};
+
+class StageProfile
+{
+public:
+    explicit StageProfile( std::string const& name,
+                            std::string const& detail = std::string() );
+    ~StageProfile();
+
+    StageProfile( StageProfile const& ) = delete;
+    StageProfile& operator=( StageProfile const& ) = delete;
+
+private:
+    bool mActive;
+    bool mPerThread;
+    int mDepth;
+    std::string mName;
+    std::string mDetail;
+    StageProfiler::Sample mStart;
+};
+
+#endif /* REPORTING_STAGEPROFILER_H_ */
@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////////
+//                   SOFTWARE COPYRIGHT NOTICE AGREEMENT                     //
+//       This software and its documentation are copyright (2015) by the     //
+//   Broad Institute.  All rights are reserved.  This software is supplied   //
+//   without any warranty or guaranteed support whatsoever. The Broad        //
+//   Institute is not responsible for its use, misuse, or functionality.     //
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * \file MemBudget.cc
+ *
+ * \brief
+ */
+
+#include "system/MemBudget.h"
+#include "system/System.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+namespace
+{
+
+double GB( size_t nBytes ) { return nBytes/(1024.*1024.*1024.); }
+
+}
+
+bool ExpectMemory( char const* stage, size_t nBytes, double fract )
+{
+    size_t avail = MemAvailable(fract);
+    if ( nBytes <= avail )
+        return true;
+    std::cout << Date() << ": " << stage << " expects to need "
+              << std::setiosflags(std::ios::fixed) << std::setprecision(2)
+              << GB(nBytes) << " GB more memory, but only " << GB(avail)
+              << " GB of the " << GB(GetMaxMemory()) << " GB budget remain."
+              << std::resetiosflags(std::ios::fixed) << std::endl;
+    return false;
+}
+
+unsigned MemBoundedThreads( size_t bytesPerThread, unsigned nThreads,
+                            double fract )
+{
+    if ( !bytesPerThread )
+        return std::max(nThreads,1u);
+    size_t nFit = MemAvailable(fract)/bytesPerThread;
+    return std::max(1ul,std::min(size_t(nThreads),nFit));
+}
+
+MemGate::MemGate( char const* stage, double fract )
+: mStage(stage), mLimit(fract*GetMaxMemory()), mBaseline(MemUsageBytes()),
+  mRunningBytes(0), mNRunning(0), mMaxRunning(0), mNTasks(0), mNThrottled(0),
+  mTaskDone(mLock)
+{}
+
+MemGate::~MemGate()
+{
+    if ( mNThrottled )
+        std::cout << Date() << ": memory budget of "
+                  << std::setiosflags(std::ios::fixed) << std::setprecision(2)
+                  << GB(mLimit) << " GB delayed "
+                  << mNThrottled << " of " << mNTasks << " tasks in " << mStage
+                  << "; at most " << mMaxRunning << " ran at once."
+                  << std::resetiosflags(std::ios::fixed) << std::endl;
+}
+
+void MemGate::enter( size_t nBytes )
+{
+    Locker locker(mLock);
+    bool waited = false;
+    // poll now and then, too, in case memory is freed by someone else
+    while ( mNRunning && !fits(nBytes) )
+    {
+        waited = true;
+        locker.timedWait(mTaskDone,1);
+    }
+    mNRunning += 1;
+    mRunningBytes += nBytes;
+    mMaxRunning = std::max(mMaxRunning,mNRunning);
+    mNTasks += 1;
+    if ( waited ) mNThrottled += 1;
+}
+
+void MemGate::leave( size_t nBytes )
+{
+    if ( true )
+    {
+        Locker locker(mLock);
+        mNRunning -= 1;
+        mRunningBytes -= nBytes;
+    }
+    mTaskDone.signal();
+}
+
+// Tasks that have just started may not have allocated much yet, so we charge
+// the running tasks at least their estimates over what was in use at the
+// start.
+bool MemGate::fits( size_t nBytes ) const
+{
+    size_t inUse = std::max(size_t(MemUsageBytes()),mBaseline+mRunningBytes);
+    return inUse+nBytes <= mLimit;
+}
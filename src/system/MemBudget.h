@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////
+//                   SOFTWARE COPYRIGHT NOTICE AGREEMENT                     //
+//       This software and its documentation are copyright (2015) by the     //
+//   Broad Institute.  All rights are reserved.  This software is supplied   //
+//   without any warranty or guaranteed support whatsoever. The Broad        //
+//   Institute is not responsible for its use, misuse, or functionality.     //
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * \file MemBudget.h
+ *
+ * \brief Keeping memory-hungry stages within the budget set by SetMaxMemory.
+ */
+#ifndef SYSTEM_MEMBUDGET_H_
+#define SYSTEM_MEMBUDGET_H_
+
+#include "system/LockedData.h"
+#include "system/SysConf.h"
+#include <cstddef>
+
+/// A stage announces how much more memory it expects to need.  If that won't
+/// fit into the unused part of the budget, we say so.  Returns true if it
+/// fits.  The fraction is the part of the budget you're willing to use.
+bool ExpectMemory( char const* stage, size_t nBytes, double fract = .9 );
+
+/// The number of threads, each of which will use bytesPerThread, that fit
+/// into the unused part of the budget.  Never more than nThreads, and never
+/// less than 1.
+unsigned MemBoundedThreads( size_t bytesPerThread,
+                            unsigned nThreads = getConfiguredNumThreads(),
+                            double fract = .9 );
+
+/// Admission control for the tasks of a parallel loop.  Each task says about
+/// how much memory it will need while it runs.  A task isn't admitted until
+/// the budget can cover it, in addition to the memory actually in use and the
+/// estimates for the tasks that are already running.  But a task is always
+/// admitted when nothing else is running, so there's always progress.
+///
+/// Use it like this:
+/// MemGate gate("MyStage");
+/// #pragma omp parallel for
+/// for ( ... )
+/// { MemGate::Ticket ticket(gate,taskBytes);
+///   ... }
+class MemGate
+{
+public:
+    explicit MemGate( char const* stage, double fract = .9 );
+    MemGate( MemGate const& )=delete;
+    MemGate& operator=( MemGate const& )=delete;
+
+    /// Reports how much throttling happened, if any.
+    ~MemGate();
+
+    /// Waits until there's room for a task needing nBytes, and then registers
+    /// it as running.
+    void enter( size_t nBytes );
+
+    /// Registers the completion of a task that entered with nBytes.
+    void leave( size_t nBytes );
+
+    class Ticket
+    {
+    public:
+        Ticket( MemGate& gate, size_t nBytes ) : mGate(gate), mNBytes(nBytes)
+        { gate.enter(nBytes); }
+        Ticket( Ticket const& )=delete;
+        Ticket& operator=( Ticket const& )=delete;
+        ~Ticket() { mGate.leave(mNBytes); }
+
+    private:
+        MemGate& mGate;
+        size_t mNBytes;
+    };
+
+private:
+    bool fits( size_t nBytes ) const;
+
+    char const* mStage;
+    size_t mLimit;
+    size_t mBaseline;
+    size_t mRunningBytes;
+    unsigned mNRunning;
+    unsigned mMaxRunning;
+    size_t mNTasks;
+    size_t mNThrottled;
+    LockedData mLock;
+    Condition mTaskDone;
+};
+
+#endif /* SYSTEM_MEMBUDGET_H_ */
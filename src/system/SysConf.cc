@@ -17,7 +17,9 @@
 #include "system/Exit.h"
 #include <climits>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <string>
 #include <unistd.h>
 #include <malloc.h>
 #include <omp.h>
@@ -36,8 +38,51 @@ size_t gPhysPages;
 size_t gProcsOnline;
 size_t gClockTicksPerSec;
 size_t gMaxHostNameLen;
+size_t gMemLimit;
 int gNumThreads;
 
+// Reads a byte count from a cgroup control file.  Returns 0 if there's no such
+// file, or if it says there's no limit ("max").
+size_t readCGroupLimit( std::string const& path )
+{
+    std::ifstream in(path);
+    std::string val;
+    if ( !(in >> val) || val.empty() || val[0] < '0' || val[0] > '9' )
+        return 0;
+    return strtoull(val.c_str(),nullptr,10);
+}
+
+// The tightest memory limit on our own cgroup or the root of the hierarchy.
+// Handles both the unified (v2) and the legacy (v1) memory controller.
+size_t cgroupMemoryLimit()
+{
+    std::string v1Path, v2Path;
+    std::ifstream in("/proc/self/cgroup");
+    std::string line;
+    while ( getline(in,line) )
+    {
+        if ( line.compare(0,3,"0::") == 0 )
+            v2Path = line.substr(3);
+        else
+        {
+            size_t pos = line.find(":memory:");
+            if ( pos != std::string::npos )
+                v1Path = line.substr(pos+8);
+        }
+    }
+    size_t result = 0;
+    auto tighten = [&result]( size_t limit )
+    { if ( limit && (!result || limit < result) ) result = limit; };
+    if ( !v2Path.empty() && v2Path != "/" )
+        tighten(readCGroupLimit("/sys/fs/cgroup"+v2Path+"/memory.max"));
+    tighten(readCGroupLimit("/sys/fs/cgroup/memory.max"));
+    if ( !v1Path.empty() && v1Path != "/" )
+        tighten(readCGroupLimit("/sys/fs/cgroup/memory"+v1Path+
+                                    "/memory.limit_in_bytes"));
+    tighten(readCGroupLimit("/sys/fs/cgroup/memory/memory.limit_in_bytes"));
+    return result;
+}
+
 }
 
 size_t pageSize()
@@ -62,6 +107,34 @@ size_t physicalMemory()
     return gPhysPages*pageSize();
 }
 
+size_t memoryLimit()
+{
+    if ( !gMemLimit )
+    {
+        gMemLimit = physicalMemory();
+        size_t cgLimit = cgroupMemoryLimit();
+        if ( cgLimit && cgLimit < gMemLimit )
+            gMemLimit = cgLimit;
+    }
+    return gMemLimit;
+}
+
+size_t memoryFree()
+{
+    size_t limit = memoryLimit();
+    std::ifstream in("/proc/meminfo");
+    std::string key;
+    size_t val;
+    std::string units;
+    while ( in >> key >> val )
+    {
+        if ( key == "MemAvailable:" )
+            return std::min(1024ul*val,limit);
+        getline(in,units);
+    }
+    return limit;
+}
+
 size_t processorsOnline()
 {
     if ( !gProcsOnline )
@@ -25,6 +25,16 @@ size_t pageSize();
 /// Number of bytes of memory on this machine.
 size_t physicalMemory();
 
+/// Number of bytes of memory this process may use: the lesser of
+/// physicalMemory() and any control-group limit (e.g., from a container or a
+/// batch-queue slot).
+size_t memoryLimit();
+
+/// Number of bytes that could be allocated right now without swapping, as
+/// estimated by the kernel (MemAvailable in /proc/meminfo), and never more
+/// than memoryLimit().  On a shared node this may be much less than either.
+size_t memoryFree();
+
 /// The number of CPUs available.
 size_t processorsOnline();
 
@@ -30,6 +30,7 @@
 #include <sys/wait.h>
 
 #include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <sstream>
 #include <vector>
@@ -984,12 +985,30 @@ int64_t MemUsageBytes()
 #endif
 }
 
+// Peak memory usage recorded before the last call to ResetPeakMemUsage.
+
+static std::atomic<int64_t> gPeakMemBeforeReset(0);
+
 int64_t PeakMemUsageBytes( )
 {    int pid = getpid( );
      int64_t KB = WhiteSpaceFree(
           LineOfOutput( "cat /proc/" + ToString(pid) + "/status | grep VmHWM" ) )
           .Between( ":", "kB" ).Int( );
-     return KB * (int64_t) 1000;    }
+     return std::max( KB * (int64_t) 1000, gPeakMemBeforeReset.load( ) );    }
+
+bool ResetPeakMemUsage( )
+{
+#ifdef __linux
+     int64_t peak = PeakMemUsageBytes( );
+     int64_t prev = gPeakMemBeforeReset.load( );
+     while ( peak > prev && !gPeakMemBeforeReset.compare_exchange_weak(prev,peak) );
+     std::ofstream out( "/proc/self/clear_refs" );
+     out << "5" << std::flush;
+     return out.good( );
+#else
+     return false;
+#endif
+}
 
 double PeakMemUsageGB( )
 {    return PeakMemUsageBytes( ) / double( 1024 * 1024 * 1024 );   }
@@ -1020,12 +1039,12 @@ namespace
 
 void SetMaxMemory( size_t maxMemory )
 {
-    gMaxMemory = std::min(maxMemory,physicalMemory());
+    gMaxMemory = std::min(maxMemory,memoryLimit());
 }
 
 size_t GetMaxMemory()
 {
-    return gMaxMemory ? gMaxMemory : physicalMemory();
+    return gMaxMemory ? gMaxMemory : memoryLimit();
 }
 
 size_t MemAvailable( double fract )
@@ -522,17 +522,24 @@ int64_t PeakMemUsageBytes( );
 double PeakMemUsageGB( );
 String PeakMemUsageGBString( );
 
+// Reset the kernel's record of peak memory usage (VmHWM), so that the peak for
+// a phase of computation can be measured.  PeakMemUsageBytes continues to
+// report the peak over the whole run.  Returns false if this isn't supported.
+
+bool ResetPeakMemUsage( );
+
 String PhysicalMemGBString( );
 
 /// Set the maximum amount of memory you'd like to use.
-/// This is not enforced in any manner.  It's just an advisory that's used
-/// by the MemAvailable() function which follows.  Setting the advisory
-/// to 0 turns it off.  (I.e., it says you're willing to use all of the
-/// physical memory.
+/// This is the budget used by the MemAvailable() function which follows, and
+/// by the memory gates in system/MemBudget.h, which throttle memory-hungry
+/// parallel stages to stay within it.  It's clamped to memoryLimit(), which
+/// honors any cgroup limit.  Setting the budget to 0 turns it off.  (I.e., it
+/// says you're willing to use all the memory you're allowed.)
 void SetMaxMemory( size_t maxMemory );
 
-/// Retrieve the memory advisory you set with SetMaxMemory, or all of the
-/// physicalMemory() if you haven't set an advisory.
+/// Retrieve the memory budget you set with SetMaxMemory, or memoryLimit() if
+/// you haven't set one.
 size_t GetMaxMemory();
 
 /// Amount of memory that you just might be able to allocate, or maybe not.
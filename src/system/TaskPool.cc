@@ -0,0 +1,217 @@
+///////////////////////////////////////////////////////////////////////////////
+//                   SOFTWARE COPYRIGHT NOTICE AGREEMENT                     //
+//       This software and its documentation are copyright (2015) by the     //
+//   Broad Institute.  All rights are reserved.  This software is supplied   //
+//   without any warranty or guaranteed support whatsoever. The Broad        //
+//   Institute is not responsible for its use, misuse, or functionality.     //
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * \file TaskPool.cc
+ *
+ * \brief A process-wide pool of persistent threads that run small tasks,
+ * stealing them from each other.
+ */
+// MakeDepend: library PTHREAD
+// MakeDepend: library OMP
+#include "system/TaskPool.h"
+#include "system/ErrNo.h"
+#include "system/SysConf.h"
+#include "system/System.h"
+#include "system/WorklistUtils.h"
+#include <algorithm>
+#include <omp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+
+namespace
+{
+    TaskPool* gpPool;
+
+    size_t const DEFAULT_THREAD_STACK_SIZE = 8ul*1024ul*1024ul;
+
+    void checkThreadOp( int errNo, char const* msg )
+    {
+        if ( errNo )
+        {
+            ErrNo err(errNo);
+            FatalErr(msg << err);
+        }
+    }
+}
+
+thread_local TaskPool::Deque* TaskPool::gOwnDeque;
+thread_local unsigned TaskPool::gLoopDepth;
+
+TaskPool& TaskPool::get()
+{
+    static TaskPool* pPool = new TaskPool;
+    pPool->addWorkers(getConfiguredNumThreads()-1);
+    return *pPool;
+}
+
+void TaskPool::push( Task const& task )
+{
+    // count it first, so that mNQueued never underestimates
+    mNQueued += 1;
+    Deque& deque = gOwnDeque ? *gOwnDeque : mDeques[0];
+    if ( true )
+    {
+        std::lock_guard<std::mutex> lock(deque.mMtx);
+        deque.mTasks.push_back(task);
+    }
+
+    // lock so that we can't signal between a sleeper's test and its wait
+    std::lock_guard<std::mutex> lock(mSleepMtx);
+    mWakeCV.notify_one();
+}
+
+void TaskPool::taskDone( std::atomic_size_t& nPending )
+{
+    if ( --nPending )
+        return;
+
+    // the waiter is sleeping with the idle workers
+    std::lock_guard<std::mutex> lock(mSleepMtx);
+    mWakeCV.notify_all();
+}
+
+void TaskPool::waitFor( std::atomic_size_t const& nPending )
+{
+    Task task;
+    while ( nPending )
+    {
+        if ( popTask(gOwnDeque,&task) )
+        {
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mSleepMtx);
+        while ( nPending && !mNQueued )
+            mWakeCV.wait(lock);
+    }
+}
+
+TaskPool::TaskPool()
+: mMaxWorkers(3*processorsOnline()), mDeques(new Deque[mMaxWorkers+1]),
+  mNWorkers(0), mNQueued(0)
+{
+    gpPool = this;
+    populate_cpu_affinity(mCpuAffinity);
+
+    struct rlimit rl;
+    if ( getrlimit(RLIMIT_STACK,&rl) )
+    {
+        ErrNo err;
+        FatalErr("Unable to determine current stack size" << err);
+    }
+    if ( rl.rlim_cur == RLIM_INFINITY )
+        mStackSize = DEFAULT_THREAD_STACK_SIZE;
+    else
+        mStackSize = rl.rlim_cur;
+}
+
+void TaskPool::addWorkers( size_t nWorkers )
+{
+    nWorkers = std::min(nWorkers,mMaxWorkers);
+    if ( mNWorkers >= nWorkers )
+        return;
+
+    std::lock_guard<std::mutex> lock(mGrowMtx);
+    pthread_attr_t attr;
+    checkThreadOp(pthread_attr_init(&attr),
+                    "ThreadAttr initialization failed: ");
+    checkThreadOp(pthread_attr_setstacksize(&attr,mStackSize),
+                    "Unable to set stack size for threads: ");
+    checkThreadOp(pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_DETACHED),
+                    "Unable to detach threads: ");
+    while ( mNWorkers < nWorkers )
+    {
+        // deque and cpu 0 are the main thread's, as with ThreadPool
+        size_t idx = mNWorkers + 1;
+        if ( mCpuAffinity.size() )
+        {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(mCpuAffinity[idx%mCpuAffinity.size()],&cpuset);
+            checkThreadOp(pthread_attr_setaffinity_np(&attr,sizeof(cpuset),
+                                                        &cpuset),
+                    "failed setting CPU affinity for threads: ");
+        }
+        pthread_t thread;
+        checkThreadOp(pthread_create(&thread,&attr,threadFunc,&mDeques[idx]),
+                        "Thread creation failed: ");
+        mNWorkers += 1;
+    }
+    checkThreadOp(pthread_attr_destroy(&attr),
+                    "ThreadAttr destruction failed: ");
+}
+
+void TaskPool::work( Deque* pOwnDeque )
+{
+    gOwnDeque = pOwnDeque;
+    omp_set_num_threads(1);
+
+    Task task;
+    while ( true )
+    {
+        if ( popTask(pOwnDeque,&task) )
+        {
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mSleepMtx);
+        while ( !mNQueued )
+            mWakeCV.wait(lock);
+    }
+}
+
+// Our own newest task, else the oldest shared one, else the oldest of someone
+// else's.
+bool TaskPool::popTask( Deque* pOwnDeque, Task* pTask )
+{
+    if ( !mNQueued )
+        return false;
+
+    if ( pOwnDeque )
+    {
+        std::lock_guard<std::mutex> lock(pOwnDeque->mMtx);
+        if ( !pOwnDeque->mTasks.empty() )
+        {
+            *pTask = pOwnDeque->mTasks.back();
+            pOwnDeque->mTasks.pop_back();
+            mNQueued -= 1;
+            return true;
+        }
+    }
+
+    if ( popFront(mDeques[0],pTask) )
+        return true;
+
+    size_t nWorkers = mNWorkers;
+    size_t first = pOwnDeque ? pOwnDeque - &mDeques[0] : 0;
+    for ( size_t off = 1; off <= nWorkers; ++off )
+    {
+        Deque* pVictim = &mDeques[(first+off-1)%nWorkers+1];
+        if ( pVictim != pOwnDeque && popFront(*pVictim,pTask) )
+            return true;
+    }
+    return false;
+}
+
+bool TaskPool::popFront( Deque& deque, Task* pTask )
+{
+    std::lock_guard<std::mutex> lock(deque.mMtx);
+    if ( deque.mTasks.empty() )
+        return false;
+    *pTask = deque.mTasks.front();
+    deque.mTasks.pop_front();
+    mNQueued -= 1;
+    return true;
+}
+
+void* TaskPool::threadFunc( void* ptr )
+{
+    gpPool->work(static_cast<Deque*>(ptr));
+    return 0;
+}
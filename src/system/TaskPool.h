@@ -0,0 +1,120 @@
+///////////////////////////////////////////////////////////////////////////////
+//                   SOFTWARE COPYRIGHT NOTICE AGREEMENT                     //
+//       This software and its documentation are copyright (2015) by the     //
+//   Broad Institute.  All rights are reserved.  This software is supplied   //
+//   without any warranty or guaranteed support whatsoever. The Broad        //
+//   Institute is not responsible for its use, misuse, or functionality.     //
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * \file TaskPool.h
+ *
+ * \brief A process-wide pool of persistent threads that run small tasks,
+ * stealing them from each other.
+ */
+#ifndef SYSTEM_TASKPOOL_H_
+#define SYSTEM_TASKPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/// The threads are created as they're first needed, and then live as long as
+/// the process does, so that running a parallel loop costs a few queue
+/// operations rather than creating and joining threads.
+///
+/// Each worker has its own deque of tasks:  it pushes and pops at the back,
+/// and idle workers steal from the front.  Other threads push onto a shared
+/// deque.  A thread that waits for its tasks to finish runs queued tasks in
+/// the meantime, so a worker can start a nested parallel loop without tying
+/// up a thread, and without running it serially if there are idle workers.
+///
+/// Workers are pinned to cpus according to GOMP_CPU_AFFINITY, if it's set,
+/// just as ThreadPool threads are, and they run OpenMP regions with a single
+/// thread.
+class TaskPool
+{
+public:
+    /// A task is just a function and its argument.
+    struct Task
+    {
+        Task() : mFunc(nullptr), mArg(nullptr) {}
+        Task( void (*func)( void* ), void* arg ) : mFunc(func), mArg(arg) {}
+
+        void operator()() const { mFunc(mArg); }
+
+        void (*mFunc)( void* );
+        void* mArg;
+    };
+
+    TaskPool( TaskPool const& )=delete;
+    TaskPool& operator=( TaskPool const& )=delete;
+
+    /// The process-wide pool, with at least getConfiguredNumThreads()-1
+    /// workers (the thread that waits for the tasks makes up the difference).
+    static TaskPool& get();
+
+    /// Is the calling thread one of the pool's workers?
+    static bool isWorker() { return gOwnDeque != nullptr; }
+
+    /// Is the calling thread running workitems of a parallel loop, either as
+    /// a worker or as the thread that started the loop?
+    static bool inParallel() { return gOwnDeque != nullptr || gLoopDepth; }
+
+    /// Marks the calling thread as running a parallel loop's workitems for as
+    /// long as it lives.
+    class LoopScope
+    {
+    public:
+        LoopScope() { gLoopDepth += 1; }
+        LoopScope( LoopScope const& )=delete;
+        LoopScope& operator=( LoopScope const& )=delete;
+        ~LoopScope() { gLoopDepth -= 1; }
+    };
+
+    size_t getNWorkers() const { return mNWorkers; }
+
+    /// Queue a task.
+    void push( Task const& task );
+
+    /// Called by a task when it's done:  decrements nPending, and wakes the
+    /// waiter if that was the last one.
+    void taskDone( std::atomic_size_t& nPending );
+
+    /// Run queued tasks (or sleep, if there aren't any) until nPending is 0.
+    void waitFor( std::atomic_size_t const& nPending );
+
+private:
+    struct Deque
+    {
+        std::mutex mMtx;
+        std::deque<Task> mTasks;
+    };
+
+    TaskPool();
+
+    void addWorkers( size_t nWorkers );
+    void work( Deque* pOwnDeque );
+    bool popTask( Deque* pOwnDeque, Task* pTask );
+    bool popFront( Deque& deque, Task* pTask );
+
+    static void* threadFunc( void* );
+
+    size_t mMaxWorkers;
+    std::unique_ptr<Deque[]> mDeques; // [0] is shared, the rest the workers'
+    std::atomic_size_t mNWorkers;
+    std::atomic_size_t mNQueued;
+    std::mutex mGrowMtx;
+    std::mutex mSleepMtx;
+    std::condition_variable mWakeCV;
+    std::vector<int> mCpuAffinity;
+    size_t mStackSize;
+
+    static thread_local Deque* gOwnDeque;
+    static thread_local unsigned gLoopDepth;
+};
+
+#endif /* SYSTEM_TASKPOOL_H_ */
@@ -20,10 +20,13 @@
 
 #include "system/Assert.h"
 #include "system/SysConf.h"
+#include "system/TaskPool.h"
 #include "system/WorklistUtils.h"
 #include <algorithm>
+#include <atomic>
 #include <cstddef>
 #include <list>
+#include <omp.h>
 #include <time.h>
 
 /// See the documentation for Worklist.  This works the same way.
@@ -159,14 +162,69 @@ void* WorklistN<Processor,Index>::threadFunc( void* ptr )
     return 0;
 }
 
+/// A parallelFor running on the TaskPool.  The calling thread and up to
+/// nThreads-1 helper tasks each make a copy of the Processor, and then claim
+/// workitems one at a time until there are none left.
+template <class Proc, class Index>
+class ParallelLoop
+{
+public:
+    ParallelLoop( Index start, Index end, Proc const& proc )
+    : mStart(start), mNItems(end-start), mProc(proc), mNext(0), mNPending(0)
+    {}
+
+    ParallelLoop( ParallelLoop const& )=delete;
+    ParallelLoop& operator=( ParallelLoop const& )=delete;
+
+    void run( size_t nThreads )
+    { TaskPool& pool = TaskPool::get();
+      size_t nHelpers = std::min(nThreads-1,pool.getNWorkers());
+      nHelpers = std::min(nHelpers,mNItems-1);
+      mNPending = nHelpers;
+      for ( size_t helper = 0; helper != nHelpers; ++helper )
+        pool.push(TaskPool::Task(helperFunc,this));
+      int nOMPThreads = omp_get_max_threads();
+      omp_set_num_threads(1);
+      TaskPool::LoopScope scope;
+      work();
+      pool.waitFor(mNPending);
+      omp_set_num_threads(nOMPThreads); }
+
+private:
+    void work()
+    { size_t idx = mNext++;
+      if ( idx >= mNItems ) return;
+      Proc proc(mProc);
+      do proc(Index(mStart+idx));
+      while ( (idx = mNext++) < mNItems ); }
+
+    static void helperFunc( void* ptr )
+    { ParallelLoop* pLoop = static_cast<ParallelLoop*>(ptr);
+      pLoop->work();
+      TaskPool::get().taskDone(pLoop->mNPending); }
+
+    Index mStart;
+    size_t mNItems;
+    Proc const& mProc;
+    std::atomic_size_t mNext;
+    std::atomic_size_t mNPending;
+};
+
+/// Process workitems start..end-1 with nThreads of execution, on the
+/// process-wide TaskPool.  A loop started by a task on the pool may itself be
+/// parallel:  its helpers are just more tasks, and any idle workers will steal
+/// them.
 template <class Proc, class Index>
 void parallelFor( Index start, Index end, Proc const& proc,
                     size_t nThreads = getConfiguredNumThreads() )
 {
-    nThreads = boundNumThreads(nThreads);
-    if ( nThreads > 1 )
+    if ( !TaskPool::isWorker() )
+        nThreads = boundNumThreads(nThreads);
+    else if ( !nThreads || nThreads > size_t(getConfiguredNumThreads()) )
+        nThreads = getConfiguredNumThreads();
+    if ( nThreads > 1 && end-start > 1 )
     {
-        WorklistN<Proc> wl(start,end,proc,nThreads);
+        ParallelLoop<Proc,Index>(start,end,proc).run(nThreads);
     }
     else
     {
@@ -176,6 +234,49 @@ void parallelFor( Index start, Index end, Proc const& proc,
     }
 }
 
+/// A parallelFor on dedicated threads:  one thread per workitem, all running at
+/// once, so the workitems may wait on each other.
+template <class Proc, class Index>
+class ThreadedLoop
+{
+public:
+    ThreadedLoop( Index start, Index end, Proc const& proc )
+    : mStart(start), mNItems(end-start), mProc(proc), mNext(0)
+    {}
+
+    ThreadedLoop( ThreadedLoop const& )=delete;
+    ThreadedLoop& operator=( ThreadedLoop const& )=delete;
+
+    void run( size_t threadStackSize )
+    { if ( mNItems )
+        ThreadPool(mNItems,threadStackSize,threadFunc,this).shutdown(); }
+
+private:
+    static void* threadFunc( void* ptr )
+    { ThreadedLoop* pLoop = static_cast<ThreadedLoop*>(ptr);
+      TaskPool::LoopScope scope;
+      Proc proc(pLoop->mProc);
+      proc(Index(pLoop->mStart+pLoop->mNext++));
+      return 0; }
+
+    Index mStart;
+    size_t mNItems;
+    Proc const& mProc;
+    std::atomic_size_t mNext;
+};
+
+/// Process workitems start..end-1, each on a thread of its own, and wait for
+/// them all to finish.  Use this rather than parallelFor when the workitems
+/// wait on each other (at a barrier, say):  parallelFor's workitems are tasks
+/// on the shared TaskPool, and nothing promises that they all run at the same
+/// time.  The number of workitems is not bounded by getConfiguredNumThreads().
+template <class Proc, class Index>
+void parallelForThreads( Index start, Index end, Proc const& proc,
+                            size_t threadStackSize = 0 )
+{
+    ThreadedLoop<Proc,Index>(start,end,proc).run(threadStackSize);
+}
+
 template <class Proc, class Index>
 void parallelForBatch( Index start, Index stop, size_t batchSize,
                         Proc proc, size_t nThreads = getConfiguredNumThreads(),
@@ -116,7 +116,7 @@ QueueStateManipulator::~QueueStateManipulator()
 // populate_cpu_affinity - parse environment variable GOMP_CPU_AFFINITY and populate mGompCpuAffinity
 //
 
-static void populate_cpu_affinity( vector<int>& cpu_list )
+void populate_cpu_affinity( vector<int>& cpu_list )
 {
     size_t nprocs = processorsOnline();
     const char *affp= getenv("GOMP_CPU_AFFINITY");
@@ -147,6 +147,11 @@ private:
     bool mDone;   // state of done flag at time of lock acquisition
 };
 
+/// Parse the environment variable GOMP_CPU_AFFINITY into a list of cpus to
+/// which successive threads should be bound.  The list is left empty if the
+/// variable isn't set (or is nonsense).
+void populate_cpu_affinity( std::vector<int>& cpu_list );
+
 /// Class to manage a pool of threads
 class ThreadPool : LockedData
 {